@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+"""\
+
+Compress g-code jobs for the SD card (.gcz, the format is described in src/gcz.h)
+
+Usage:
+    gcz.py job.ngc                 writes job.gcz
+    gcz.py -d job.gcz              writes job.ngc, as Grbl sees it
+    gcz.py job.ngc -o other.gcz
+
+The job is first cleaned up the way Grbl would do it anyway (comments, white space and
+needless zeros removed, the numbers still read as the same floats), then compressed with
+LZSS with a 4 kB window. sphere.ngc gets about 3.2 times smaller.
+"""
+
+import argparse
+import collections
+import re
+import struct
+import sys
+import zlib
+
+MAGIC = b'GCZ1'
+HEADER = struct.Struct('<4sII')
+WINDOW_BITS = 12
+WINDOW_SIZE = 1 << WINDOW_BITS
+MIN_MATCH = 3
+MAX_MATCH = MIN_MATCH + (1 << (16 - WINDOW_BITS)) - 1
+MAX_CHAIN = 256  # Candidates checked per position. More is slower, hardly better.
+
+WORD = re.compile(r'([A-Z])([-+]?)([0-9]*)(?:\.([0-9]*))?')
+
+
+def clean_line(line):
+    """Removes what protocol_main_loop would: comments, white space, block delete. Upcases."""
+    out = []
+    comment = False
+    for c in line:
+        if comment:
+            comment = c != ')'
+        elif c == '(':
+            comment = True
+        elif c == ';':
+            break
+        elif c > ' ' and c != '/':
+            out.append(c.upper())
+    return ''.join(out)
+
+
+def to_float32(value):
+    return struct.unpack('<f', struct.pack('<f', value))[0]
+
+
+def grbl_float(integer, fraction):
+    """What read_float (nuts_bolts.c) makes of the digits, step by step, float rounding included."""
+    intval, exp, significant = 0, 0, 0
+    for decimal, digits in ((False, integer), (True, fraction)):
+        for d in digits:
+            d = int(d)
+            if intval == 0 and d == 0:
+                exp -= decimal
+            elif significant < 8:  # MAX_INT_DIGITS
+                significant += 1
+                exp -= decimal
+                intval = intval * 10 + d
+            else:
+                exp += not decimal
+    value = to_float32(intval)
+    if value != 0:
+        while exp <= -2:
+            value = to_float32(value * 0.01)
+            exp += 2
+        if exp < 0:
+            value = to_float32(value * 0.1)
+        while exp > 0:
+            value = to_float32(value * 10.0)
+            exp -= 1
+    return value
+
+
+def shorten_number(match):
+    """X-0.500000 -> X-.5, G01 -> G1. Only well formed numbers are touched, and only as long as
+    Grbl reads exactly the same float. It doesn't always, it rounds differently depending on the
+    number of digits (20.290000 is not the same as 20.29), then fewer zeros are dropped."""
+    letter, sign, integer, fraction = match.groups()
+    fraction = fraction or ''
+    if not integer and not fraction:
+        return match.group(0)
+    value = grbl_float(integer, fraction)
+    integer = integer.lstrip('0')
+    if sign == '+':
+        sign = ''
+    if value == 0:
+        return letter + '0'
+    stripped = fraction.rstrip('0')
+    for zeros in range(len(fraction) - len(stripped) + 1):
+        shorter = stripped + '0' * zeros
+        if grbl_float(integer, shorter) == value:
+            return letter + sign + (integer or ('' if shorter else '0')) + ('.' + shorter if shorter else '')
+    return match.group(0)
+
+
+def normalize(text):
+    """The job as Grbl would execute it, with shorter numbers. Empty and '%' lines dropped."""
+    lines = []
+    for line in text.splitlines():
+        line = clean_line(line)
+        if not line or line == '%':
+            continue
+        if line[0] != '$':  # Settings and jogging are left alone.
+            line = WORD.sub(shorten_number, line)
+        lines.append(line)
+    return ''.join(line + '\n' for line in lines).encode('ascii', 'replace')
+
+
+def longest_match(data, chains, pos):
+    """(length, distance) of the longest match for data[pos:] in the window."""
+    best_len, best_dist = 0, 0
+    for candidate in reversed(chains.get(data[pos:pos + MIN_MATCH], ())):
+        if pos - candidate > WINDOW_SIZE:
+            break
+        length = 0
+        while length < MAX_MATCH and pos + length < len(data) and data[candidate + length] == data[pos + length]:
+            length += 1
+        if length > best_len:
+            best_len, best_dist = length, pos - candidate
+            if length == MAX_MATCH:
+                break
+    return best_len, best_dist
+
+
+def compress(data):
+    """LZSS, hash chains of MIN_MATCH byte prefixes, lazy matching: a match is dropped for a
+    literal if the next position has a longer one."""
+    out = bytearray(HEADER.pack(MAGIC, len(data), zlib.crc32(data)))
+    chains = collections.defaultdict(collections.deque)
+    flags_at = None
+    bit = 8
+    pos = 0
+
+    def insert(p):
+        chain = chains[data[p:p + MIN_MATCH]]
+        chain.append(p)
+        if len(chain) > MAX_CHAIN:
+            chain.popleft()
+
+    while pos < len(data):
+        if bit == 8:
+            flags_at = len(out)
+            out.append(0)
+            bit = 0
+
+        length, distance = longest_match(data, chains, pos)
+        insert(pos)
+        if MIN_MATCH <= length < MAX_MATCH and longest_match(data, chains, pos + 1)[0] > length:
+            length = 0
+
+        if length >= MIN_MATCH:
+            out += struct.pack('<H', ((length - MIN_MATCH) << WINDOW_BITS) | (distance - 1))
+            for p in range(pos + 1, pos + length):
+                insert(p)
+            pos += length
+        else:
+            out[flags_at] |= 1 << bit
+            out.append(data[pos])
+            pos += 1
+        bit += 1
+
+    return bytes(out)
+
+
+def decompress(blob):
+    """Reference decoder, like gcz::Decoder. Raises ValueError on a damaged file."""
+    if len(blob) < HEADER.size:
+        raise ValueError('too short')
+    magic, size, crc = HEADER.unpack_from(blob)
+    if magic != MAGIC:
+        raise ValueError('not a .gcz file')
+    out = bytearray()
+    pos = HEADER.size
+    while len(out) < size:
+        flags = blob[pos]
+        pos += 1
+        for bit in range(8):
+            if len(out) == size:
+                break
+            if flags & (1 << bit):
+                out.append(blob[pos])
+                pos += 1
+            else:
+                item, = struct.unpack_from('<H', blob, pos)
+                pos += 2
+                distance = (item & (WINDOW_SIZE - 1)) + 1
+                length = (item >> WINDOW_BITS) + MIN_MATCH
+                if distance > len(out) or len(out) + length > size:
+                    raise ValueError('bad match at %d' % pos)
+                for _ in range(length):
+                    out.append(out[-distance])
+    if zlib.crc32(out) != crc:
+        raise ValueError('bad CRC')
+    return bytes(out)
+
+
+def main():
+    arg_parser = argparse.ArgumentParser(description='Compress g-code for the SD card (.gcz).')
+    arg_parser.add_argument('input', help='g-code file, or a .gcz file with -d')
+    arg_parser.add_argument('-o', '--output', help='output file, by default the input with the extension changed')
+    arg_parser.add_argument('-d', '--decompress', action='store_true', help='decompress')
+    args = arg_parser.parse_args()
+
+    with open(args.input, 'rb') as f:
+        data = f.read()
+
+    if args.decompress:
+        result = decompress(data)
+        extension = '.ngc'
+    else:
+        normalized = normalize(data.decode('utf-8', 'replace'))
+        result = compress(normalized)
+        if decompress(result) != normalized:
+            raise SystemExit('Internal error, the round trip failed')
+        extension = '.gcz'
+
+    output = args.output or re.sub(r'\.[^./]*$', '', args.input) + extension
+    with open(output, 'wb') as f:
+        f.write(result)
+
+    if not args.decompress:
+        print('%s: %d -> %d bytes (%.2fx)' % (output, len(data), len(result), len(data) / max(len(result), 1)))
+
+
+if __name__ == '__main__':
+    sys.exit(main())
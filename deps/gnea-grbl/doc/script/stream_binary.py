@@ -0,0 +1,376 @@
+#!/usr/bin/env python3
+"""\
+
+Stream g-code to grbl as pre-parsed binary motion records
+
+Linear motions (G0/G1 with X/Y/Z/F words only) are parsed on the PC and
+sent as framed binary records (see grbl/binary_stream.h). Grbl puts them
+directly into the planner and acknowledges them in windows. Every other
+line is sent as text, after all the records sent before it have been
+acknowledged. In text mode the file is streamed with the character
+counting protocol of stream.py, or with --credits, spending the free RX
+buffer space Grbl reports in every 'ok:<n>' ($10 bit 2, restored on exit).
+Both modes print the achieved blocks/sec so they can be compared on the
+same file.
+
+Usage:
+    stream_binary.py file.ngc /dev/ttyACM0 --mode binary
+    stream_binary.py file.ngc /dev/ttyACM0 --mode text
+    stream_binary.py file.ngc /dev/ttyACM0 --mode text --credits
+
+pySerial is required.
+"""
+
+import argparse
+import binascii
+import collections
+import queue
+import re
+import struct
+import sys
+import threading
+import time
+
+import serial
+
+RX_BUFFER_SIZE = 1024  # serial.h
+BSTREAM_QUEUE_SIZE = 32  # binary_stream.h
+N_AXIS = 3
+REPORT_MASK_RX_CREDITS = 1 << 2
+
+FRAME_END = 0xC0
+FRAME_ESC = 0xDB
+ESC_XOR = 0x20
+# Frame delimiters and every real-time command character must be escaped.
+ESCAPED = {FRAME_END, FRAME_ESC, 0x18, ord('?'), ord('~'), ord('!'), 0x84, 0x85, 0x86, 0xA0, 0xA1} | set(range(0x90, 0x9F))
+
+TYPE_SYNC = 0
+TYPE_LINE = 1
+FLAG_RAPID = 1 << 0
+
+STATUS_BINARY_STREAM_FRAME = 60
+STATUS_BINARY_STREAM_SEQUENCE = 61
+
+RECORD = struct.Struct('<BBBBi%dff' % N_AXIS)
+
+
+def frame(seq, rtype, flags=0, line_number=0, target=(0.0,) * N_AXIS, feed_rate=0.0):
+    payload = RECORD.pack(seq & 0xFF, rtype, flags, 0, line_number, *target, feed_rate)
+    payload += struct.pack('<H', binascii.crc_hqx(payload, 0xFFFF))
+    out = bytearray([FRAME_END])
+    for b in payload:
+        if b in ESCAPED:
+            out += bytes([FRAME_ESC, b ^ ESC_XOR])
+        else:
+            out.append(b)
+    out.append(FRAME_END)
+    return bytes(out)
+
+
+def clean(line):
+    """Strip comments and white space and capitalize, like protocol.c does."""
+    return re.sub(r'\s|\(.*?\)|;.*', '', line).upper()
+
+
+class Parser:
+    """Tracks just enough modal state to turn simple linear motions into records."""
+
+    WORD = re.compile(r'([A-Z])([-+]?[0-9]*\.?[0-9]*)')
+
+    def __init__(self):
+        self.absolute = True
+        self.mm = True
+        self.motion = 0
+        self.feed = 0.0
+        self.position = [0.0] * N_AXIS  # Work coordinates, mm.
+
+    def parse(self, block):
+        """Returns (flags, line_number, target, feed) or None if the block must go as text."""
+        words = self.WORD.findall(block)
+        if not words or ''.join(l + v for l, v in words) != block:
+            return None
+
+        motion = self.motion
+        axes = {}
+        feed = None
+        line_number = 0
+        for letter, value in words:
+            try:
+                number = float(value)
+            except ValueError:
+                return None
+            if letter == 'G' and number in (0.0, 1.0):
+                motion = int(number)
+            elif letter in 'XYZ'[:N_AXIS] and letter not in axes:
+                axes[letter] = number
+            elif letter == 'F' and feed is None:
+                feed = number
+            elif letter == 'N':
+                line_number = int(number)
+            else:
+                return None  # Anything else changes modal state Grbl has to know about.
+
+        if not axes or motion not in (0, 1):
+            return None
+
+        scale = 1.0 if self.mm else 25.4
+        if feed is not None:
+            self.feed = feed * scale
+        if motion == 1 and self.feed <= 0.0:
+            return None  # Let Grbl report the error.
+
+        for idx, letter in enumerate('XYZ'[:N_AXIS]):
+            if letter in axes:
+                value = axes[letter] * scale
+                self.position[idx] = value if self.absolute else self.position[idx] + value
+
+        self.motion = motion
+        return (FLAG_RAPID if motion == 0 else 0, line_number, list(self.position), self.feed)
+
+    def track_text(self, block):
+        """Follows the modal changes and the end point of a block sent as text."""
+        words = [(l, v) for l, v in self.WORD.findall(block) if v not in ('', '.', '-', '+')]
+        codes = [float(v) for l, v in words if l == 'G']
+        for code in codes:
+            if code == 90: self.absolute = True
+            elif code == 91: self.absolute = False
+            elif code == 20: self.mm = False
+            elif code == 21: self.mm = True
+            elif code in (0, 1, 2, 3): self.motion = int(code)
+        if any(code in (10, 28, 30, 53, 92) for code in codes):
+            return  # Axis words are not a target in work coordinates here.
+        scale = 1.0 if self.mm else 25.4
+        for letter, value in words:
+            if letter == 'F':
+                self.feed = float(value) * scale
+            elif letter in 'XYZ'[:N_AXIS]:
+                idx = 'XYZ'.index(letter)
+                value = float(value) * scale
+                self.position[idx] = value if self.absolute else self.position[idx] + value
+
+
+class Grbl:
+    def __init__(self, device, verbose):
+        self.port = serial.Serial(device, 115200, timeout=0.1)
+        self.verbose = verbose
+        self.responses = queue.Queue()  # 'ok' / 'error:N'
+        self.acks = queue.Queue()       # ('ACK'|'NAK', seq, value)
+        self.settings = {}              # $$ output, number -> value
+        self.state = ''
+        threading.Thread(target=self.reader, daemon=True).start()
+
+    def reader(self):
+        while True:
+            line = self.port.readline().decode('ascii', 'replace').strip()
+            if not line:
+                continue
+            m = re.match(r'\[(ACK|NAK):(\d+),(\d+)\]', line)
+            if m:
+                self.acks.put((m.group(1), int(m.group(2)), int(m.group(3))))
+            elif line == 'ok' or line.startswith('ok:') or line.startswith('error'):
+                self.responses.put(line)
+            elif line.startswith('<'):
+                self.state = line[1:].split('|')[0]
+            elif re.match(r'\$\d+=', line):
+                number, value = line[1:].split('=', 1)
+                self.settings[int(number)] = value
+            elif self.verbose:
+                print('    MSG: "%s"' % line)
+
+    def write(self, data):
+        self.port.write(data)
+
+    def command(self, block):
+        self.write((block + '\n').encode('ascii'))
+        return self.responses.get()
+
+    def wait_idle(self):
+        self.state = ''
+        while self.state != 'Idle':
+            self.write(b'?')
+            time.sleep(0.05)
+
+
+def report_mask(grbl):
+    """Returns $10, read with $$ (the setting lines come before its 'ok')."""
+    grbl.settings.clear()
+    grbl.command('$$')
+    return int(grbl.settings[10])
+
+
+def stream_text(grbl, lines, verbose, rx_size=RX_BUFFER_SIZE):
+    """Character counting protocol, like stream.py."""
+    in_flight = []
+    errors = 0
+    for block in lines:
+        in_flight.append(len(block) + 1)
+        while sum(in_flight) >= rx_size - 1:
+            if grbl.responses.get().startswith('error'):
+                errors += 1
+            del in_flight[0]
+        grbl.write((block + '\n').encode('ascii'))
+        if verbose:
+            print('SND> "%s"' % block)
+    while in_flight:
+        if grbl.responses.get().startswith('error'):
+            errors += 1
+        del in_flight[0]
+    return errors
+
+
+def stream_credits(grbl, lines, verbose):
+    """Credit based flow control. Each 'ok:<n>' says n bytes of the RX buffer were
+    free when Grbl had read the line it answers. Every byte sent after that line
+    may be in that buffer already or still on its way, so all of them are taken
+    off n. The ones already received are counted twice, which is safe, and no
+    buffer size has to be assumed."""
+    in_flight = collections.deque()  # Lengths of the lines not answered yet.
+    credit = 0
+    errors = 0
+
+    def receive():
+        nonlocal credit, errors
+        response = grbl.responses.get()
+        in_flight.popleft()
+        if response.startswith('ok:'):
+            credit = int(response[3:])
+        elif response.startswith('error'):
+            errors += 1  # No credit in an error, the last one still holds.
+
+    in_flight.append(1)
+    grbl.write(b'\n')  # Answered with the free space when nothing is in flight.
+    receive()
+
+    for block in lines:
+        data = (block + '\n').encode('ascii')
+        while in_flight and len(data) > credit - sum(in_flight):
+            receive()
+        in_flight.append(len(data))
+        grbl.write(data)
+        if verbose:
+            print('SND> "%s"' % block)
+    while in_flight:
+        receive()
+    return errors
+
+
+def stream_binary(grbl, lines, window, verbose):
+    parser = Parser()
+    seq = 0
+    errors = 0
+    pending = []  # Records not acknowledged yet: (seq, frame bytes)
+    sent = 0      # How many of the pending records have been sent.
+
+    def send():
+        nonlocal sent
+        while sent < len(pending) and sent < window:
+            grbl.write(pending[sent][1])
+            sent += 1
+
+    def flush(until_empty):
+        nonlocal pending, sent, errors
+        send()
+        while pending and (until_empty or len(pending) >= window):
+            send()
+            try:
+                kind, ack_seq, value = grbl.acks.get(timeout=2.0)
+            except queue.Empty:
+                sent = 0  # Nothing heard, resend the whole window.
+                continue
+            first = pending[0][0]
+            distance = (ack_seq - first) & 0xFF
+            if kind == 'NAK' and value in (STATUS_BINARY_STREAM_FRAME, STATUS_BINARY_STREAM_SEQUENCE):
+                if distance < len(pending):
+                    del pending[:distance]
+                    sent = 0
+                continue
+            if kind == 'NAK':
+                errors += 1
+                if verbose:
+                    print('  NAK seq %d error:%d' % (ack_seq, value))
+            if distance < sent:
+                del pending[:distance + 1]
+                sent -= distance + 1
+
+    def push(rtype, *fields):
+        nonlocal seq
+        pending.append((seq, frame(seq, rtype, *fields)))
+        seq = (seq + 1) & 0xFF
+        flush(False)
+
+    push(TYPE_SYNC)
+
+    for block in lines:
+        record = parser.parse(block)
+        if record is not None:
+            push(TYPE_LINE, *record)
+            continue
+        flush(True)  # Records before text must be executed first.
+        parser.track_text(block)
+        response = grbl.command(block)
+        if response.startswith('error'):
+            errors += 1
+        if verbose:
+            print('SND> "%s" REC< "%s"' % (block, response))
+
+    flush(True)
+    return errors
+
+
+def main():
+    arg_parser = argparse.ArgumentParser(description='Stream g-code to grbl in binary or text mode and measure blocks/sec.')
+    arg_parser.add_argument('gcode_file', type=argparse.FileType('r'), help='g-code filename to be streamed')
+    arg_parser.add_argument('device_file', help='serial device path')
+    arg_parser.add_argument('-m', '--mode', choices=('binary', 'text'), default='binary')
+    arg_parser.add_argument('-w', '--window', type=int, default=BSTREAM_QUEUE_SIZE // 2,
+                            help='binary records in flight (max %d)' % BSTREAM_QUEUE_SIZE)
+    arg_parser.add_argument('-c', '--credits', action='store_true', default=False,
+                            help='text mode: credit based flow control instead of character counting')
+    arg_parser.add_argument('-q', '--quiet', action='store_true', default=False, help='suppress output text')
+    args = arg_parser.parse_args()
+
+    lines = [b for b in (clean(l) for l in args.gcode_file) if b]
+    grbl = Grbl(args.device_file, not args.quiet)
+
+    print('Initializing Grbl...')
+    grbl.write(b'\r\n\r\n')
+    time.sleep(2)
+    while not grbl.responses.empty():
+        grbl.responses.get()
+
+    credits = args.mode == 'text' and args.credits
+    if credits:
+        mask = report_mask(grbl)
+        grbl.command('$10=%d' % (mask | REPORT_MASK_RX_CREDITS))
+
+    try:
+        start_time = time.time()
+        if args.mode == 'binary':
+            errors = stream_binary(grbl, lines, min(args.window, BSTREAM_QUEUE_SIZE), not args.quiet)
+        elif credits:
+            errors = stream_credits(grbl, lines, not args.quiet)
+        else:
+            errors = stream_text(grbl, lines, not args.quiet)
+        streamed_time = time.time() - start_time
+        grbl.wait_idle()
+        total_time = time.time() - start_time
+    except BaseException:
+        if credits:
+            # Stop the stream, its stray answers would be taken for the one to $10.
+            grbl.write(b'\x18')
+            time.sleep(1)
+            while not grbl.responses.empty():
+                grbl.responses.get()
+        raise
+    finally:
+        if credits:
+            grbl.command('$10=%d' % mask)
+
+    print('\n%s mode: %d blocks, %d errors' % (args.mode, len(lines), errors))
+    print(' Streamed in %.2f s (%.1f blocks/sec)' % (streamed_time, len(lines) / streamed_time))
+    print(' Finished in %.2f s (%.1f blocks/sec)' % (total_time, len(lines) / total_time))
+    return 1 if errors else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""\
+
+Read the binary telemetry stream (see grbl/telemetry.h) and print it as CSV
+
+Usage:
+    telemetry.py /dev/ttyACM1 > log.csv
+
+pySerial is required.
+"""
+
+import argparse
+import binascii
+import struct
+import sys
+
+import serial
+
+N_AXIS = 3
+SYNC = 0xA55A
+RECORD = struct.Struct('<HBBI%difBBHHH' % N_AXIS)
+SYNC_BYTES = struct.pack('<H', SYNC)
+
+
+def records(port):
+    """Yields the unpacked records. Resynchronizes on a bad CRC."""
+    data = bytearray()
+    while True:
+        data += port.read(max(RECORD.size, port.in_waiting))
+        while True:
+            start = data.find(SYNC_BYTES)
+            if start < 0:
+                del data[:-1]
+                break
+            del data[:start]
+            if len(data) < RECORD.size:
+                break
+            if binascii.crc_hqx(bytes(data[:RECORD.size - 2]), 0xFFFF) != struct.unpack_from('<H', data, RECORD.size - 2)[0]:
+                del data[:1]
+                continue
+            yield RECORD.unpack_from(data)
+            del data[:RECORD.size]
+
+
+def main():
+    arg_parser = argparse.ArgumentParser(description='Print the grbl binary telemetry as CSV.')
+    arg_parser.add_argument('device_file', help='serial device path of the telemetry port')
+    args = arg_parser.parse_args()
+
+    port = serial.Serial(args.device_file, 115200, timeout=0.1)
+    axes = 'xyz'[:N_AXIS]
+    print('time_us,state,' + ','.join(axes) + ',rate,planner,segments,isr_load_pct,lost')
+    last_seq = None
+    for fields in records(port):
+        _, seq, state, time_us = fields[:4]
+        position = fields[4:4 + N_AXIS]
+        rate, planner, segments, isr_load, dropped, _ = fields[4 + N_AXIS:]
+        lost = dropped + (((seq - last_seq - 1) & 0xFF) if last_seq is not None else 0)
+        last_seq = seq
+        print('%d,%d,%s,%.1f,%d,%d,%.2f,%d' % (time_us, state, ','.join(str(p) for p in position), rate,
+                                              planner, segments, isr_load / 100.0, lost))
+        sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    sys.exit(main())
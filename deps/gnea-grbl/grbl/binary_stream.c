@@ -0,0 +1,246 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#include "grbl.h"
+#include <zephyr/sys/crc.h>
+
+#ifdef ENABLE_BINARY_STREAM
+
+BUILD_ASSERT(sizeof(bstream_record_t) == 8 + 4 * (N_AXIS + 1), "Unexpected padding");
+
+#define FRAME_SIZE (sizeof(bstream_record_t) + 2) // Record + CRC.
+
+// Records validated by the ISR, waiting for the main program.
+K_MSGQ_DEFINE(bstream_queue, sizeof(bstream_record_t), BSTREAM_QUEUE_SIZE, 4);
+
+// Frame decoder state. Touched only by the serial ISR.
+static uint8_t frame[FRAME_SIZE];
+static uint8_t frame_len;
+static bool frame_open;
+static bool frame_escape;
+static bool frame_overflow;
+
+// Set by the ISR when a frame was lost, cleared by the main program when it NAKs.
+static atomic_t frame_lost;
+
+// Main program state.
+static uint8_t expected_seq;
+static uint8_t unacked;  // Records executed since the last ACK.
+static bool rewinding;   // NAK sent, waiting for the host to resend expected_seq.
+
+
+// Real-time commands are picked off the stream even inside a frame.
+static bool bstream_is_realtime_command(uint8_t data)
+{
+  switch (data) {
+    case CMD_RESET: case CMD_STATUS_REPORT: case CMD_CYCLE_START: case CMD_FEED_HOLD:
+    case CMD_SAFETY_DOOR: case CMD_JOG_CANCEL: case CMD_DEBUG_REPORT:
+    case CMD_COOLANT_FLOOD_OVR_TOGGLE: case CMD_COOLANT_MIST_OVR_TOGGLE:
+      return(true);
+    default:
+      return((data >= CMD_FEED_OVR_RESET) && (data <= CMD_SPINDLE_OVR_STOP));
+  }
+}
+
+
+static void bstream_frame_complete()
+{
+  if (frame_overflow || (frame_len != FRAME_SIZE)) {
+    atomic_set(&frame_lost, 1);
+    return;
+  }
+
+  uint16_t crc = frame[FRAME_SIZE-2] | (frame[FRAME_SIZE-1] << 8);
+  if (crc16_itu_t(0xffff, frame, sizeof(bstream_record_t)) != crc) {
+    atomic_set(&frame_lost, 1);
+    return;
+  }
+
+  bstream_record_t record;
+  memcpy(&record, frame, sizeof(record));
+  if (k_msgq_put(&bstream_queue, &record, K_NO_WAIT) != 0) {
+    atomic_set(&frame_lost, 1); // Host ignored the window.
+  }
+}
+
+
+bool bstream_receive(uint8_t data)
+{
+  if (!frame_open) {
+    if (data != BSTREAM_FRAME_END) { return(false); }
+    frame_open = true;
+    frame_len = 0;
+    frame_escape = false;
+    frame_overflow = false;
+    return(true);
+  }
+
+  if (bstream_is_realtime_command(data)) {
+    if (data == CMD_RESET) { frame_open = false; } // Reset drops the frame, like everything else.
+    return(false);
+  }
+
+  if (data == BSTREAM_FRAME_END) {
+    if (frame_len == 0) { return(true); } // Back to back delimiters. Still waiting for data.
+    bstream_frame_complete();
+    frame_open = false;
+    return(true);
+  }
+
+  if (data == BSTREAM_FRAME_ESC) {
+    frame_escape = true;
+    return(true);
+  }
+
+  if (frame_escape) {
+    data ^= BSTREAM_ESC_XOR;
+    frame_escape = false;
+  }
+
+  if (frame_len < FRAME_SIZE) { frame[frame_len++] = data; }
+  else { frame_overflow = true; }
+
+  return(true);
+}
+
+
+bool bstream_is_receiving() { return(frame_open); }
+
+
+static uint8_t bstream_execute_record(bstream_record_t *record)
+{
+  if (record->type == BSTREAM_TYPE_SYNC) { return(STATUS_OK); }
+  if (record->type != BSTREAM_TYPE_LINE) { return(STATUS_GCODE_UNSUPPORTED_COMMAND); }
+  if (sys.state & (STATE_ALARM | STATE_JOG)) { return(STATUS_SYSTEM_GC_LOCK); }
+
+  bool rapid = bit_istrue(record->flags, BSTREAM_FLAG_RAPID);
+  if (!rapid && !(record->feed_rate > 0.0)) { return(STATUS_GCODE_UNDEFINED_FEED_RATE); }
+
+  // Same target computation as the g-code parser does for G90 (or G53) motions.
+  float target[N_AXIS];
+  uint8_t idx;
+  for (idx=0; idx<N_AXIS; idx++) {
+    target[idx] = record->target[idx];
+    if (bit_isfalse(record->flags, BSTREAM_FLAG_MACHINE_COORDS)) {
+      target[idx] += gc_state.coord_system[idx] + gc_state.coord_offset[idx];
+      if (idx == TOOL_LENGTH_OFFSET_AXIS) { target[idx] += gc_state.tool_length_offset; }
+    }
+  }
+
+  if (bit_istrue(settings.flags, BITFLAG_SOFT_LIMIT_ENABLE)) {
+    if (system_check_travel_limits(target)) { return(STATUS_TRAVEL_EXCEEDED); }
+  }
+
+  plan_line_data_t plan_data;
+  plan_line_data_t *pl_data = &plan_data;
+  memset(pl_data, 0, sizeof(plan_line_data_t));
+  pl_data->spindle_speed = gc_state.spindle_speed;
+  pl_data->condition = gc_state.modal.spindle | gc_state.modal.coolant;
+  #ifdef USE_LINE_NUMBERS
+    pl_data->line_number = record->line_number;
+  #endif
+
+  gc_state.line_number = record->line_number;
+  if (rapid) {
+    pl_data->condition |= PL_COND_FLAG_RAPID_MOTION;
+    gc_state.modal.motion = MOTION_MODE_SEEK;
+  } else {
+    gc_state.feed_rate = record->feed_rate;
+    pl_data->feed_rate = record->feed_rate;
+    gc_state.modal.motion = MOTION_MODE_LINEAR;
+  }
+
+  mc_line(target, pl_data);
+  memcpy(gc_state.position, target, sizeof(target)); // Parser follows, as if it was a g-code line.
+  return(STATUS_OK);
+}
+
+
+// Asks the host to rewind to the expected record. Only once per gap, the records in flight
+// after the gap are dropped silently.
+static void bstream_nak_gap(uint8_t status_code)
+{
+  if (!rewinding) { report_binary_stream_nak(expected_seq, status_code); }
+  rewinding = true;
+  unacked = 0;
+}
+
+
+bool bstream_execute()
+{
+  bool busy = false;
+  bool reack = false;
+  bstream_record_t record;
+
+  serial_reply_to(SERIAL_CHANNEL_USB); // ACKs and NAKs are for the host only.
+
+  while (k_msgq_get(&bstream_queue, &record, K_NO_WAIT) == 0) {
+    busy = true;
+
+    if (record.type == BSTREAM_TYPE_SYNC) { expected_seq = record.seq; }
+
+    int8_t distance = (int8_t)(record.seq - expected_seq);
+    if (distance < 0) { // Duplicate. The host missed an ACK and resent, so ACK again.
+      reack = true;
+      continue;
+    }
+    if (distance > 0) {
+      bstream_nak_gap(STATUS_BINARY_STREAM_SEQUENCE);
+      continue;
+    }
+
+    rewinding = false;
+    expected_seq++;
+
+    uint8_t status_code = bstream_execute_record(&record);
+    if (sys.abort) { break; }
+
+    if (status_code != STATUS_OK) {
+      report_binary_stream_nak(record.seq, status_code);
+      unacked = 0;
+      continue;
+    }
+
+    if (++unacked >= BSTREAM_ACK_WINDOW) {
+      report_binary_stream_ack(record.seq, k_msgq_num_free_get(&bstream_queue));
+      unacked = 0;
+    }
+  }
+
+  if (sys.abort) {
+    serial_reply_to(SERIAL_CHANNEL_ALL);
+    return(true);
+  }
+
+  // Checked after the queue is drained, so expected_seq points at the lost frame.
+  if (atomic_cas(&frame_lost, 1, 0)) {
+    bstream_nak_gap(STATUS_BINARY_STREAM_FRAME);
+    busy = true;
+  }
+
+  // Everything received so far is executed. Tell the host, so it doesn't wait for the window.
+  if ((unacked > 0) || (reack && !rewinding)) {
+    report_binary_stream_ack(expected_seq-1, k_msgq_num_free_get(&bstream_queue));
+    unacked = 0;
+  }
+
+  serial_reply_to(SERIAL_CHANNEL_ALL);
+  return(busy);
+}
+
+
+void bstream_reset()
+{
+  k_msgq_purge(&bstream_queue);
+  atomic_clear(&frame_lost);
+  expected_seq = 0;
+  unacked = 0;
+  rewinding = false;
+}
+
+#endif
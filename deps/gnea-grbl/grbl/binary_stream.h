@@ -0,0 +1,80 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#ifndef binary_stream_h
+#define binary_stream_h
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  The host sends already parsed motion records instead of g-code lines. Frames are
+  SLIP-like: BSTREAM_FRAME_END, escaped payload, escaped CRC, BSTREAM_FRAME_END. Every
+  payload byte which is a frame delimiter or a real-time command character is sent as
+  BSTREAM_FRAME_ESC followed by the byte XOR BSTREAM_ESC_XOR, so real-time commands can be
+  sent at any moment, even in the middle of a frame. The CRC is CRC-16/CCITT-FALSE (poly
+  0x1021, seed 0xffff) of the payload, little-endian, like all the other fields.
+
+  Records are executed in order of their sequence numbers. Instead of an 'ok' per record,
+  Grbl acknowledges them in windows with "[ACK:<seq>,<free>]" where seq is the last record
+  executed and free is the number of records the host may send on top of the unacknowledged
+  ones. A corrupted frame or a sequence gap is answered with "[NAK:<seq>,<status>]" where
+  seq is the record Grbl expects next. The host rewinds to it. Records rejected by the
+  machine state (alarm etc.) are NAKed with the status code and skipped.
+
+  Text lines and binary records are queued separately. The host has to wait for the last
+  'ok' before switching to records and for the last ACK before switching back to text.
+*/
+
+#define BSTREAM_FRAME_END 0xC0
+#define BSTREAM_FRAME_ESC 0xDB
+#define BSTREAM_ESC_XOR 0x20
+
+// Number of received records waiting for the planner. The host window must not exceed it.
+#define BSTREAM_QUEUE_SIZE 32
+// Acknowledge at least every this many records.
+#define BSTREAM_ACK_WINDOW 8
+
+// Record types
+#define BSTREAM_TYPE_SYNC 0 // Resets the sequence to the one of this record. No motion.
+#define BSTREAM_TYPE_LINE 1 // Linear motion (G0 or G1).
+
+// Record flags
+#define BSTREAM_FLAG_RAPID bit(0)          // G0 instead of G1. Feed rate ignored.
+#define BSTREAM_FLAG_MACHINE_COORDS bit(1) // Target in machine coordinates (like G53).
+
+// One record. Target is in mm and in the current work coordinate system (unless
+// BSTREAM_FLAG_MACHINE_COORDS is set), feed rate in mm/min.
+typedef struct {
+  uint8_t seq;
+  uint8_t type;
+  uint8_t flags;
+  uint8_t reserved;
+  int32_t line_number;
+  float target[N_AXIS];
+  float feed_rate;
+} bstream_record_t;
+
+// Called for every received byte from the serial ISR. Returns true if the byte belongs to
+// a frame and was consumed, false if it has to be processed as usual.
+bool bstream_receive(uint8_t data);
+
+// True while a frame is being received. Every byte has to go to bstream_receive then.
+bool bstream_is_receiving();
+
+// Executes the received records. Called by the main program when there is no g-code line
+// to process. Returns true if anything was done.
+bool bstream_execute();
+
+// Drops all the received records. Used by reset.
+void bstream_reset();
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,126 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#include "grbl.h"
+
+#if COMMAND_N_AXIS != N_AXIS
+  #error "COMMAND_N_AXIS must be equal to N_AXIS"
+#endif
+
+// Commands posted by the other threads, waiting for the main program.
+K_MSGQ_DEFINE(command_queue, sizeof(command_t), COMMAND_QUEUE_SIZE, 4);
+
+// The bytes the host would send for the same thing.
+static const char realtime_commands[COMMAND_RT_COUNT] = {
+  [COMMAND_RT_FEED_HOLD] = CMD_FEED_HOLD,
+  [COMMAND_RT_CYCLE_START] = CMD_CYCLE_START,
+  [COMMAND_RT_RESET] = CMD_RESET,
+  [COMMAND_RT_JOG_CANCEL] = CMD_JOG_CANCEL,
+  [COMMAND_RT_FEED_OVR_RESET] = CMD_FEED_OVR_RESET,
+  [COMMAND_RT_FEED_OVR_COARSE_PLUS] = CMD_FEED_OVR_COARSE_PLUS,
+  [COMMAND_RT_FEED_OVR_COARSE_MINUS] = CMD_FEED_OVR_COARSE_MINUS,
+  [COMMAND_RT_FEED_OVR_FINE_PLUS] = CMD_FEED_OVR_FINE_PLUS,
+  [COMMAND_RT_FEED_OVR_FINE_MINUS] = CMD_FEED_OVR_FINE_MINUS,
+  [COMMAND_RT_RAPID_OVR_RESET] = CMD_RAPID_OVR_RESET,
+  [COMMAND_RT_RAPID_OVR_MEDIUM] = CMD_RAPID_OVR_MEDIUM,
+  [COMMAND_RT_RAPID_OVR_LOW] = CMD_RAPID_OVR_LOW,
+  [COMMAND_RT_SPINDLE_OVR_RESET] = CMD_SPINDLE_OVR_RESET,
+  [COMMAND_RT_SPINDLE_OVR_COARSE_PLUS] = CMD_SPINDLE_OVR_COARSE_PLUS,
+  [COMMAND_RT_SPINDLE_OVR_COARSE_MINUS] = CMD_SPINDLE_OVR_COARSE_MINUS,
+  [COMMAND_RT_SPINDLE_OVR_FINE_PLUS] = CMD_SPINDLE_OVR_FINE_PLUS,
+  [COMMAND_RT_SPINDLE_OVR_FINE_MINUS] = CMD_SPINDLE_OVR_FINE_MINUS,
+};
+
+
+bool command_post(const command_t *command)
+{
+  return(k_msgq_put(&command_queue, command, K_NO_WAIT) == 0);
+}
+
+
+void command_realtime(command_realtime_t command)
+{
+  if (command < COMMAND_RT_COUNT) { serial_check_real_time_command(realtime_commands[command]); }
+}
+
+
+// The checks and the target of `$J=G21G91...`, without the text on the way.
+static uint8_t command_jog(const command_t *command)
+{
+  if (sys.state != STATE_IDLE && sys.state != STATE_JOG) { return(STATUS_IDLE_ERROR); }
+  if (!(command->args.jog.feed_rate > 0.0)) { return(STATUS_GCODE_UNDEFINED_FEED_RATE); }
+
+  parser_block_t gc_block;
+  memset(&gc_block, 0, sizeof(parser_block_t));
+  gc_block.values.f = command->args.jog.feed_rate;
+  #ifdef USE_LINE_NUMBERS
+    gc_block.values.n = JOG_LINE_NUMBER;
+  #endif
+  uint8_t idx;
+  for (idx=0; idx<N_AXIS; idx++) {
+    gc_block.values.xyz[idx] = gc_state.position[idx] + command->args.jog.distance[idx];
+  }
+
+  plan_line_data_t plan_data;
+  memset(&plan_data, 0, sizeof(plan_line_data_t));
+  plan_data.spindle_speed = gc_state.spindle_speed;
+  plan_data.condition = (gc_state.modal.spindle | gc_state.modal.coolant);
+
+  uint8_t status_code = jog_execute(&plan_data, &gc_block);
+  // Like gc_execute_line, so the next jog starts where this one ends.
+  if (status_code == STATUS_OK) { memcpy(gc_state.position, gc_block.values.xyz, sizeof(gc_block.values.xyz)); }
+  return(status_code);
+}
+
+
+// The checks of `$E=path`. The result is kept by the application, nothing is reported.
+static uint8_t command_estimate(const command_t *command)
+{
+  if (sys.state != STATE_IDLE) { return(STATUS_IDLE_ERROR); }
+  if (command->args.path[0] == 0) { return(STATUS_INVALID_STATEMENT); }
+  estimate_t estimate;
+  return(estimator_run_file(command->args.path, &estimate));
+}
+
+
+static uint8_t command_execute_one(const command_t *command)
+{
+  // system_execute_line may overwrite the line with the startup blocks (after homing).
+  char line[LINE_BUFFER_SIZE];
+
+  switch (command->type) {
+    case COMMAND_JOG: return(command_jog(command));
+    case COMMAND_HOME: strcpy(line, "$H"); return(system_execute_line(line));
+    case COMMAND_UNLOCK: strcpy(line, "$X"); return(system_execute_line(line));
+    case COMMAND_ESTIMATE: return(command_estimate(command));
+    default: return(STATUS_INVALID_STATEMENT);
+  }
+}
+
+
+bool command_execute()
+{
+  bool busy = false;
+  command_t command;
+
+  // Messages printed on the way ("Caution: Unlocked" and the like) go to the UI channel, as if
+  // the command came from there.
+  serial_reply_to(SERIAL_CHANNEL_UI);
+
+  while (k_msgq_get(&command_queue, &command, K_NO_WAIT) == 0) {
+    busy = true;
+    command_result_t result;
+    result.status = command_execute_one(&command);
+    result.state = sys.state;
+    if (command.done != NULL) { command.done(&result, command.user_data); }
+    if (sys.abort) { break; }
+  }
+
+  serial_reply_to(SERIAL_CHANNEL_ALL);
+  return(busy);
+}
@@ -0,0 +1,95 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#ifndef command_h
+#define command_h
+#include <stdbool.h>
+#include <stdint.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Typed commands from the other threads of the firmware (the display) to the protocol core, in
+  place of text lines written to a serial channel and replies parsed back. A command is posted
+  to a queue and executed by the main thread between the lines, with the same checks the `$`
+  commands have. The outcome goes to the callback of the command: the status code (report.h)
+  and the state the machine was left in. Real-time commands don't wait in the queue, they set
+  the flags at once, like the bytes from the host do. The state itself is in snapshot.h.
+*/
+
+// N_AXIS. This header is included from C++, where nuts_bolts.h can't be (see RESUME_N_AXIS).
+#define COMMAND_N_AXIS 3
+
+#define COMMAND_QUEUE_SIZE 8
+#define COMMAND_PATH_SIZE 96
+
+// Command types
+#define COMMAND_JOG 0      // Relative jog (like $J=G21G91...), queued after the previous ones.
+#define COMMAND_HOME 1     // $H
+#define COMMAND_UNLOCK 2   // $X
+#define COMMAND_ESTIMATE 3 // $E=path, the result goes to estimator_run_file's caller.
+
+typedef struct {
+  uint8_t status; // STATUS_OK or the error code, as in "error:N".
+  uint8_t state;  // sys.state after the command.
+} command_result_t;
+
+// Called from the main thread, GRBL waits for it. Must not block.
+typedef void (*command_done_t)(const command_result_t *result, void *user_data);
+
+typedef struct {
+  uint8_t type;
+  union {
+    struct {
+      float distance[COMMAND_N_AXIS]; // [mm]
+      float feed_rate;                // [mm/min]
+    } jog;
+    char path[COMMAND_PATH_SIZE];
+  } args;
+  command_done_t done; // May be NULL.
+  void *user_data;
+} command_t;
+
+// Real-time commands
+typedef enum {
+  COMMAND_RT_FEED_HOLD,
+  COMMAND_RT_CYCLE_START,
+  COMMAND_RT_RESET,
+  COMMAND_RT_JOG_CANCEL,
+  COMMAND_RT_FEED_OVR_RESET,
+  COMMAND_RT_FEED_OVR_COARSE_PLUS,
+  COMMAND_RT_FEED_OVR_COARSE_MINUS,
+  COMMAND_RT_FEED_OVR_FINE_PLUS,
+  COMMAND_RT_FEED_OVR_FINE_MINUS,
+  COMMAND_RT_RAPID_OVR_RESET,
+  COMMAND_RT_RAPID_OVR_MEDIUM,
+  COMMAND_RT_RAPID_OVR_LOW,
+  COMMAND_RT_SPINDLE_OVR_RESET,
+  COMMAND_RT_SPINDLE_OVR_COARSE_PLUS,
+  COMMAND_RT_SPINDLE_OVR_COARSE_MINUS,
+  COMMAND_RT_SPINDLE_OVR_FINE_PLUS,
+  COMMAND_RT_SPINDLE_OVR_FINE_MINUS,
+  COMMAND_RT_COUNT
+} command_realtime_t;
+
+// Any thread. Copies the command, false if the queue is full. Commands posted before GRBL
+// starts (or before a reset) are executed when the main loop runs.
+bool command_post(const command_t *command);
+
+// Any thread, ISRs too.
+void command_realtime(command_realtime_t command);
+
+// Executes the posted commands. Called by the main program between the lines. Returns true if
+// anything was done.
+bool command_execute();
+
+#ifdef __cplusplus
+}
+#endif
+#endif
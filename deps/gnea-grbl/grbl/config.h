@@ -497,6 +497,25 @@
 // #define HOMING_AXIS_SEARCH_SCALAR  1.5 // Uncomment to override defaults in limits.c.
 // #define HOMING_AXIS_LOCATE_SCALAR  10.0 // Uncomment to override defaults in limits.c.
 
+// Enables the framed binary motion stream on the serial port (see binary_stream.h). The host
+// sends motion records already parsed, which skip the g-code parser and enter the planner
+// directly, and are acknowledged in windows rather than line by line. Text g-code keeps working.
+#define ENABLE_BINARY_STREAM // Default enabled. Comment to disable.
+
+// Plain G0/G1 lines with axis words (and optionally F and N only), the bulk of a typical job, are
+// tokenized in one pass and sent to the planner without going through the full g-code parser.
+// Every other line, including invalid ones, still goes through the full parser. About 10% faster
+// on linear moves, but no faster on jobs with many arcs (test/host/gcode-benchmark).
+// #define ENABLE_GCODE_FAST_PATH // Default disabled. Uncomment to enable.
+
+// O-word subroutines and loops (sub/endsub/call, repeat/endrepeat, while/endwhile, see oword.h).
+// Bodies are stored in a RAM arena, so repeated geometry is sent and parsed as text only once.
+#define ENABLE_O_WORDS // Default enabled. Comment to disable.
+
+// Sample rate of the binary telemetry stream (see telemetry.h). The stream exists only if the
+// device tree has the grbltelemetryuart alias. 1 kHz costs about 32 kB/s on that port.
+#define TELEMETRY_RATE_HZ 1000
+
 // Enable the '$RST=*', '$RST=$', and '$RST=#' eeprom restore commands. There are cases where
 // these commands may be undesirable. Simply comment the desired macro to disable it.
 // NOTE: See SETTINGS_RESTORE_ALL macro for customizing the `$RST=*` command.
@@ -533,7 +552,9 @@
 // NOTE: Most EEPROM write commands are implicitly blocked during a job (all '$' commands). However,
 // coordinate set g-code commands (G10,G28/30.1) are not, since they are part of an active streaming
 // job. At this time, this option only forces a planner buffer sync with these g-code commands.
-#define FORCE_BUFFER_SYNC_DURING_EEPROM_WRITE // Default enabled. Comment to disable.
+// NOTE: Disabled here. The EEPROM is emulated in RAM (eeprom.c) and written to the flash only once
+// the machine stands still (settings_flush), so these g-codes neither stop the motion nor stall it.
+// #define FORCE_BUFFER_SYNC_DURING_EEPROM_WRITE // Default enabled. Comment to disable.
 
 // In Grbl v0.9 and prior, there is an old outstanding bug where the `WPos:` work position reported
 // may not correlate to what is executing, because `WPos:` is based on the g-code parser state, which
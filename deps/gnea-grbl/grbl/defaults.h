@@ -594,6 +594,7 @@
 #define DEFAULT_DIRECTION_INVERT_MASK 0
 #define DEFAULT_STEPPER_IDLE_LOCK_TIME 100 // msec (0-254, 255 keeps steppers enabled)
 #define DEFAULT_STATUS_REPORT_MASK 1       // MPos enabled
+#define DEFAULT_STATUS_AUTO_REPORT_INTERVAL 0 // msec (0-65535, 0 disables)
 #define DEFAULT_JUNCTION_DEVIATION 0.02    // mm
 #define DEFAULT_ARC_TOLERANCE 0.002        // mm
 #define DEFAULT_REPORT_INCHES 0            
@@ -11,32 +11,94 @@
 #include <zephyr/drivers/flash.h>
 #include <zephyr/storage/flash_map.h>
 #include <zephyr/fs/nvs.h>
+#include <string.h>
 
 LOG_MODULE_REGISTER(eeprom);
 
-/* These EEPROM bits have different names on different devices. */
-#ifndef EEPE
-		#define EEPE  EEWE  //!< EEPROM program/write enable.
-		#define EEMPE EEMWE //!< EEPROM master program/write enable.
-#endif
-
-/* These two are unfortunately not defined in the device include files. */
-#define EEPM1 5 //!< EEPROM Programming Mode Bit 1.
-#define EEPM0 4 //!< EEPROM Programming Mode Bit 0.
-
-/* Define to reduce code size. */
-#define EEPROM_IGNORE_SELFPROG //!< Remove SPM flag polling.
+/*
+  The EEPROM is emulated with a RAM shadow of the whole layout (settings.h). Reads never touch
+  the flash. A write changes the shadow and marks the record it belongs to as dirty, and
+  eeprom_flush stores every dirty record as one NVS entry (NVS skips the ones whose data didn't
+  change). The records are the ones GRBL writes as a whole: the version byte with the global
+  settings (only read now, to take them over, see settings.c), every coordinate set, every
+  startup line and the build info. GRBL flushes only while the machine stands still
+  (settings_flush), so a G10 in the middle of a job never stops the CPU on a flash write while
+  the steppers run, it's stored at the end of the job. At boot the shadow is
+  loaded from the NVS, a missing or resized record reads as erased (0xff) and fails its checksum,
+  so GRBL restores its defaults like it would with a blank EEPROM.
+*/
+
+#define RECORD_COORD_SIZE (sizeof(float)*N_AXIS+1)
+#define RECORD_LINE_SIZE (LINE_BUFFER_SIZE+1)
+#define RECORD_COORD_FIRST 1
+#define RECORD_LINE_FIRST (RECORD_COORD_FIRST+SETTING_INDEX_NCOORD+1)
+#define RECORD_BUILD_INFO (RECORD_LINE_FIRST+N_STARTUP_LINE)
+#define RECORD_COUNT (RECORD_BUILD_INFO+1)
+
+_Static_assert(RECORD_COUNT <= 32, "One dirty bit per record");
+_Static_assert(EEPROM_ADDR_GLOBAL+sizeof(settings_t)+1 <= EEPROM_ADDR_PARAMETERS, "Settings overlap the coordinates");
+_Static_assert(EEPROM_ADDR_PARAMETERS+(SETTING_INDEX_NCOORD+1)*RECORD_COORD_SIZE <= EEPROM_ADDR_STARTUP_BLOCK, "Coordinates overlap the startup lines");
+_Static_assert(EEPROM_ADDR_STARTUP_BLOCK+N_STARTUP_LINE*RECORD_LINE_SIZE <= EEPROM_ADDR_BUILD_INFO, "Startup lines overlap the build info");
+_Static_assert(EEPROM_ADDR_BUILD_INFO+RECORD_LINE_SIZE <= EEPROM_SIZE, "Build info past the end");
+
+typedef struct {
+  uint16_t addr;
+  uint16_t size;
+} eeprom_record_t;
 
 static struct nvs_fs fs;
+static bool nvs_ready;
+K_MUTEX_DEFINE(eeprom_nvs_mutex);
+static uint8_t shadow[EEPROM_SIZE];
+static uint32_t dirty; // Records changed since the last flush, bit per record.
 
 #define STORAGE_NODE DT_NODE_BY_FIXED_PARTITION_LABEL(storage)
 #define FLASH_NODE DT_MTD_FROM_FIXED_PARTITION(STORAGE_NODE)
 #define ADDRESS_ID 1
 #define RBT_CNT_ID 3
 
+static eeprom_record_t eeprom_record(uint8_t record)
+{
+  eeprom_record_t r;
+  if (record == 0) {
+    r.addr = 0; r.size = EEPROM_ADDR_GLOBAL+sizeof(settings_t)+1;
+  } else if (record < RECORD_LINE_FIRST) {
+    r.addr = EEPROM_ADDR_PARAMETERS+(record-RECORD_COORD_FIRST)*RECORD_COORD_SIZE; r.size = RECORD_COORD_SIZE;
+  } else if (record < RECORD_BUILD_INFO) {
+    r.addr = EEPROM_ADDR_STARTUP_BLOCK+(record-RECORD_LINE_FIRST)*RECORD_LINE_SIZE; r.size = RECORD_LINE_SIZE;
+  } else {
+    r.addr = EEPROM_ADDR_BUILD_INFO; r.size = RECORD_LINE_SIZE;
+  }
+  return(r);
+}
+
+// Marks the records overlapping [addr, addr+size). Bytes outside of the records are not stored.
+static void eeprom_mark_dirty(unsigned int addr, unsigned int size)
+{
+  uint8_t record;
+  for (record = 0; record < RECORD_COUNT; record++) {
+    eeprom_record_t r = eeprom_record(record);
+    if (addr < r.addr+r.size && r.addr < addr+size) { dirty |= (1UL << record); }
+  }
+}
+
+static void eeprom_load()
+{
+  uint8_t record;
+  memset(shadow, 0xff, sizeof(shadow));
+  eeprom_nvs_lock(); // The journal thread may start using the NVS as soon as it's ready.
+  for (record = 0; record < RECORD_COUNT; record++) {
+    eeprom_record_t r = eeprom_record(record);
+    if (nvs_read(&fs, EEPROM_NVS_ID+record, &shadow[r.addr], r.size) != r.size) {
+      memset(&shadow[r.addr], 0xff, r.size);
+    }
+  }
+  eeprom_nvs_unlock();
+  dirty = 0;
+}
+
 void init_nvs ()
 {
-  return;
         const struct device *flash_dev;
 		int rc;
 
@@ -68,6 +130,9 @@ void init_nvs ()
                 return;
         }
 
+        nvs_ready = true;
+        eeprom_load();
+
 		//       /* RBT_CNT_ID is used to store the reboot counter, lets see
         //  * if we can read it from flash
         //  */
@@ -110,124 +175,72 @@ void init_nvs ()
 
 }
 
-/*! \brief  Read byte from EEPROM.
- *
- *  This function reads one byte from a given EEPROM address.
- *
- *  \note  The CPU is halted for 4 clock cycles during EEPROM read.
- *
- *  \param  addr  EEPROM address to read from.
- *  \return  The byte read from the EEPROM address.
- */
+struct nvs_fs *eeprom_nvs ()
+{
+        return (nvs_ready) ? &fs : NULL;
+}
+
+void eeprom_nvs_lock () { k_mutex_lock(&eeprom_nvs_mutex, K_FOREVER); }
+void eeprom_nvs_unlock () { k_mutex_unlock(&eeprom_nvs_mutex); }
+
 unsigned char eeprom_get_char( unsigned int addr )
 {
-	/*
-	do {} while( EECR & (1<<EEPE) ); // Wait for completion of previous write.
-	EEAR = addr; // Set EEPROM address register.
-	EECR = (1<<EERE); // Start EEPROM read operation.
-	return EEDR; // Return the byte read from EEPROM.
-	*/
-	return 0;
+  return((addr < EEPROM_SIZE) ? shadow[addr] : 0);
 }
 
-/*! \brief  Write byte to EEPROM.
- *
- *  This function writes one byte to a given EEPROM address.
- *  The differences between the existing byte and the new value is used
- *  to select the most efficient EEPROM programming mode.
- *
- *  \note  The CPU is halted for 2 clock cycles during EEPROM programming.
- *
- *  \note  When this function returns, the new EEPROM value is not available
- *         until the EEPROM programming time has passed. The EEPE bit in EECR
- *         should be polled to check whether the programming is finished.
- *
- *  \note  The EEPROM_GetChar() function checks the EEPE bit automatically.
- *
- *  \param  addr  EEPROM address to write to.
- *  \param  new_value  New EEPROM value.
- */
 void eeprom_put_char( unsigned int addr, unsigned char new_value )
 {
-	/*
-	char old_value; // Old EEPROM value.
-	char diff_mask; // Difference mask, i.e. old value XOR new value.
-
-	cli(); // Ensure atomic operation for the write operation.
-
-	do {} while( EECR & (1<<EEPE) ); // Wait for completion of previous write.
-	#ifndef EEPROM_IGNORE_SELFPROG
-	do {} while( SPMCSR & (1<<SELFPRGEN) ); // Wait for completion of SPM.
-	#endif
-
-	EEAR = addr; // Set EEPROM address register.
-	EECR = (1<<EERE); // Start EEPROM read operation.
-	old_value = EEDR; // Get old EEPROM value.
-	diff_mask = old_value ^ new_value; // Get bit differences.
-
-	// Check if any bits are changed to '1' in the new value.
-	if( diff_mask & new_value ) {
-		// Now we know that _some_ bits need to be erased to '1'.
-
-		// Check if any bits in the new value are '0'.
-		if( new_value != 0xff ) {
-			// Now we know that some bits need to be programmed to '0' also.
-
-			EEDR = new_value; // Set EEPROM data register.
-			EECR = (1<<EEMPE) | // Set Master Write Enable bit...
-			       (0<<EEPM1) | (0<<EEPM0); // ...and Erase+Write mode.
-			EECR |= (1<<EEPE);  // Start Erase+Write operation.
-		} else {
-			// Now we know that all bits should be erased.
-
-			EECR = (1<<EEMPE) | // Set Master Write Enable bit...
-			       (1<<EEPM0);  // ...and Erase-only mode.
-			EECR |= (1<<EEPE);  // Start Erase-only operation.
-		}
-	} else {
-		// Now we know that _no_ bits need to be erased to '1'.
-
-		// Check if any bits are changed from '1' in the old value.
-		if( diff_mask ) {
-			// Now we know that _some_ bits need to the programmed to '0'.
-
-			EEDR = new_value;   // Set EEPROM data register.
-			EECR = (1<<EEMPE) | // Set Master Write Enable bit...
-			       (1<<EEPM1);  // ...and Write-only mode.
-			EECR |= (1<<EEPE);  // Start Write-only operation.
-		}
-	}
-
-	sei(); // Restore interrupt flag state.
-	*/
+  if (addr >= EEPROM_SIZE || shadow[addr] == new_value) { return; }
+  shadow[addr] = new_value;
+  eeprom_mark_dirty(addr, 1);
 }
 
-// Extensions added as part of Grbl
+bool eeprom_flush()
+{
+  uint8_t record;
+  if (dirty == 0) { return(true); }
+  if (!nvs_ready) { return(false); }
+  eeprom_nvs_lock();
+  for (record = 0; record < RECORD_COUNT; record++) {
+    if (!(dirty & (1UL << record))) { continue; }
+    eeprom_record_t r = eeprom_record(record);
+    int rc = nvs_write(&fs, EEPROM_NVS_ID+record, &shadow[r.addr], r.size);
+    if (rc < 0) {
+      LOG_ERR("Record %u not stored (%d)", record, rc);
+      continue; // Stays dirty, retried with the next flush.
+    }
+    dirty &= ~(1UL << record);
+  }
+  eeprom_nvs_unlock();
+  return(dirty == 0);
+}
 
+// Extensions added as part of Grbl
 
-void memcpy_to_eeprom_with_checksum(unsigned int destination, char *source, unsigned int size) {
-	/*
+static unsigned char eeprom_checksum(const char *data, unsigned int size)
+{
   unsigned char checksum = 0;
   for(; size > 0; size--) {
-    checksum = (checksum << 1) || (checksum >> 7);
-    checksum += *source;
-    eeprom_put_char(destination++, *(source++));
+    checksum = (checksum << 1) | (checksum >> 7);
+    checksum += *(data++);
   }
-  eeprom_put_char(destination, checksum);
-  */
+  return(checksum);
 }
 
-int memcpy_from_eeprom_with_checksum(char *destination, unsigned int source, unsigned int size) {
-  unsigned char checksum = 0;
-  /*
-  for(; size > 0; size--) {
-    data = eeprom_get_char(source++);
-    checksum = (checksum << 1) || (checksum >> 7);
-    checksum += data;
-    *(destination++) = data;
+void memcpy_to_eeprom_with_checksum(unsigned int destination, char *source, unsigned int size) {
+  if (destination+size >= EEPROM_SIZE) { return; }
+  unsigned char checksum = eeprom_checksum(source, size);
+  if (memcmp(&shadow[destination], source, size) != 0 || shadow[destination+size] != checksum) {
+    memcpy(&shadow[destination], source, size);
+    shadow[destination+size] = checksum;
+    eeprom_mark_dirty(destination, size+1);
   }
-  */
-  return(checksum == eeprom_get_char(source));
+}
+
+int memcpy_from_eeprom_with_checksum(char *destination, unsigned int source, unsigned int size) {
+  if (source+size >= EEPROM_SIZE) { return(false); }
+  memcpy(destination, &shadow[source], size);
+  return(eeprom_checksum(destination, size) == shadow[source+size]);
 }
 
 // end of file
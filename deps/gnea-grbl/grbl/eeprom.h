@@ -20,14 +20,39 @@
 
 #ifndef eeprom_h
 #define eeprom_h
+#include <stdbool.h>
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /// Zephyr RTOS requires some initialization before NVS can be used.
 void init_nvs ();
+
+struct nvs_fs;
+
+/// The NVS on the storage partition, NULL until init_nvs succeeds. IDs from 0x10 are the EEPROM
+/// records, 0x20-0x22 the global settings (settings.h), from 0x100 up the SD job journal
+/// (src/sdJournal.cc).
+struct nvs_fs *eeprom_nvs ();
+
+/// The GRBL main thread and the journal thread both write to the NVS, NVS itself doesn't lock
+/// against that. Everybody holds this lock around their NVS calls (and reads of its state).
+void eeprom_nvs_lock ();
+void eeprom_nvs_unlock ();
+
+// Size of the emulated EEPROM, see the layout in settings.h.
+#define EEPROM_SIZE 1024U
+#define EEPROM_NVS_ID 0x10 // Of the first record (the legacy global settings), one ID per record.
+
+// Reads and writes go to a RAM shadow. Writes are stored in the NVS by eeprom_flush, a record
+// (settings, a coordinate set, a startup line, the build info) at a time.
 unsigned char eeprom_get_char(unsigned int addr);
 void eeprom_put_char(unsigned int addr, unsigned char new_value);
+// Stores the records changed since the last flush. False if some of them failed (they are
+// tried again next time) or the NVS is not there. Stops the CPU while the flash is written,
+// see settings_flush.
+bool eeprom_flush();
+
 void memcpy_to_eeprom_with_checksum(unsigned int destination, char *source, unsigned int size);
 int memcpy_from_eeprom_with_checksum(char *destination, unsigned int source, unsigned int size);
 
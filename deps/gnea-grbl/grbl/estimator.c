@@ -0,0 +1,234 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#include "grbl.h"
+
+#if ESTIMATOR_N_AXIS != N_AXIS
+  #error "ESTIMATOR_N_AXIS must be equal to N_AXIS"
+#endif
+
+// The same as in protocol.c.
+#define LINE_FLAG_OVERFLOW bit(0)
+#define LINE_FLAG_COMMENT_PARENTHESES bit(1)
+#define LINE_FLAG_COMMENT_SEMICOLON bit(2)
+
+#define ESTIMATOR_REALTIME_LINES 16 // Between the checks of the real-time commands.
+#define ESTIMATOR_VERSION 2 // Part of the settings hash, so cached estimates go when this file changes.
+
+static bool active;
+static bool failed;
+static bool has_bounds;
+static estimate_t est;
+static parser_state_t saved_parser;
+#ifdef ENABLE_O_WORDS
+  static oword_mark_t saved_owords; // The host's subroutines, the job's go after them.
+#endif
+static float last_target[N_AXIS];
+static char line[LINE_BUFFER_SIZE];
+static uint8_t char_counter;
+static uint8_t line_flags;
+static bool line_started; // Any byte since the last line break.
+
+
+// Time of a velocity profile [min]: from the entry speed to the nominal one, cruise, down to the
+// exit speed. Without room for the cruise, up to where the two meet. Speeds in mm/min.
+static float estimator_profile_minutes(float entry_speed_sqr, float exit_speed_sqr, float nominal_speed,
+                                       float acceleration, float millimeters)
+{
+  float entry_speed = sqrtf(entry_speed_sqr);
+  float exit_speed = sqrtf(exit_speed_sqr);
+  float nominal_speed_sqr = nominal_speed*nominal_speed;
+  // Distances to get from the entry speed to the nominal one (slowing down after an override
+  // too) and from the nominal one to the exit speed.
+  float accelerate_mm = fabsf(nominal_speed_sqr-entry_speed_sqr)/(2*acceleration);
+  float decelerate_mm = fabsf(nominal_speed_sqr-exit_speed_sqr)/(2*acceleration);
+  float cruise_mm = millimeters-accelerate_mm-decelerate_mm;
+
+  if (cruise_mm >= 0.0) {
+    return((fabsf(nominal_speed-entry_speed)+fabsf(nominal_speed-exit_speed))/acceleration+cruise_mm/nominal_speed);
+  }
+  if (entry_speed_sqr > nominal_speed_sqr) {
+    // Slowing down all the way, from above the nominal speed.
+    return(2*millimeters/max(entry_speed+exit_speed,MINIMUM_FEED_RATE));
+  }
+  float peak_speed_sqr = 0.5*(2*acceleration*millimeters+entry_speed_sqr+exit_speed_sqr);
+  float peak_speed = sqrtf(max(peak_speed_sqr,max(entry_speed_sqr,exit_speed_sqr)));
+  return((2*peak_speed-entry_speed-exit_speed)/acceleration);
+}
+
+
+// What the steppers would do with the oldest block.
+static void estimator_execute_block()
+{
+  plan_block_t *block = plan_get_current_block();
+  if (block == NULL) { return; }
+  est.seconds += 60.0*estimator_profile_minutes(block->entry_speed_sqr, plan_get_exec_block_exit_speed_sqr(),
+                                                plan_compute_profile_nominal_speed(block), block->acceleration,
+                                                block->millimeters);
+  est.blocks++;
+  plan_discard_current_block();
+}
+
+
+static void estimator_execute_line()
+{
+  line[char_counter] = 0;
+  uint8_t status = STATUS_OK;
+  if (line_flags & LINE_FLAG_OVERFLOW) {
+    status = STATUS_OVERFLOW;
+  } else if ((line[0] == 0) || (line[0] == '$') || ((line[0] == '%') && (line[1] == 0))) {
+    return; // Settings, homing and jogging are not a part of the job. Nor the '%' around it.
+  } else {
+    #ifdef ENABLE_O_WORDS
+      status = oword_execute_line(line);
+    #else
+      status = gc_execute_line(line);
+    #endif
+  }
+  if (status != STATUS_OK) {
+    est.status = status;
+    failed = true;
+  }
+}
+
+
+// Lines with anything in them are counted, comments, '$' and '%' ones too. The SD job sends
+// them all and counts their replies, out of these lines.
+static void estimator_end_line()
+{
+  if (line_started) { est.lines++; }
+  estimator_execute_line();
+  // Nothing moves in check mode, so motion control doesn't run the real-time commands. Status
+  // reports are answered on the way, and a reset stops the estimate.
+  if (line_started && ((est.lines % ESTIMATOR_REALTIME_LINES) == 0)) { protocol_execute_realtime(); }
+  line_started = false;
+  line_flags = 0;
+  char_counter = 0;
+}
+
+
+uint8_t estimator_begin()
+{
+  if ((sys.state != STATE_IDLE) || plan_get_current_block() || mc_get_queued_motion_count()) { return(STATUS_IDLE_ERROR); }
+  #ifdef ENABLE_O_WORDS
+    if (!oword_mark(&saved_owords)) { return(STATUS_IDLE_ERROR); } // The host is sending a sub or a loop.
+  #endif
+  memcpy(&saved_parser, &gc_state, sizeof(parser_state_t));
+  memset(&est, 0, sizeof(estimate_t));
+  memcpy(last_target, gc_state.position, sizeof(last_target));
+  failed = false;
+  has_bounds = false;
+  char_counter = 0;
+  line_flags = 0;
+  line_started = false;
+  active = true;
+  sys.state = STATE_CHECK_MODE; // Motion control, spindle and coolant leave the hardware alone.
+  return(STATUS_OK);
+}
+
+
+bool estimator_feed(const uint8_t *data, uint32_t len)
+{
+  for (; len > 0 && !failed && !sys.abort; data++, len--) {
+    uint8_t c = *data;
+    if ((c == '\n') || (c == '\r')) {
+      estimator_end_line();
+      continue;
+    }
+    line_started = true;
+    if (line_flags) {
+      if ((c == ')') && (line_flags & LINE_FLAG_COMMENT_PARENTHESES)) { line_flags &= ~(LINE_FLAG_COMMENT_PARENTHESES); }
+    } else if ((c <= ' ') || (c == '/')) {
+      // White space and block delete.
+    } else if (c == '(') {
+      line_flags |= LINE_FLAG_COMMENT_PARENTHESES;
+    } else if (c == ';') {
+      line_flags |= LINE_FLAG_COMMENT_SEMICOLON;
+    } else if (char_counter >= (LINE_BUFFER_SIZE-1)) {
+      line_flags |= LINE_FLAG_OVERFLOW;
+    } else if (c >= 'a' && c <= 'z') {
+      line[char_counter++] = c-'a'+'A';
+    } else {
+      line[char_counter++] = c;
+    }
+  }
+  return(!failed && !sys.abort);
+}
+
+
+void estimator_end(estimate_t *estimate)
+{
+  if (!active) { return; }
+  if (!failed && !sys.abort) { estimator_end_line(); } // The last line may have no line feed.
+  estimator_sync();
+  if (sys.abort && (est.status == STATUS_OK)) { est.status = STATUS_ESTIMATE_ABORTED; }
+  #ifdef ENABLE_O_WORDS
+    oword_release(&saved_owords); // The subroutines of the job.
+  #endif
+  memcpy(&gc_state, &saved_parser, sizeof(parser_state_t));
+  plan_reset();
+  plan_sync_position();
+  sys.state = STATE_IDLE;
+  sys.report_wco_counter = 0; // The offsets went back, report them.
+  active = false;
+  if (estimate) { memcpy(estimate, &est, sizeof(estimate_t)); }
+}
+
+
+bool estimator_active() { return(active); }
+
+
+uint32_t estimator_settings_hash()
+{
+  // FNV-1a over everything the planner uses, and more. A needless estimate is cheap.
+  uint32_t hash = 2166136261u;
+  const uint8_t *data = (const uint8_t *)&settings;
+  uint16_t idx;
+  for (idx = 0; idx < sizeof(settings_t); idx++) { hash = (hash ^ data[idx])*16777619u; }
+  hash = (hash ^ sys.f_override)*16777619u;
+  hash = (hash ^ sys.r_override)*16777619u;
+  hash = (hash ^ ESTIMATOR_VERSION)*16777619u;
+  return(hash);
+}
+
+
+void estimator_before_line(float *target)
+{
+  if (!active) { return; }
+  if (plan_check_full_buffer()) { estimator_execute_block(); }
+
+  uint8_t idx;
+  float distance_sqr = 0.0;
+  for (idx=0; idx<N_AXIS; idx++) {
+    float delta = target[idx]-last_target[idx];
+    distance_sqr += delta*delta;
+    last_target[idx] = target[idx];
+    float work = target[idx]-gc_state.coord_system[idx]-gc_state.coord_offset[idx];
+    if (idx == TOOL_LENGTH_OFFSET_AXIS) { work -= gc_state.tool_length_offset; }
+    if (!has_bounds || (work < est.min[idx])) { est.min[idx] = work; }
+    if (!has_bounds || (work > est.max[idx])) { est.max[idx] = work; }
+  }
+  has_bounds = true;
+  est.distance += sqrtf(distance_sqr);
+
+  if (bit_istrue(settings.flags,BITFLAG_HOMING_ENABLE) && system_check_travel_limits(target)) { est.outside = true; }
+}
+
+
+void estimator_dwell(float seconds)
+{
+  if (!active) { return; }
+  estimator_sync();
+  est.seconds += seconds;
+}
+
+
+void estimator_sync()
+{
+  while (plan_get_current_block()) { estimator_execute_block(); }
+}
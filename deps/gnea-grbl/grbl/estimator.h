@@ -0,0 +1,77 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#ifndef estimator_h
+#define estimator_h
+#include <stdbool.h>
+#include <stdint.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Time and bounds of a job, without moving the machine. The lines go through the parser and
+  the planner as usual, in check mode, but a virtual clock takes the place of the steppers:
+  whenever the planner buffer is full, the oldest block is taken out and the clock advances by
+  the time of its velocity profile, from its planned entry speed to the entry speed of the next
+  block. The buffer stays as full as it is while streaming, so the junction speeds are the ones
+  the machine would get. Where the machine would wait for the buffer to empty (dwell, program
+  end, a WCO change with FORCE_BUFFER_SYNC_DURING_WCO_CHANGE) all the blocks are run down to a
+  stop.
+
+  Nothing moves and nothing is stored: G10, G28.1 and G30.1 don't write the EEPROM, and the
+  parser state is restored at the end. The current overrides apply. '$' and '%' lines are skipped.
+  Runs in the main thread with the machine idle. The real-time commands are executed every few
+  lines, a reset stops the estimate with STATUS_ESTIMATE_ABORTED.
+*/
+
+// N_AXIS. This header is included from C++, where nuts_bolts.h can't be (see RESUME_N_AXIS).
+#define ESTIMATOR_N_AXIS 3
+
+typedef struct {
+  float seconds;                 // Motions and dwells.
+  float distance;                // Of all the motions [mm], not of the motors (CoreXY).
+  float min[ESTIMATOR_N_AXIS];   // Box around the motion targets, in the work coordinates [mm].
+  float max[ESTIMATOR_N_AXIS];
+  uint32_t lines;                // Not empty, '$', '%' and comment ones too (they're sent).
+  uint32_t blocks;               // Planned.
+  uint8_t outside;               // Some target outside the travel ($130..$132). Only with homing enabled.
+  uint8_t status;                // Of the first failed line, where the estimate stopped. STATUS_OK.
+} estimate_t;
+
+// Starts an estimate. STATUS_IDLE_ERROR unless the machine is idle with nothing planned, and
+// no O-word block is being received (oword.h).
+uint8_t estimator_begin();
+
+// Raw bytes of the job. They are cleaned up and split into lines the way protocol_main_loop
+// does it, and executed. Returns false once a line failed, or on abort. Then the rest is ignored.
+bool estimator_feed(const uint8_t *data, uint32_t len);
+
+// Executes the last line if it has no line feed, runs the planner down and restores the parser
+// and the planner. estimate may be NULL.
+void estimator_end(estimate_t *estimate);
+
+bool estimator_active();
+
+// Changes when the settings or overrides the estimates depend on change. For the cached ones.
+uint32_t estimator_settings_hash();
+
+// Estimates a whole file, from `$E=path`. Implemented by the application, which knows where the
+// files are (src/sdEstimate.cc). Returns the status of the estimate or of reading the file.
+uint8_t estimator_run_file(const char *path, estimate_t *estimate);
+
+// Motion control hooks, no-ops unless an estimate is running. Before a motion is planned (makes
+// room in the buffer), at a dwell and in place of a buffer synchronization.
+void estimator_before_line(float *target);
+void estimator_dwell(float seconds);
+void estimator_sync();
+
+#ifdef __cplusplus
+}
+#endif
+#endif
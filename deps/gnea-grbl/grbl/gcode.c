@@ -58,12 +58,151 @@ void gc_sync_position()
 }
 
 
+#ifdef ENABLE_GCODE_FAST_PATH
+  // Word table slots of the fast path. Axis words use their axis index.
+  #define FAST_WORD_F N_AXIS
+  #define FAST_WORD_N (N_AXIS+1)
+  #define FAST_WORD_G (N_AXIS+2)
+  #define FAST_WORD_COUNT (N_AXIS+3)
+
+  // The word table slot of a letter the fast path takes, FAST_WORD_COUNT for any other.
+  static uint8_t gc_fast_word(char letter)
+  {
+    switch (letter) {
+      case 'X': return(X_AXIS);
+      case 'Y': return(Y_AXIS);
+      case 'Z': return(Z_AXIS);
+      case 'F': return(FAST_WORD_F);
+      case 'N': return(FAST_WORD_N);
+      case 'G': return(FAST_WORD_G);
+      default: return(FAST_WORD_COUNT);
+    }
+  }
+
+  // Executes a plain linear motion, a line with nothing but axis words and optionally G0/G1, F and
+  // N, in G94 mode. The letters (and the G number) are checked first, so a line of any other
+  // kind (an arc, an M command) is handed to the full parser before a single number is
+  // converted, most of them at the first word. Then the numbers
+  // are read, and the target and the planner data are built straight from the word table, with
+  // the same arithmetic as the full parser, which needs no parser block. Returns false without
+  // touching anything if the line is something else, or is invalid, so the full parser can
+  // handle it or report the error.
+  static bool gc_execute_fast_motion(char *line)
+  {
+    if (gc_state.modal.feed_rate != FEED_RATE_MODE_UNITS_PER_MIN) { return(false); } // G93 rules.
+
+    uint8_t words = 0;
+    uint8_t char_counter;
+    uint8_t word;
+
+    for (char_counter = 0; line[char_counter] != 0; char_counter++) {
+      char c = line[char_counter];
+      if ((c < 'A') || (c > 'Z')) { continue; } // A digit, a sign or a dot of a number.
+      word = gc_fast_word(c);
+      if (word == FAST_WORD_COUNT) { return(false); }
+      if (bit_istrue(words,bit(word))) { return(false); } // Repeated.
+      words |= bit(word);
+
+      // G0, G1, G00, G01 and nothing else, told by the text. G02 is given up on right there.
+      if (word == FAST_WORD_G) {
+        uint8_t digit = char_counter+1;
+        while (line[digit] == '0') { digit++; }
+        if (line[digit] == '1') { digit++; }
+        if ((digit == char_counter+1) || ((line[digit] != 0) && ((line[digit] < 'A') || (line[digit] > 'Z')))) { return(false); }
+      }
+    }
+
+    uint8_t axis_words = words & ((1<<N_AXIS)-1);
+    if (!axis_words) { return(false); } // Motion mode change only, or no motion.
+
+    float value[FAST_WORD_COUNT];
+    char_counter = 0;
+    while (line[char_counter] != 0) {
+      word = gc_fast_word(line[char_counter++]);
+      if ((word == FAST_WORD_COUNT) || !read_float(line, &char_counter, &value[word])) { return(false); }
+    }
+
+    uint8_t motion = gc_state.modal.motion;
+    if (bit_istrue(words,bit(FAST_WORD_G))) {
+      motion = (value[FAST_WORD_G] == 0.0) ? MOTION_MODE_SEEK : MOTION_MODE_LINEAR;
+    }
+    if ((motion != MOTION_MODE_SEEK) && (motion != MOTION_MODE_LINEAR)) { return(false); }
+
+    int32_t line_number = 0;
+    if (bit_istrue(words,bit(FAST_WORD_N))) {
+      if (value[FAST_WORD_N] < 0.0) { return(false); }
+      line_number = trunc(value[FAST_WORD_N]);
+      if (line_number > MAX_LINE_NUMBER) { return(false); }
+    }
+
+    float feed_rate = gc_state.feed_rate;
+    if (bit_istrue(words,bit(FAST_WORD_F))) {
+      feed_rate = value[FAST_WORD_F];
+      if (feed_rate < 0.0) { return(false); }
+      if (gc_state.modal.units == UNITS_MODE_INCHES) { feed_rate *= MM_PER_INCH; }
+    }
+    if ((motion == MOTION_MODE_LINEAR) && (feed_rate == 0.0)) { return(false); }
+
+    float target[N_AXIS];
+    uint8_t idx;
+    for (idx=0; idx<N_AXIS; idx++) {
+      if (bit_isfalse(axis_words,bit(idx))) {
+        target[idx] = gc_state.position[idx];
+        continue;
+      }
+      target[idx] = value[idx];
+      if (gc_state.modal.units == UNITS_MODE_INCHES) { target[idx] *= MM_PER_INCH; }
+      if (gc_state.modal.distance == DISTANCE_MODE_ABSOLUTE) {
+        target[idx] += gc_state.coord_system[idx] + gc_state.coord_offset[idx];
+        if (idx == TOOL_LENGTH_OFFSET_AXIS) { target[idx] += gc_state.tool_length_offset; }
+      } else {
+        target[idx] += gc_state.position[idx];
+      }
+    }
+
+    // Valid. From here on the same state changes as the full parser makes for this line.
+    plan_line_data_t plan_data;
+    plan_line_data_t *pl_data = &plan_data;
+    memset(pl_data,0,sizeof(plan_line_data_t));
+
+    gc_state.line_number = line_number;
+    #ifdef USE_LINE_NUMBERS
+      pl_data->line_number = line_number;
+    #endif
+    gc_state.feed_rate = feed_rate;
+    pl_data->feed_rate = feed_rate;
+    // G0 in laser mode is a restricted motion, moves with the laser off.
+    if (!((motion == MOTION_MODE_SEEK) && bit_istrue(settings.flags,BITFLAG_LASER_MODE))) {
+      pl_data->spindle_speed = gc_state.spindle_speed;
+    }
+    gc_state.tool = 0; // Like the full parser does for a line without a T word.
+    pl_data->condition = gc_state.modal.spindle | gc_state.modal.coolant;
+    gc_state.modal.motion = motion;
+    if (motion == MOTION_MODE_SEEK) { pl_data->condition |= PL_COND_FLAG_RAPID_MOTION; }
+
+    mc_line(target, pl_data);
+    memcpy(gc_state.position, target, sizeof(target));
+    return(true);
+  }
+#endif
+
+
 // Executes one line of 0-terminated G-Code. The line is assumed to contain only uppercase
 // characters and signed floating point values (no whitespace). Comments and block delete
 // characters have been removed. In this function, all units and positions are converted and
 // exported to grbl's internal functions in terms of (mm, mm/min) and absolute machine
 // coordinates, respectively.
 uint8_t gc_execute_line(char *line)
+{
+  #ifdef ENABLE_GCODE_FAST_PATH
+    if (gc_execute_fast_motion(line)) { return(STATUS_OK); }
+  #endif
+  return(gc_execute_line_full(line));
+}
+
+
+// The full parser. Handles every line gc_execute_line() can get.
+uint8_t gc_execute_line_full(char *line)
 {
   /* -------------------------------------------------------------------------------------
      STEP 1: Initialize parser block struct and copy current g-code state modes. The parser
@@ -1010,7 +1149,7 @@ uint8_t gc_execute_line(char *line)
   // [19. Go to predefined position, Set G10, or Set axis offsets ]:
   switch(gc_block.non_modal_command) {
     case NON_MODAL_SET_COORDINATE_DATA:
-      settings_write_coord_data(coord_select,gc_block.values.ijk);
+      if (!estimator_active()) { settings_write_coord_data(coord_select,gc_block.values.ijk); }
       // Update system coordinate system if currently active.
       if (gc_state.modal.coord_select == coord_select) {
         memcpy(gc_state.coord_system,gc_block.values.ijk,N_AXIS*sizeof(float));
@@ -1026,10 +1165,10 @@ uint8_t gc_execute_line(char *line)
       memcpy(gc_state.position, gc_block.values.ijk, N_AXIS*sizeof(float));
       break;
     case NON_MODAL_SET_HOME_0:
-      settings_write_coord_data(SETTING_INDEX_G28,gc_state.position);
+      if (!estimator_active()) { settings_write_coord_data(SETTING_INDEX_G28,gc_state.position); }
       break;
     case NON_MODAL_SET_HOME_1:
-      settings_write_coord_data(SETTING_INDEX_G30,gc_state.position);
+      if (!estimator_active()) { settings_write_coord_data(SETTING_INDEX_G30,gc_state.position); }
       break;
     case NON_MODAL_SET_COORDINATE_OFFSET:
       memcpy(gc_state.coord_offset,gc_block.values.xyz,sizeof(gc_block.values.xyz));
@@ -244,6 +244,9 @@ void gc_init();
 // Execute one block of rs275/ngc/g-code
 uint8_t gc_execute_line(char *line);
 
+// Same as gc_execute_line(), but never takes the fast path (ENABLE_GCODE_FAST_PATH).
+uint8_t gc_execute_line_full(char *line);
+
 // Set g-code parser position. Input in steps.
 void gc_sync_position();
 
@@ -51,6 +51,7 @@
 #include "planner.h"
 #include "coolant_control.h"
 #include "eeprom.h"
+#include "estimator.h"
 #include "gcode.h"
 #include "limits.h"
 #include "motion_control.h"
@@ -63,6 +64,12 @@
 #include "spindle_control.h"
 #include "stepper.h"
 #include "jog.h"
+#include "binary_stream.h"
+#include "oword.h"
+#include "resume.h"
+#include "telemetry.h"
+#include "snapshot.h"
+#include "command.h"
 
 // ---------------------------------------------------------------------------------------
 // COMPILE-TIME ERROR CHECKING OF DEFINE VALUES:
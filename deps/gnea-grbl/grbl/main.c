@@ -44,6 +44,7 @@ int grblMain(void)
   settings_init(); // Load Grbl settings from EEPROM
   stepper_init();  // Configure stepper pins and interrupt timers
   system_init();   // Configure pinout pins and pin-change interrupt
+  telemetry_init(); // Start sampling, if there is a telemetry port
 
   memset(sys_position,0,sizeof(sys_position)); // Clear machine position.
   // sei(); // Enable interrupts
@@ -87,11 +88,18 @@ int grblMain(void)
 
     // Reset Grbl primary systems.
     serial_reset_read_buffer(); // Clear serial read buffer
+    #ifdef ENABLE_BINARY_STREAM
+      bstream_reset(); // Drop received binary stream records
+    #endif
     gc_init(); // Set g-code parser to default state
     spindle_init();
     coolant_init();
     limits_init();
     probe_init();
+    mc_reset_motion_queue(); // Drop the motions parsed ahead
+    #ifdef ENABLE_O_WORDS
+      oword_reset(); // Forget the subroutines
+    #endif
     plan_reset(); // Clear block buffer and planner variables
     st_reset(); // Clear stepper subsystem variables.
 
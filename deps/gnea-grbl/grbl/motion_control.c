@@ -22,6 +22,34 @@
 #include "grbl.h"
 
 
+// Motions parsed ahead, waiting for room in the planner buffer. Touched only by the main program.
+typedef struct {
+  float target[N_AXIS];
+  plan_line_data_t pl_data;
+} mc_queued_motion_t;
+
+static mc_queued_motion_t motion_queue[MOTION_QUEUE_SIZE];
+static uint8_t motion_queue_head;
+static uint8_t motion_queue_tail;
+static uint8_t motion_queue_count;
+static bool motion_queue_planning; // mc_plan_queued_motions() is running.
+
+
+// Plans and queues the motion into the planner buffer. There must be room.
+static void mc_plan_line(float *target, plan_line_data_t *pl_data)
+{
+  if (plan_buffer_line(target, pl_data) == PLAN_EMPTY_BLOCK) {
+    if (bit_istrue(settings.flags,BITFLAG_LASER_MODE)) {
+      // Correctly set spindle state, if there is a coincident position passed. Forces a buffer
+      // sync while in M3 laser mode only.
+      if (pl_data->condition & PL_COND_FLAG_SPINDLE_CW) {
+        spindle_sync(PL_COND_FLAG_SPINDLE_CW, pl_data->spindle_speed);
+      }
+    }
+  }
+}
+
+
 // Execute linear motion in absolute millimeter coordinates. Feed rate given in millimeters/second
 // unless invert_feed_rate is true. Then the feed_rate means that the motion should be completed in
 // (1 minute)/feed_rate time.
@@ -35,11 +63,19 @@ void mc_line(float *target, plan_line_data_t *pl_data)
   // from everywhere in Grbl.
   if (bit_istrue(settings.flags,BITFLAG_SOFT_LIMIT_ENABLE)) {
     // NOTE: Block jog state. Jogging is a special case and soft limits are handled independently.
-    if (sys.state != STATE_JOG) { limits_soft_check(target); }
+    // An estimate only notes the violation (estimator.h), the alarm would wait for a reset.
+    if ((sys.state != STATE_JOG) && !estimator_active()) { limits_soft_check(target); }
   }
 
   // If in check gcode mode, prevent motion by blocking planner. Soft limits still work.
-  if (sys.state == STATE_CHECK_MODE) { return; }
+  // An estimate plans the motion, with nothing executing it but the estimator.
+  if (sys.state == STATE_CHECK_MODE) {
+    if (estimator_active()) {
+      estimator_before_line(target);
+      mc_plan_line(target, pl_data);
+    }
+    return;
+  }
 
   // NOTE: Backlash compensation may be installed here. It will need direction info to track when
   // to insert a backlash line motion(s) before the intended line motion and will require its own
@@ -55,25 +91,61 @@ void mc_line(float *target, plan_line_data_t *pl_data)
   // doesn't update the machine position values. Since the position values used by the g-code
   // parser and planner are separate from the system machine positions, this is doable.
 
-  // If the buffer is full: good! That means we are well ahead of the robot.
-  // Remain in this loop until there is room in the buffer.
+  // If the buffer is full: good! That means we are well ahead of the robot. The motion waits in
+  // the queue then, and the parser moves on to the next line. Remain in this loop only if the
+  // queue is full too. The queue keeps the order, so nothing bypasses it while it isn't empty.
+  // NOTE: Jogging is never queued. It only starts with nothing queued and waits as it always did.
   do {
-    protocol_execute_realtime(); // Check for any run-time commands
+    protocol_execute_realtime(); // Check for any run-time commands. Also plans queued motions.
     if (sys.abort) { return; } // Bail, if system abort.
-    if ( plan_check_full_buffer() ) { protocol_auto_cycle_start(); } // Auto-cycle start when buffer is full.
-    else { break; }
+    if ((motion_queue_count == 0) && !plan_check_full_buffer()) {
+      mc_plan_line(target, pl_data);
+      return;
+    }
+    if ((sys.state != STATE_JOG) && (motion_queue_count < MOTION_QUEUE_SIZE)) {
+      mc_queued_motion_t *motion = &motion_queue[motion_queue_head];
+      memcpy(motion->target, target, sizeof(motion->target));
+      memcpy(&motion->pl_data, pl_data, sizeof(plan_line_data_t));
+      if (++motion_queue_head == MOTION_QUEUE_SIZE) { motion_queue_head = 0; }
+      motion_queue_count++;
+      protocol_auto_cycle_start(); // The planner is full, so get it moving.
+      return;
+    }
+    protocol_auto_cycle_start(); // Auto-cycle start when buffer is full.
   } while (1);
+}
 
-  // Plan and queue motion into planner buffer
-  if (plan_buffer_line(target, pl_data) == PLAN_EMPTY_BLOCK) {
-    if (bit_istrue(settings.flags,BITFLAG_LASER_MODE)) {
-      // Correctly set spindle state, if there is a coincident position passed. Forces a buffer
-      // sync while in M3 laser mode only.
-      if (pl_data->condition & PL_COND_FLAG_SPINDLE_CW) {
-        spindle_sync(PL_COND_FLAG_SPINDLE_CW, pl_data->spindle_speed);
-      }
-    }
+
+// Moves the queued motions to the planner, as many as fit. Called from protocol_execute_realtime().
+// NOTE: Not reentrant. Planning may sync the buffer (laser mode), which runs the realtime loop.
+void mc_plan_queued_motions()
+{
+  if (motion_queue_planning) { return; }
+  motion_queue_planning = true;
+  while ((motion_queue_count > 0) && !plan_check_full_buffer() && !sys.abort) {
+    mc_queued_motion_t motion = motion_queue[motion_queue_tail];
+    if (++motion_queue_tail == MOTION_QUEUE_SIZE) { motion_queue_tail = 0; }
+    motion_queue_count--;
+    mc_plan_line(motion.target, &motion.pl_data);
   }
+  motion_queue_planning = false;
+}
+
+
+// Returns true if there are queued motions not being planned at the moment.
+bool mc_has_queued_motions() { return((motion_queue_count > 0) && !motion_queue_planning); }
+
+
+uint8_t mc_get_queued_motion_count() { return(motion_queue_count); }
+
+
+// Drops the queued motions. Used by reset.
+void mc_reset_motion_queue()
+{
+  motion_queue_head = 0;
+  motion_queue_tail = 0;
+  motion_queue_count = 0;
+  motion_queue_planning = false;
 }
 
 
@@ -194,7 +266,7 @@ void mc_arc(float *target, plan_line_data_t *pl_data, float *position, float *of
 // Execute dwell in seconds.
 void mc_dwell(float seconds)
 {
-  if (sys.state == STATE_CHECK_MODE) { return; }
+  if (sys.state == STATE_CHECK_MODE) { estimator_dwell(seconds); return; }
   protocol_buffer_synchronize();
   delay_sec(seconds, DELAY_MODE_DWELL);
 }
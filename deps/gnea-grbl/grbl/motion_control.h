@@ -34,12 +34,30 @@ extern "C" {
 #define HOMING_CYCLE_Y    bit(Y_AXIS)
 #define HOMING_CYCLE_Z    bit(Z_AXIS)
 
+// Motions parsed ahead while the planner buffer is full. Lets the parser work during the stall,
+// so the planner is refilled from here the moment a block completes.
+#ifndef MOTION_QUEUE_SIZE
+  #define MOTION_QUEUE_SIZE 16
+#endif
+
 
 // Execute linear motion in absolute millimeter coordinates. Feed rate given in millimeters/second
 // unless invert_feed_rate is true. Then the feed_rate means that the motion should be completed in
 // (1 minute)/feed_rate time.
 void mc_line(float *target, plan_line_data_t *pl_data);
 
+// Moves the motions queued by mc_line() to the planner, as many as fit.
+void mc_plan_queued_motions();
+
+// Returns true if mc_line() has queued motions, which are not in the planner yet.
+bool mc_has_queued_motions();
+
+// Number of the queued motions. Each one becomes a planner block, unless it's empty.
+uint8_t mc_get_queued_motion_count();
+
+// Drops the queued motions. Used by reset.
+void mc_reset_motion_queue();
+
 // Execute an arc in offset mode format. position == current xyz, target == target xyz,
 // offset == offset from current xyz, axis_XXX defines circle plane in tool space, axis_linear is
 // the direction of helical travel, radius == circle radius, is_clockwise_arc boolean. Used
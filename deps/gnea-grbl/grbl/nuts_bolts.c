@@ -53,12 +53,16 @@ uint8_t read_float(char *line, uint8_t *char_counter, float *float_ptr)
   uint32_t intval = 0;
   int8_t exp = 0;
   uint8_t ndigit = 0;
+  uint8_t nsigdigit = 0;
   bool isdecimal = false;
   while(1) {
     c -= '0';
     if (c <= 9) {
       ndigit++;
-      if (ndigit <= MAX_INT_DIGITS) {
+      if ((intval == 0) && (c == 0)) {
+        if (isdecimal) { exp--; } // Leading zero. Not significant, doesn't count to MAX_INT_DIGITS.
+      } else if (nsigdigit < MAX_INT_DIGITS) {
+        nsigdigit++;
         if (isdecimal) { exp--; }
         intval = (((intval << 2) + intval) << 1) + c; // intval*10 + c
       } else {
@@ -0,0 +1,280 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#include "grbl.h"
+
+#ifdef ENABLE_O_WORDS
+
+#define OWORD_SUB 0
+#define OWORD_ENDSUB 1
+#define OWORD_CALL 2
+#define OWORD_REPEAT 3
+#define OWORD_ENDREPEAT 4
+#define OWORD_WHILE 5
+#define OWORD_ENDWHILE 6
+
+// Indexed by the keyword codes above.
+static const char *const oword_keywords[] = { "SUB", "ENDSUB", "CALL", "REPEAT", "ENDREPEAT", "WHILE", "ENDWHILE" };
+
+typedef struct {
+  uint16_t number;
+  uint8_t keyword;
+  bool has_value;
+  float value; // In the brackets, if any.
+} oword_t;
+
+typedef struct {
+  uint16_t number;
+  uint16_t start; // Arena offsets, from the first line of the body to past its last one.
+  uint16_t end;
+} oword_sub_t;
+
+// Stored lines are zero terminated, one after another. Subroutine bodies take the beginning
+// of the arena, the block being received is stored past them.
+static char arena[OWORD_ARENA_SIZE];
+static uint16_t arena_used;
+static oword_sub_t subs[OWORD_MAX_SUBS];
+static uint8_t sub_count;
+
+// The block being received.
+static bool recording;
+static oword_t record_start; // Its sub, repeat or while line.
+static uint16_t record_end;
+static uint8_t record_status; // Once not ok, the rest of the block is thrown away.
+
+static char exec_line[LINE_BUFFER_SIZE]; // The parser may modify the line, stored lines are copied here.
+
+
+// Parses "O<number><keyword>[<value>]". Anything else after the keyword is an error.
+static uint8_t oword_parse(char *line, oword_t *oword)
+{
+  uint8_t char_counter = 1; // Past the O.
+  uint32_t number = 0;
+
+  if (line[char_counter] < '0' || line[char_counter] > '9') { return(STATUS_OWORD_SYNTAX); }
+  while (line[char_counter] >= '0' && line[char_counter] <= '9') {
+    number = number*10 + (line[char_counter++] - '0');
+    if (number > UINT16_MAX) { return(STATUS_OWORD_SYNTAX); }
+  }
+  oword->number = number;
+
+  // Longest first, so ENDSUB isn't taken for a sub.
+  uint8_t len = 0;
+  for (uint8_t k = 0; k < sizeof(oword_keywords)/sizeof(oword_keywords[0]); k++) {
+    uint8_t k_len = strlen(oword_keywords[k]);
+    if (k_len > len && strncmp(&line[char_counter], oword_keywords[k], k_len) == 0) {
+      oword->keyword = k;
+      len = k_len;
+    }
+  }
+  if (len == 0) { return(STATUS_OWORD_SYNTAX); }
+  char_counter += len;
+
+  oword->has_value = false;
+  if (line[char_counter] == '[') {
+    char_counter++;
+    if (!read_float(line, &char_counter, &oword->value)) { return(STATUS_BAD_NUMBER_FORMAT); }
+    if (line[char_counter++] != ']') { return(STATUS_OWORD_SYNTAX); }
+    oword->has_value = true;
+  }
+  if (line[char_counter] != 0) { return(STATUS_OWORD_SYNTAX); }
+
+  // Only loops take a value. Calls would need parameters, which Grbl doesn't have.
+  bool loop = (oword->keyword == OWORD_REPEAT) || (oword->keyword == OWORD_WHILE);
+  if (loop != oword->has_value) { return(STATUS_OWORD_SYNTAX); }
+  if (oword->keyword == OWORD_REPEAT) {
+    if (oword->value < 0.0) { return(STATUS_NEGATIVE_VALUE); }
+    if (oword->value > UINT32_MAX) { return(STATUS_GCODE_MAX_VALUE_EXCEEDED); }
+  }
+  return(STATUS_OK);
+}
+
+
+// The keyword which closes a block opened by `keyword`.
+static uint8_t oword_closing(uint8_t keyword)
+{
+  return(keyword + 1); // ENDSUB, ENDREPEAT and ENDWHILE follow their openings.
+}
+
+
+static oword_sub_t *oword_find_sub(uint16_t number)
+{
+  for (uint8_t i = 0; i < sub_count; i++) {
+    if (subs[i].number == number) { return(&subs[i]); }
+  }
+  return(NULL);
+}
+
+
+// Finds the line closing the block `open` between start and end. Returns its offset or end.
+static uint16_t oword_find_closing(const oword_t *open, uint16_t start, uint16_t end)
+{
+  oword_t oword;
+  for (uint16_t i = start; i < end; i += strlen(&arena[i]) + 1) {
+    if (arena[i] != 'O') { continue; }
+    strcpy(exec_line, &arena[i]);
+    if (oword_parse(exec_line, &oword) == STATUS_OK && oword.number == open->number &&
+        oword.keyword == oword_closing(open->keyword)) {
+      return(i);
+    }
+  }
+  return(end);
+}
+
+
+static uint8_t oword_run(uint16_t start, uint16_t end, uint8_t depth);
+
+
+// Executes the loop `loop` with the body between start and end.
+static uint8_t oword_run_loop(const oword_t *loop, uint16_t start, uint16_t end, uint8_t depth)
+{
+  uint8_t status_code = STATUS_OK;
+  uint32_t count = (loop->keyword == OWORD_REPEAT) ? trunc(loop->value) : (loop->value != 0.0); // A while never ends.
+
+  while (count > 0 && status_code == STATUS_OK && !sys.abort) {
+    status_code = oword_run(start, end, depth+1);
+    protocol_execute_realtime(); // Even with nothing inside, a reset has to stop it.
+    if (loop->keyword == OWORD_REPEAT) { count--; }
+  }
+  return(status_code);
+}
+
+
+// Executes the stored lines between start and end.
+static uint8_t oword_run(uint16_t start, uint16_t end, uint8_t depth)
+{
+  if (depth > OWORD_MAX_DEPTH) { return(STATUS_OWORD_NESTING); }
+
+  uint16_t i = start;
+  while (i < end) {
+    uint16_t next = i + strlen(&arena[i]) + 1;
+    strcpy(exec_line, &arena[i]);
+    uint8_t status_code;
+
+    if (exec_line[0] == 'O') {
+      oword_t oword;
+      status_code = oword_parse(exec_line, &oword);
+      if (status_code != STATUS_OK) { return(status_code); }
+
+      if (oword.keyword == OWORD_CALL) {
+        oword_sub_t *sub = oword_find_sub(oword.number);
+        if (sub == NULL) { return(STATUS_OWORD_UNDEFINED); }
+        status_code = oword_run(sub->start, sub->end, depth+1);
+      } else if (oword.keyword == OWORD_REPEAT || oword.keyword == OWORD_WHILE) {
+        uint16_t closing = oword_find_closing(&oword, next, end);
+        if (closing == end) { return(STATUS_OWORD_SYNTAX); }
+        status_code = oword_run_loop(&oword, next, closing, depth);
+        next = closing + strlen(&arena[closing]) + 1;
+      } else {
+        return(STATUS_OWORD_SYNTAX); // No definitions inside a block, no stray ends.
+      }
+    } else {
+      status_code = gc_execute_line(exec_line);
+    }
+
+    if (status_code != STATUS_OK) { return(status_code); }
+    protocol_execute_realtime();
+    if (sys.abort) { return(STATUS_OK); } // The main loop bails out.
+    i = next;
+  }
+  return(STATUS_OK);
+}
+
+
+// Stores a line of the block being received, or ends the block.
+static uint8_t oword_record(char *line)
+{
+  oword_t oword;
+  if (line[0] == 'O' && oword_parse(line, &oword) == STATUS_OK && oword.number == record_start.number &&
+      oword.keyword == oword_closing(record_start.keyword)) {
+    recording = false;
+    if (record_status != STATUS_OK) { return(record_status); }
+
+    if (record_start.keyword == OWORD_SUB) {
+      subs[sub_count].number = record_start.number;
+      subs[sub_count].start = arena_used;
+      subs[sub_count].end = record_end;
+      sub_count++;
+      arena_used = record_end;
+      return(STATUS_OK);
+    }
+
+    // A loop runs from the arena as it is, then is forgotten.
+    uint8_t status_code = oword_run_loop(&record_start, arena_used, record_end, 0);
+    record_end = arena_used;
+    return(status_code);
+  }
+
+  if (record_status == STATUS_OK) {
+    uint16_t len = strlen(line) + 1;
+    if (record_end + len > OWORD_ARENA_SIZE) {
+      record_status = STATUS_OWORD_MEMORY;
+    } else {
+      memcpy(&arena[record_end], line, len);
+      record_end += len;
+    }
+  }
+  return(record_status);
+}
+
+
+uint8_t oword_execute_line(char *line)
+{
+  if (recording) { return(oword_record(line)); }
+  if (line[0] != 'O') { return(gc_execute_line(line)); }
+
+  oword_t oword;
+  uint8_t status_code = oword_parse(line, &oword);
+  if (status_code != STATUS_OK) { return(status_code); }
+
+  switch (oword.keyword) {
+    case OWORD_CALL: {
+      oword_sub_t *sub = oword_find_sub(oword.number);
+      if (sub == NULL) { return(STATUS_OWORD_UNDEFINED); }
+      return(oword_run(sub->start, sub->end, 0));
+    }
+    case OWORD_SUB: case OWORD_REPEAT: case OWORD_WHILE:
+      recording = true;
+      record_start = oword;
+      record_end = arena_used;
+      record_status = STATUS_OK;
+      if (oword.keyword == OWORD_SUB) {
+        if (oword_find_sub(oword.number) != NULL) { record_status = STATUS_OWORD_SYNTAX; } // Already defined.
+        else if (sub_count == OWORD_MAX_SUBS) { record_status = STATUS_OWORD_MEMORY; }
+      }
+      return(record_status);
+    default:
+      return(STATUS_OWORD_SYNTAX); // An end without its beginning.
+  }
+}
+
+
+void oword_reset()
+{
+  arena_used = 0;
+  sub_count = 0;
+  recording = false;
+}
+
+
+bool oword_mark(oword_mark_t *mark)
+{
+  mark->arena_used = arena_used;
+  mark->sub_count = sub_count;
+  return(!recording);
+}
+
+
+void oword_release(const oword_mark_t *mark)
+{
+  arena_used = mark->arena_used;
+  sub_count = mark->sub_count;
+  recording = false;
+}
+
+#endif
@@ -0,0 +1,63 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#ifndef oword_h
+#define oword_h
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  A subset of the LinuxCNC O-word control flow, so repeated geometry is sent once:
+
+    O100 sub          O101 repeat [20]      O102 while [1]
+      ...               ...                   ...
+    O100 endsub       O101 endrepeat        O102 endwhile
+    O100 call
+
+  There are no parameters in Grbl, so calls take no arguments and the repeat count and the
+  while condition are plain numbers. A while with a non-zero condition runs until a reset.
+
+  Lines between sub and endsub are stored (as cleaned up by the protocol, white space and
+  comments removed) in a RAM arena and answered with 'ok' without being executed. Subroutines
+  stay defined until a reset. Lines of a loop are stored the same way and the whole loop runs
+  when its end line arrives, the status of that line is the first error in the loop, if any.
+  Inside stored lines loops can be nested and subroutines called. '$' lines are never stored.
+  Every O number has to be unique among the nested blocks.
+*/
+
+// RAM for the stored lines, subroutines and the loop being received.
+#ifndef OWORD_ARENA_SIZE
+  #define OWORD_ARENA_SIZE 4096
+#endif
+#define OWORD_MAX_SUBS 16  // Subroutines defined at a time.
+#define OWORD_MAX_DEPTH 8  // Nested calls and loops.
+
+// Executes a g-code line, or stores it, or handles it as an O-word.
+uint8_t oword_execute_line(char *line);
+
+// Forgets all the subroutines and the block being received.
+void oword_reset();
+
+// The subroutines defined so far. New ones only ever go after them.
+typedef struct {
+  uint16_t arena_used;
+  uint8_t sub_count;
+} oword_mark_t;
+
+// For lines run aside from the stream (an estimate), so their subroutines can be dropped and the
+// host's kept. False while a block is being received, the lines would go into it.
+bool oword_mark(oword_mark_t *mark);
+
+// Forgets the subroutines defined after the mark, and the block being received.
+void oword_release(const oword_mark_t *mark);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
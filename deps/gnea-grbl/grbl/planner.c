@@ -26,6 +26,7 @@
 static plan_block_t block_buffer[BLOCK_BUFFER_SIZE];  // A ring buffer for motion instructions
 static uint8_t block_buffer_tail;     // Index of the block to process now
 static uint8_t block_buffer_head;     // Index of the next block to be pushed
+static volatile uint32_t block_completed_count; // Blocks discarded since boot. Wraps around.
 static uint8_t next_buffer_head;      // Index of the next buffer head
 static uint8_t block_buffer_planned;  // Index of the optimally planned block
 
@@ -219,6 +220,7 @@ void plan_discard_current_block()
     // Push block_buffer_planned pointer, if encountered.
     if (block_buffer_tail == block_buffer_planned) { block_buffer_planned = block_index; }
     block_buffer_tail = block_index;
+    block_completed_count++;
   }
 }
 
@@ -511,6 +513,9 @@ uint8_t plan_get_block_buffer_count()
 }
 
 
+uint32_t plan_get_completed_block_count() { return(block_completed_count); }
+
+
 // Re-initialize buffer plan with a partially completed block, assumed to exist at the buffer tail.
 // Called after a steppers have come to a complete stop for a feed hold and the cycle is stopped.
 void plan_cycle_reinitialize()
@@ -144,6 +144,10 @@ uint8_t plan_get_block_buffer_available();
 // NOTE: Deprecated. Not used unless classic status reports are enabled in config.h
 uint8_t plan_get_block_buffer_count();
 
+// Blocks discarded from the buffer since boot, that is handed over to the stepper segment
+// buffer. Never reset, wraps around. Read from other threads.
+uint32_t plan_get_completed_block_count();
+
 // Returns the status of the block ring buffer. True, if buffer is full.
 uint8_t plan_check_full_buffer();
 
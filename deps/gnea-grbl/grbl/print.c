@@ -24,17 +24,14 @@
 
 void printString(const char *s)
 {
-  while (*s)
-    serial_write(*s++);
+  serial_write_span((const uint8_t *)s, strlen(s));
 }
 
 
 // Print a string stored in PGM-memory
 void printPgmString(const char *s)
 {
-  char c;
-  while ((c = *s++)) 
-    serial_write(c);
+  serial_write_span((const uint8_t *)s, strlen(s));
 }
 
 
@@ -70,6 +70,9 @@ void protocol_main_loop()
 
   uint8_t line_flags = 0;
   uint8_t char_counter = 0;
+  uint32_t rx_overruns[N_SERIAL_CHANNEL]; // Reported so far, per channel.
+  uint8_t ch;
+  for (ch = 0; ch < N_SERIAL_CHANNEL; ch++) { rx_overruns[ch] = serial_get_channel_overrun_count(ch); }
   uint8_t c;
   for (;;) {
 
@@ -81,6 +84,7 @@ void protocol_main_loop()
         protocol_execute_realtime(); // Runtime command check point.
         if (sys.abort) { return; } // Bail to calling function upon system abort
 
+        serial_reply_to(serial_get_read_channel()); // Replies go where the line came from.
         line[char_counter] = 0; // Set string termination character.
         #ifdef REPORT_ECHO_LINE_RECEIVED
           report_echo_line_received(line);
@@ -101,10 +105,15 @@ void protocol_main_loop()
           report_status_message(STATUS_SYSTEM_GC_LOCK);
         } else {
           // Parse and execute g-code block.
-          report_status_message(gc_execute_line(line));
+          #ifdef ENABLE_O_WORDS
+            report_status_message(oword_execute_line(line));
+          #else
+            report_status_message(gc_execute_line(line));
+          #endif
         }
 
         // Reset tracking data for next line.
+        serial_reply_to(SERIAL_CHANNEL_ALL);
         line_flags = 0;
         char_counter = 0;
 
@@ -151,10 +160,40 @@ void protocol_main_loop()
       }
     }
 
+    #ifdef ENABLE_BINARY_STREAM
+      // Binary motion records are executed when there is no g-code line waiting.
+      if (bstream_execute()) {
+        if (sys.abort) { return; }
+        c = 0; // Don't sleep, more records are probably on the way.
+      }
+    #endif
+
+    // Typed commands of the UI (command.h) are executed between the lines as well.
+    if (command_execute()) {
+      if (sys.abort) { return; }
+      c = 0;
+    }
+
+    // Bytes were lost, so some line was (or will be) executed damaged. Let the sender know, on
+    // the channel the bytes were lost from (an SD job stops on it).
+    for (ch = 0; ch < N_SERIAL_CHANNEL; ch++) {
+      uint32_t overruns = serial_get_channel_overrun_count(ch);
+      if (overruns != rx_overruns[ch]) {
+        rx_overruns[ch] = overruns;
+        serial_reply_to(ch);
+        report_feedback_message(MESSAGE_RX_OVERRUN);
+        serial_reply_to(SERIAL_CHANNEL_ALL);
+      }
+    }
+
     if (c == SERIAL_NO_DATA) {
-      k_msleep (10);
+      k_msleep (mc_has_queued_motions() ? 1 : 10); // Parsed ahead motions wait for the planner.
     }
 
+    // Settings and coordinates stored by the lines above go to the flash, unless motions are
+    // on their way. Then they wait until the end of the job.
+    settings_flush();
+
     // If there are no more characters in the serial read buffer to be processed and executed,
     // this indicates that g-code streaming has either filled the planner buffer or has
     // completed. In either case, auto-cycle start, if enabled, any queued moves.
@@ -172,12 +211,14 @@ void protocol_main_loop()
 // during a synchronize call, if it should happen. Also, waits for clean cycle end.
 void protocol_buffer_synchronize()
 {
+  // An estimate has the planner full of blocks nothing else is going to execute.
+  if (estimator_active()) { estimator_sync(); return; }
   // If system is queued, ensure cycle resumes if the auto start flag is present.
   protocol_auto_cycle_start();
   do {
     protocol_execute_realtime();   // Check and execute run-time commands
     if (sys.abort) { return; } // Check for system abort
-  } while (plan_get_current_block() || (sys.state == STATE_CYCLE));
+  } while (plan_get_current_block() || (sys.state == STATE_CYCLE) || mc_has_queued_motions());
 }
 
 
@@ -208,8 +249,14 @@ void protocol_auto_cycle_start()
 // limit switches, or the main program.
 void protocol_execute_realtime()
 {
+  // Reports and alarms are not replies to the line being executed. Everybody gets them.
+  uint8_t reply_channel = serial_get_reply_channel();
+  serial_reply_to(SERIAL_CHANNEL_ALL);
   protocol_exec_rt_system();
   if (sys.suspend) { protocol_exec_rt_suspend(); }
+  if (!sys.abort) { mc_plan_queued_motions(); } // Refill the planner from the parsed ahead motions.
+  snapshot_publish(); // For the display.
+  serial_reply_to(reply_channel);
 }
 
 
@@ -499,6 +546,8 @@ void protocol_exec_rt_system()
     k_msleep (1);
   }
 
+  report_auto_status(); // Status push, if $14 enabled it.
+
   #ifdef DEBUG
     if (sys_rt_exec_debug) {
       report_realtime_debug();
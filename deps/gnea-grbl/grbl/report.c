@@ -96,6 +96,11 @@ static void report_util_uint8_setting(uint8_t n, int val) {
   print_uint8_base10(val); 
   report_util_line_feed(); // report_util_setting_string(n); 
 }
+static void report_util_uint32_setting(uint8_t n, uint32_t val) {
+  report_util_setting_prefix(n);
+  print_uint32_base10(val);
+  report_util_line_feed();
+}
 static void report_util_float_setting(uint8_t n, float val, uint8_t n_decimal) { 
   report_util_setting_prefix(n); 
   printFloat(val,n_decimal);
@@ -113,7 +118,15 @@ void report_status_message(uint8_t status_code)
 {
   switch(status_code) {
     case STATUS_OK: // STATUS_OK
-      printPgmString(PSTR("ok\r\n")); break;
+      if (bit_istrue(settings.status_report_mask,BITFLAG_RT_STATUS_RX_CREDITS)) {
+        // Credit based streaming. The host may send this many bytes right away.
+        printPgmString(PSTR("ok:"));
+        print_uint32_base10(serial_get_rx_buffer_available());
+        report_util_line_feed();
+      } else {
+        printPgmString(PSTR("ok\r\n"));
+      }
+      break;
     default:
       printPgmString(PSTR("error:"));
       print_uint8_base10(status_code);
@@ -121,6 +134,27 @@ void report_status_message(uint8_t status_code)
   }
 }
 
+#ifdef ENABLE_BINARY_STREAM
+// Binary stream records are acknowledged in windows instead of 'ok' per line.
+void report_binary_stream_ack(uint8_t seq, uint8_t available)
+{
+  printPgmString(PSTR("[ACK:"));
+  print_uint8_base10(seq);
+  serial_write(',');
+  print_uint8_base10(available);
+  report_util_feedback_line_feed();
+}
+
+void report_binary_stream_nak(uint8_t seq, uint8_t status_code)
+{
+  printPgmString(PSTR("[NAK:"));
+  print_uint8_base10(seq);
+  serial_write(',');
+  print_uint8_base10(status_code);
+  report_util_feedback_line_feed();
+}
+#endif
+
 // Prints alarm messages.
 void report_alarm_message(uint8_t alarm_code)
 {
@@ -161,6 +195,8 @@ void report_feedback_message(uint8_t message_code)
       printPgmString(PSTR("Restoring spindle")); break;
     case MESSAGE_SLEEP_MODE:
       printPgmString(PSTR("Sleeping")); break;
+    case MESSAGE_RX_OVERRUN:
+      printPgmString(PSTR("RX overrun")); break;
   }
   report_util_feedback_line_feed();
 }
@@ -174,7 +210,7 @@ void report_init_message()
 
 // Grbl help message
 void report_grbl_help() {
-  printPgmString(PSTR("[HLP:$$ $# $G $I $N $x=val $Nx=line $J=line $SLP $C $X $H ~ ! ? ctrl-x]\r\n"));    
+  printPgmString(PSTR("[HLP:$$ $# $G $I $N $x=val $Nx=line $J=line $SLP $C $X $H $E=file ~ ! ? ctrl-x]\r\n"));    
 }
 
 
@@ -193,6 +229,7 @@ void report_grbl_settings() {
   report_util_float_setting(11,settings.junction_deviation,N_DECIMAL_SETTINGVALUE);
   report_util_float_setting(12,settings.arc_tolerance,N_DECIMAL_SETTINGVALUE);
   report_util_uint8_setting(13,bit_istrue(settings.flags,BITFLAG_REPORT_INCHES));
+  report_util_uint32_setting(14,settings.status_auto_report_ms);
   report_util_uint8_setting(20,bit_istrue(settings.flags,BITFLAG_SOFT_LIMIT_ENABLE));
   report_util_uint8_setting(21,bit_istrue(settings.flags,BITFLAG_HARD_LIMIT_ENABLE));
   report_util_uint8_setting(22,bit_istrue(settings.flags,BITFLAG_HOMING_ENABLE));
@@ -366,6 +403,23 @@ void report_execute_startup_message(char *line, uint8_t status_code)
   report_status_message(status_code);
 }
 
+// Prints a job estimate: seconds, lines, the work coordinates box and if the travel is exceeded.
+// [EST:754.2,6043:0.000,0.000,-1.000:120.000,80.000,5.000:0]
+void report_estimate(estimate_t *estimate)
+{
+  printPgmString(PSTR("[EST:"));
+  printFloat(estimate->seconds, 1);
+  serial_write(',');
+  print_uint32_base10(estimate->lines);
+  serial_write(':');
+  report_util_axis_values(estimate->min);
+  serial_write(':');
+  report_util_axis_values(estimate->max);
+  serial_write(':');
+  print_uint8_base10(estimate->outside);
+  report_util_feedback_line_feed();
+}
+
 // Prints build info line
 void report_build_info(char *line)
 {
@@ -458,6 +512,336 @@ void report_echo_line_received(char *line)
 }
 
 
+/*
+  Status report builder. The report is assembled in status_line with integer arithmetic
+  only and written out with one serial_write_span call. Positions are kept in micrometres
+  (fixed point, 3 decimals in mm, 4 in inches) and the fields which rarely change (WCO,
+  Ov, Pn, A) are formatted once and reused until the values they show change.
+*/
+#define STATUS_LINE_SIZE 192 // Longest possible report is about 170 characters.
+#define STATUS_FIELD_SIZE 48
+
+static char status_line[STATUS_LINE_SIZE];
+static uint8_t status_len;
+
+// Two digits for every number 0-99, so numbers are converted two digits at a time.
+static const char status_digit_pairs[201] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+// A field formatted once and reused as long as key (the values it shows) stays the same.
+typedef struct {
+  uint32_t key;
+  uint8_t len; // Zero if not formatted yet.
+  char text[STATUS_FIELD_SIZE];
+} status_field_t;
+
+static void status_put(const char *s, uint8_t len)
+{
+  if (len > STATUS_LINE_SIZE - status_len) { len = STATUS_LINE_SIZE - status_len; }
+  memcpy(status_line + status_len, s, len);
+  status_len += len;
+}
+
+static void status_put_str(const char *s) { status_put(s, strlen(s)); }
+
+static void status_put_char(char c) { status_put(&c, 1); }
+
+// Writes the digits of n right aligned to end. Returns where they start.
+static char *status_util_digits(char *end, uint32_t n)
+{
+  while (n >= 100) {
+    uint32_t q = n / 100;
+    end -= 2;
+    memcpy(end, &status_digit_pairs[(n - q*100)*2], 2);
+    n = q;
+  }
+  if (n >= 10) {
+    end -= 2;
+    memcpy(end, &status_digit_pairs[n*2], 2);
+  } else {
+    *--end = '0' + n;
+  }
+  return(end);
+}
+
+static void status_put_uint(uint32_t n)
+{
+  char buf[10];
+  char *start = status_util_digits(buf + sizeof(buf), n);
+  status_put(start, buf + sizeof(buf) - start);
+}
+
+// Prints value / 10^decimals, like printFloat does with the float.
+static void status_put_fixed(int32_t value, uint8_t decimals)
+{
+  char buf[12];
+  char *end = buf + sizeof(buf);
+  uint32_t magnitude = (value < 0) ? -(uint32_t)value : value;
+  char *start = status_util_digits(end, magnitude);
+  while (end - start <= decimals) { *--start = '0'; } // Leading zeros, like 0.005.
+
+  if (value < 0) { status_put_char('-'); }
+  uint8_t whole = (end - start) - decimals;
+  status_put(start, whole);
+  if (decimals) {
+    status_put_char('.');
+    status_put(start + whole, decimals);
+  }
+}
+
+// Rounds half away from zero, like printFloat.
+static int32_t status_util_round_div(int64_t n, int64_t d)
+{
+  return((n < 0) ? -((-n + d/2) / d) : (n + d/2) / d);
+}
+
+// Converts micrometres to the reported units: mm with 3 or inches with 4 decimals.
+static int32_t status_util_coord(int32_t um)
+{
+  if (bit_istrue(settings.flags,BITFLAG_REPORT_INCHES)) { return(status_util_round_div((int64_t)um*100, 254)); }
+  return(um);
+}
+
+static uint8_t status_util_coord_decimals()
+{
+  return(bit_istrue(settings.flags,BITFLAG_REPORT_INCHES) ? N_DECIMAL_COORDVALUE_INCH : N_DECIMAL_COORDVALUE_MM);
+}
+
+static void status_put_axis_values(int32_t *um)
+{
+  uint8_t decimals = status_util_coord_decimals();
+  uint8_t idx;
+  for (idx=0; idx<N_AXIS; idx++) {
+    status_put_fixed(status_util_coord(um[idx]), decimals);
+    if (idx < (N_AXIS-1)) { status_put_char(','); }
+  }
+}
+
+// Rates are reported in whole mm/min or in/min with one decimal.
+static void status_put_rate(float rate)
+{
+  if (bit_istrue(settings.flags,BITFLAG_REPORT_INCHES)) {
+    status_put_fixed(lroundf(rate*(INCH_PER_MM*10)), N_DECIMAL_RATEVALUE_INCH);
+  } else {
+    status_put_fixed(lroundf(rate), N_DECIMAL_RATEVALUE_MM);
+  }
+}
+
+// Micrometres per step in Q24, recalculated only when the steps/mm settings change. The
+// product with the step count fits in 64 bits for any realistic travel.
+static float status_steps_per_mm[N_AXIS];
+static int64_t status_um_per_step_q24[N_AXIS];
+
+static int32_t status_util_steps_to_um(int32_t steps, uint8_t idx)
+{
+  if (settings.steps_per_mm[idx] != status_steps_per_mm[idx]) {
+    status_steps_per_mm[idx] = settings.steps_per_mm[idx];
+    status_um_per_step_q24[idx] = (int64_t)(1000.0 * (1L << 24) / status_steps_per_mm[idx] + 0.5);
+  }
+  return(status_util_round_div((int64_t)steps * status_um_per_step_q24[idx], 1L << 24));
+}
+
+// Integer version of system_convert_array_steps_to_mpos.
+static void status_util_steps_to_mpos(int32_t *um, int32_t *steps)
+{
+  uint8_t idx;
+  for (idx=0; idx<N_AXIS; idx++) {
+    int32_t axis_steps = steps[idx];
+    #ifdef COREXY
+      if (idx == X_AXIS) { axis_steps = system_convert_corexy_to_x_axis_steps(steps); }
+      else if (idx == Y_AXIS) { axis_steps = system_convert_corexy_to_y_axis_steps(steps); }
+    #endif
+    um[idx] = status_util_steps_to_um(axis_steps, idx);
+  }
+}
+
+// Work coordinate offset. Converted to micrometres and formatted only when it changes.
+static struct {
+  float mm[N_AXIS];
+  int32_t um[N_AXIS];
+  status_field_t field; // key: report in inches.
+} status_wco;
+
+static void status_util_update_wco()
+{
+  float wco[N_AXIS];
+  uint8_t idx;
+  for (idx=0; idx<N_AXIS; idx++) {
+    // Apply work coordinate offsets and tool length offset to current position.
+    wco[idx] = gc_state.coord_system[idx]+gc_state.coord_offset[idx];
+    if (idx == TOOL_LENGTH_OFFSET_AXIS) { wco[idx] += gc_state.tool_length_offset; }
+  }
+  if (memcmp(wco, status_wco.mm, sizeof(wco)) == 0) { return; }
+
+  memcpy(status_wco.mm, wco, sizeof(wco));
+  for (idx=0; idx<N_AXIS; idx++) { status_wco.um[idx] = lroundf(wco[idx]*1000.0f); }
+  status_wco.field.len = 0;
+}
+
+// Appends field, formatting it first with format if its key changed.
+static void status_put_field(status_field_t *field, uint32_t key, void (*format)(uint32_t key))
+{
+  if ((field->len == 0) || (field->key != key)) {
+    uint8_t start = status_len;
+    format(key);
+    field->len = MIN(status_len - start, STATUS_FIELD_SIZE);
+    field->key = key;
+    memcpy(field->text, status_line + start, field->len);
+    return;
+  }
+  status_put(field->text, field->len);
+}
+
+static void status_format_wco(uint32_t key)
+{
+  ARG_UNUSED(key);
+  status_put_str("|WCO:");
+  status_put_axis_values(status_wco.um);
+}
+
+#ifdef REPORT_FIELD_PIN_STATE
+  static status_field_t status_pn;
+
+  // key: limit pins, control pins << 8, probe pin << 16.
+  static void status_format_pn(uint32_t key)
+  {
+    uint8_t lim_pin_state = key & 0xff;
+    uint8_t ctrl_pin_state = (key >> 8) & 0xff;
+    uint8_t prb_pin_state = key >> 16;
+    status_put_str("|Pn:");
+    if (prb_pin_state) { status_put_char('P'); }
+    if (lim_pin_state) {
+      #ifdef ENABLE_DUAL_AXIS
+        #if (DUAL_AXIS_SELECT == X_AXIS)
+          if (bit_istrue(lim_pin_state,(bit(X_AXIS)|bit(N_AXIS)))) { status_put_char('X'); }
+          if (bit_istrue(lim_pin_state,bit(Y_AXIS))) { status_put_char('Y'); }
+        #endif
+        #if (DUAL_AXIS_SELECT == Y_AXIS)
+          if (bit_istrue(lim_pin_state,bit(X_AXIS))) { status_put_char('X'); }
+          if (bit_istrue(lim_pin_state,(bit(Y_AXIS)|bit(N_AXIS)))) { status_put_char('Y'); }
+        #endif
+        if (bit_istrue(lim_pin_state,bit(Z_AXIS))) { status_put_char('Z'); }
+      #else
+        if (bit_istrue(lim_pin_state,bit(X_AXIS))) { status_put_char('X'); }
+        if (bit_istrue(lim_pin_state,bit(Y_AXIS))) { status_put_char('Y'); }
+        if (bit_istrue(lim_pin_state,bit(Z_AXIS))) { status_put_char('Z'); }
+      #endif
+    }
+    if (ctrl_pin_state) {
+      #ifdef ENABLE_SAFETY_DOOR_INPUT_PIN
+        if (bit_istrue(ctrl_pin_state,CONTROL_PIN_INDEX_SAFETY_DOOR)) { status_put_char('D'); }
+      #endif
+      if (bit_istrue(ctrl_pin_state,CONTROL_PIN_INDEX_RESET)) { status_put_char('R'); }
+      if (bit_istrue(ctrl_pin_state,CONTROL_PIN_INDEX_FEED_HOLD)) { status_put_char('H'); }
+      if (bit_istrue(ctrl_pin_state,CONTROL_PIN_INDEX_CYCLE_START)) { status_put_char('S'); }
+    }
+  }
+#endif
+
+#ifdef REPORT_FIELD_OVERRIDES
+  static status_field_t status_ov;
+
+  // key: feed, rapid << 8, spindle << 16 overrides. The spindle and coolant states are the
+  // key of the |A: field, formatted separately.
+  static void status_format_ov(uint32_t key)
+  {
+    status_put_str("|Ov:");
+    status_put_uint(key & 0xff);
+    status_put_char(',');
+    status_put_uint((key >> 8) & 0xff);
+    status_put_char(',');
+    status_put_uint((key >> 16) & 0xff);
+  }
+
+  static status_field_t status_a;
+
+  // key: spindle state, coolant state << 8.
+  static void status_format_a(uint32_t key)
+  {
+    uint8_t sp_state = key & 0xff;
+    uint8_t cl_state = key >> 8;
+    if (!(sp_state || cl_state)) { return; }
+    status_put_str("|A:");
+    if (sp_state) { // != SPINDLE_STATE_DISABLE
+      #ifdef VARIABLE_SPINDLE
+        #ifdef USE_SPINDLE_DIR_AS_ENABLE_PIN
+          status_put_char('S'); // CW
+        #else
+          if (sp_state == SPINDLE_STATE_CW) { status_put_char('S'); } // CW
+          else { status_put_char('C'); } // CCW
+        #endif
+      #else
+        if (sp_state & SPINDLE_STATE_CW) { status_put_char('S'); } // CW
+        else { status_put_char('C'); } // CCW
+      #endif
+    }
+    if (cl_state & COOLANT_STATE_FLOOD) { status_put_char('F'); }
+    #ifdef ENABLE_M7
+      if (cl_state & COOLANT_STATE_MIST) { status_put_char('M'); }
+    #endif
+  }
+#endif
+
+// What the status report shows, apart from the buffer states and line numbers. The auto-report
+// pushes a new report only if this has changed since the last one (pushed or polled).
+typedef struct {
+  int32_t position[N_AXIS];
+  float wco[N_AXIS];
+  float rate;
+  uint8_t state;
+  uint8_t suspend;
+  uint8_t f_override;
+  uint8_t r_override;
+  uint8_t spindle_speed_ovr;
+  uint8_t spindle_state;
+  uint8_t coolant_state;
+  uint8_t pin_state[3]; // Limits, control, probe.
+} status_snapshot_t;
+
+static status_snapshot_t status_last_sent;
+
+static void status_util_snapshot(status_snapshot_t *s)
+{
+  memset(s, 0, sizeof(status_snapshot_t)); // Padding too, snapshots are compared with memcmp.
+  memcpy(s->position, sys_position, sizeof(sys_position));
+  uint8_t idx;
+  for (idx=0; idx<N_AXIS; idx++) {
+    s->wco[idx] = gc_state.coord_system[idx]+gc_state.coord_offset[idx];
+    if (idx == TOOL_LENGTH_OFFSET_AXIS) { s->wco[idx] += gc_state.tool_length_offset; }
+  }
+  s->rate = st_get_realtime_rate();
+  s->state = sys.state;
+  s->suspend = sys.suspend;
+  s->f_override = sys.f_override;
+  s->r_override = sys.r_override;
+  s->spindle_speed_ovr = sys.spindle_speed_ovr;
+  s->spindle_state = spindle_get_state();
+  s->coolant_state = coolant_get_state();
+  #ifdef REPORT_FIELD_PIN_STATE
+    s->pin_state[0] = limits_get_state();
+    s->pin_state[1] = system_control_get_state();
+    s->pin_state[2] = probe_get_state();
+  #endif
+}
+
+#ifdef DEBUG
+  // Cost of report_realtime_status in CPU cycles. Printed by report_realtime_debug.
+  static uint32_t status_cycles_last;
+  static uint32_t status_cycles_max;
+  static uint32_t status_cycles_total;
+  static uint32_t status_count;
+#endif
+
+
  // Prints real-time data. This function grabs a real-time snapshot of the stepper subprogram
  // and the actual location of the CNC machine. Users may change the following function to their
  // specific needs, but the desired real-time data report must be as short as possible. This is
@@ -465,78 +849,86 @@ void report_echo_line_received(char *line)
  // especially during g-code programs with fast, short line segments and high frequency reports (5-20Hz).
 void report_realtime_status()
 {
+  #ifdef DEBUG
+    uint32_t start_cycles = k_cycle_get_32();
+  #endif
+
   uint8_t idx;
-  int32_t current_position[N_AXIS]; // Copy current state of the system position variable
-  memcpy(current_position,sys_position,sizeof(sys_position));
-  float print_position[N_AXIS];
-  system_convert_array_steps_to_mpos(print_position,current_position);
+  status_util_snapshot(&status_last_sent);
+  int32_t *current_position = status_last_sent.position; // Copy of the system position variable
+  int32_t print_position[N_AXIS]; // Micrometres.
+  status_util_steps_to_mpos(print_position,current_position);
 
   // Report current machine state and sub-states
-  serial_write('<');
+  status_len = 0;
+  status_put_char('<');
   switch (sys.state) {
-    case STATE_IDLE: printPgmString(PSTR("Idle")); break;
-    case STATE_CYCLE: printPgmString(PSTR("Run")); break;
+    case STATE_IDLE: status_put_str("Idle"); break;
+    case STATE_CYCLE: status_put_str("Run"); break;
     case STATE_HOLD:
       if (!(sys.suspend & SUSPEND_JOG_CANCEL)) {
-        printPgmString(PSTR("Hold:"));
-        if (sys.suspend & SUSPEND_HOLD_COMPLETE) { serial_write('0'); } // Ready to resume
-        else { serial_write('1'); } // Actively holding
+        status_put_str("Hold:");
+        if (sys.suspend & SUSPEND_HOLD_COMPLETE) { status_put_char('0'); } // Ready to resume
+        else { status_put_char('1'); } // Actively holding
         break;
       } // Continues to print jog state during jog cancel.
-    case STATE_JOG: printPgmString(PSTR("Jog")); break;
-    case STATE_HOMING: printPgmString(PSTR("Home")); break;
-    case STATE_ALARM: printPgmString(PSTR("Alarm")); break;
-    case STATE_CHECK_MODE: printPgmString(PSTR("Check")); break;
+    case STATE_JOG: status_put_str("Jog"); break;
+    case STATE_HOMING: status_put_str("Home"); break;
+    case STATE_ALARM: status_put_str("Alarm"); break;
+    case STATE_CHECK_MODE: status_put_str("Check"); break;
     case STATE_SAFETY_DOOR:
-      printPgmString(PSTR("Door:"));
+      status_put_str("Door:");
       if (sys.suspend & SUSPEND_INITIATE_RESTORE) {
-        serial_write('3'); // Restoring
+        status_put_char('3'); // Restoring
       } else {
         if (sys.suspend & SUSPEND_RETRACT_COMPLETE) {
           if (sys.suspend & SUSPEND_SAFETY_DOOR_AJAR) {
-            serial_write('1'); // Door ajar
+            status_put_char('1'); // Door ajar
           } else {
-            serial_write('0');
+            status_put_char('0');
           } // Door closed and ready to resume
         } else {
-          serial_write('2'); // Retracting
+          status_put_char('2'); // Retracting
         }
       }
       break;
-    case STATE_SLEEP: printPgmString(PSTR("Sleep")); break;
+    case STATE_SLEEP: status_put_str("Sleep"); break;
   }
 
-  float wco[N_AXIS];
   if (bit_isfalse(settings.status_report_mask,BITFLAG_RT_STATUS_POSITION_TYPE) ||
       (sys.report_wco_counter == 0) ) {
-    for (idx=0; idx< N_AXIS; idx++) {
-      // Apply work coordinate offsets and tool length offset to current position.
-      wco[idx] = gc_state.coord_system[idx]+gc_state.coord_offset[idx];
-      if (idx == TOOL_LENGTH_OFFSET_AXIS) { wco[idx] += gc_state.tool_length_offset; }
-      if (bit_isfalse(settings.status_report_mask,BITFLAG_RT_STATUS_POSITION_TYPE)) {
-        print_position[idx] -= wco[idx];
-      }
+    status_util_update_wco();
+    if (bit_isfalse(settings.status_report_mask,BITFLAG_RT_STATUS_POSITION_TYPE)) {
+      for (idx=0; idx< N_AXIS; idx++) { print_position[idx] -= status_wco.um[idx]; }
     }
   }
 
   // Report machine position
   if (bit_istrue(settings.status_report_mask,BITFLAG_RT_STATUS_POSITION_TYPE)) {
-    printPgmString(PSTR("|MPos:"));
+    status_put_str("|MPos:");
   } else {
-    printPgmString(PSTR("|WPos:"));
+    status_put_str("|WPos:");
   }
-  report_util_axis_values(print_position);
+  status_put_axis_values(print_position);
 
   // Returns planner and serial read buffer states.
   #ifdef REPORT_FIELD_BUFFER_STATE
     if (bit_istrue(settings.status_report_mask,BITFLAG_RT_STATUS_BUFFER_STATE)) {
-      printPgmString(PSTR("|Bf:"));
-      print_uint8_base10(plan_get_block_buffer_available());
-      serial_write(',');
-      print_uint8_base10(serial_get_rx_buffer_available());
+      status_put_str("|Bf:");
+      status_put_uint(plan_get_block_buffer_available());
+      status_put_char(',');
+      status_put_uint(serial_get_rx_buffer_available());
     }
   #endif
 
+  // Serial RX credits and the number of bytes lost so far.
+  if (bit_istrue(settings.status_report_mask,BITFLAG_RT_STATUS_RX_CREDITS)) {
+    status_put_str("|Rx:");
+    status_put_uint(serial_get_rx_buffer_available());
+    status_put_char(',');
+    status_put_uint(serial_get_rx_overrun_count());
+  }
+
   #ifdef USE_LINE_NUMBERS
     #ifdef REPORT_FIELD_LINE_NUMBERS
       // Report current line number
@@ -544,8 +936,8 @@ void report_realtime_status()
       if (cur_block != NULL) {
         uint32_t ln = cur_block->line_number;
         if (ln > 0) {
-          printPgmString(PSTR("|Ln:"));
-          printInteger(ln);
+          status_put_str("|Ln:");
+          status_put_uint(ln);
         }
       }
     #endif
@@ -554,14 +946,14 @@ void report_realtime_status()
   // Report realtime feed speed
   #ifdef REPORT_FIELD_CURRENT_FEED_SPEED
     #ifdef VARIABLE_SPINDLE
-      printPgmString(PSTR("|FS:"));
-      printFloat_RateValue(st_get_realtime_rate());
-      serial_write(',');
-      printFloat(sys.spindle_speed,N_DECIMAL_RPMVALUE);
+      status_put_str("|FS:");
+      status_put_rate(st_get_realtime_rate());
+      status_put_char(',');
+      status_put_uint(lroundf(sys.spindle_speed));
     #else
-      printPgmString(PSTR("|F:"));
-      printFloat_RateValue(st_get_realtime_rate());
-    #endif      
+      status_put_str("|F:");
+      status_put_rate(st_get_realtime_rate());
+    #endif
   #endif
 
   #ifdef REPORT_FIELD_PIN_STATE
@@ -569,33 +961,7 @@ void report_realtime_status()
     uint8_t ctrl_pin_state = system_control_get_state();
     uint8_t prb_pin_state = probe_get_state();
     if (lim_pin_state | ctrl_pin_state | prb_pin_state) {
-      printPgmString(PSTR("|Pn:"));
-      if (prb_pin_state) { serial_write('P'); }
-      if (lim_pin_state) {
-        #ifdef ENABLE_DUAL_AXIS
-          #if (DUAL_AXIS_SELECT == X_AXIS)
-            if (bit_istrue(lim_pin_state,(bit(X_AXIS)|bit(N_AXIS)))) { serial_write('X'); }
-            if (bit_istrue(lim_pin_state,bit(Y_AXIS))) { serial_write('Y'); }
-          #endif
-          #if (DUAL_AXIS_SELECT == Y_AXIS)
-            if (bit_istrue(lim_pin_state,bit(X_AXIS))) { serial_write('X'); }
-            if (bit_istrue(lim_pin_state,(bit(Y_AXIS)|bit(N_AXIS)))) { serial_write('Y'); }
-          #endif
-          if (bit_istrue(lim_pin_state,bit(Z_AXIS))) { serial_write('Z'); }
-        #else
-          if (bit_istrue(lim_pin_state,bit(X_AXIS))) { serial_write('X'); }
-          if (bit_istrue(lim_pin_state,bit(Y_AXIS))) { serial_write('Y'); }
-          if (bit_istrue(lim_pin_state,bit(Z_AXIS))) { serial_write('Z'); }
-        #endif
-      }
-      if (ctrl_pin_state) {
-        #ifdef ENABLE_SAFETY_DOOR_INPUT_PIN
-          if (bit_istrue(ctrl_pin_state,CONTROL_PIN_INDEX_SAFETY_DOOR)) { serial_write('D'); }
-        #endif
-        if (bit_istrue(ctrl_pin_state,CONTROL_PIN_INDEX_RESET)) { serial_write('R'); }
-        if (bit_istrue(ctrl_pin_state,CONTROL_PIN_INDEX_FEED_HOLD)) { serial_write('H'); }
-        if (bit_istrue(ctrl_pin_state,CONTROL_PIN_INDEX_CYCLE_START)) { serial_write('S'); }
-      }
+      status_put_field(&status_pn, lim_pin_state | ((uint32_t)ctrl_pin_state << 8) | ((uint32_t)prb_pin_state << 16), status_format_pn);
     }
   #endif
 
@@ -606,8 +972,7 @@ void report_realtime_status()
         sys.report_wco_counter = (REPORT_WCO_REFRESH_BUSY_COUNT-1); // Reset counter for slow refresh
       } else { sys.report_wco_counter = (REPORT_WCO_REFRESH_IDLE_COUNT-1); }
       if (sys.report_ovr_counter == 0) { sys.report_ovr_counter = 1; } // Set override on next report.
-      printPgmString(PSTR("|WCO:"));
-      report_util_axis_values(wco);
+      status_put_field(&status_wco.field, bit_istrue(settings.flags,BITFLAG_REPORT_INCHES), status_format_wco);
     }
   #endif
 
@@ -617,46 +982,75 @@ void report_realtime_status()
       if (sys.state & (STATE_HOMING | STATE_CYCLE | STATE_HOLD | STATE_JOG | STATE_SAFETY_DOOR)) {
         sys.report_ovr_counter = (REPORT_OVR_REFRESH_BUSY_COUNT-1); // Reset counter for slow refresh
       } else { sys.report_ovr_counter = (REPORT_OVR_REFRESH_IDLE_COUNT-1); }
-      printPgmString(PSTR("|Ov:"));
-      print_uint8_base10(sys.f_override);
-      serial_write(',');
-      print_uint8_base10(sys.r_override);
-      serial_write(',');
-      print_uint8_base10(sys.spindle_speed_ovr);
-
-      uint8_t sp_state = spindle_get_state();
-      uint8_t cl_state = coolant_get_state();
-      if (sp_state || cl_state) {
-        printPgmString(PSTR("|A:"));
-        if (sp_state) { // != SPINDLE_STATE_DISABLE
-          #ifdef VARIABLE_SPINDLE 
-            #ifdef USE_SPINDLE_DIR_AS_ENABLE_PIN
-              serial_write('S'); // CW
-            #else
-              if (sp_state == SPINDLE_STATE_CW) { serial_write('S'); } // CW
-              else { serial_write('C'); } // CCW
-            #endif
-          #else
-            if (sp_state & SPINDLE_STATE_CW) { serial_write('S'); } // CW
-            else { serial_write('C'); } // CCW
-          #endif
-        }
-        if (cl_state & COOLANT_STATE_FLOOD) { serial_write('F'); }
-        #ifdef ENABLE_M7
-          if (cl_state & COOLANT_STATE_MIST) { serial_write('M'); }
-        #endif
-      }  
+      status_put_field(&status_ov, sys.f_override | ((uint32_t)sys.r_override << 8) | ((uint32_t)sys.spindle_speed_ovr << 16), status_format_ov);
+      status_put_field(&status_a, spindle_get_state() | ((uint32_t)coolant_get_state() << 8), status_format_a);
     }
   #endif
 
-  serial_write('>');
-  report_util_line_feed();
+  status_put_str(">\r\n");
+  serial_write_span((const uint8_t *)status_line, status_len);
+
+  #ifdef DEBUG
+    status_cycles_last = k_cycle_get_32() - start_cycles;
+    status_cycles_max = MAX(status_cycles_max, status_cycles_last);
+    status_cycles_total += status_cycles_last;
+    status_count++;
+  #endif
+}
+
+
+/*
+  Status auto-report ($14). The timer only marks a report as due, the main program pushes it
+  if anything shown has changed since the last report. State changes (Idle -> Run etc) are
+  pushed right away, without waiting for the timer.
+*/
+static atomic_t status_auto_due;
+
+static void status_auto_timer_expiry(struct k_timer *timer)
+{
+  ARG_UNUSED(timer);
+  atomic_set(&status_auto_due, 1);
+}
+
+K_TIMER_DEFINE(status_auto_timer, status_auto_timer_expiry, NULL);
+
+// (Re)starts the auto-report timer according to the settings.
+void report_auto_status_init()
+{
+  if (settings.status_auto_report_ms == 0) {
+    k_timer_stop(&status_auto_timer);
+    return;
+  }
+  k_timer_start(&status_auto_timer, K_MSEC(settings.status_auto_report_ms), K_MSEC(settings.status_auto_report_ms));
+}
+
+// Pushes a status report if one is due and there is something new to show. Called by the
+// main program from protocol_exec_rt_system.
+void report_auto_status()
+{
+  if (settings.status_auto_report_ms == 0) { return; }
+
+  bool due = atomic_cas(&status_auto_due, 1, 0);
+  if (!due && (sys.state == status_last_sent.state)) { return; }
+
+  status_snapshot_t now;
+  status_util_snapshot(&now);
+  if (memcmp(&now, &status_last_sent, sizeof(now)) != 0) { report_realtime_status(); }
 }
 
 
 #ifdef DEBUG
+  // Prints the cost of the status reports: "{status:<last>,<max>,<average> cycles}". Poll
+  // '?' (20Hz is what senders do) while a job is running, then send CMD_DEBUG_REPORT.
   void report_realtime_debug()
   {
-
+    printPgmString(PSTR("{status:"));
+    print_uint32_base10(status_cycles_last);
+    serial_write(',');
+    print_uint32_base10(status_cycles_max);
+    serial_write(',');
+    print_uint32_base10(status_count ? status_cycles_total / status_count : 0);
+    printPgmString(PSTR(" cycles}"));
+    report_util_line_feed();
   }
 #endif
@@ -19,6 +19,7 @@
 */
 #ifndef report_h
 #define report_h
+#include "estimator.h" // estimate_t
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -63,6 +64,17 @@ extern "C" {
 #define STATUS_GCODE_G43_DYNAMIC_AXIS_ERROR 37
 #define STATUS_GCODE_MAX_VALUE_EXCEEDED 38
 
+#define STATUS_BINARY_STREAM_FRAME 60 // Corrupted or lost binary stream frame.
+#define STATUS_BINARY_STREAM_SEQUENCE 61 // Binary stream record out of sequence.
+
+#define STATUS_OWORD_SYNTAX 62 // Malformed, unmatched or misplaced O-word.
+#define STATUS_OWORD_MEMORY 63 // No room left for the subroutine or the loop.
+#define STATUS_OWORD_UNDEFINED 64 // Call of an undefined subroutine.
+#define STATUS_OWORD_NESTING 65 // Calls and loops nested too deep.
+
+#define STATUS_FILE_READ 66 // The file to estimate ($E) can't be opened or read.
+#define STATUS_ESTIMATE_ABORTED 67 // The estimate ($E) was stopped by a reset.
+
 // Define Grbl alarm codes. Valid values (1-255). 0 is reserved.
 #define ALARM_HARD_LIMIT_ERROR      EXEC_ALARM_HARD_LIMIT
 #define ALARM_SOFT_LIMIT_ERROR      EXEC_ALARM_SOFT_LIMIT
@@ -86,6 +98,7 @@ extern "C" {
 #define MESSAGE_RESTORE_DEFAULTS 9
 #define MESSAGE_SPINDLE_RESTORE 10
 #define MESSAGE_SLEEP_MODE 11
+#define MESSAGE_RX_OVERRUN 12
 
 // Prints system status messages.
 void report_status_message(uint8_t status_code);
@@ -99,6 +112,10 @@ void report_feedback_message(uint8_t message_code);
 // Prints welcome message
 void report_init_message();
 
+// Prints binary stream acknowledgements. See binary_stream.h.
+void report_binary_stream_ack(uint8_t seq, uint8_t available);
+void report_binary_stream_nak(uint8_t seq, uint8_t status_code);
+
 // Prints Grbl help and current global settings
 void report_grbl_help();
 
@@ -124,9 +141,17 @@ void report_gcode_modes();
 void report_startup_line(uint8_t n, char *line);
 void report_execute_startup_message(char *line, uint8_t status_code);
 
+// Prints a job estimate ($E)
+void report_estimate(estimate_t *estimate);
+
 // Prints build info and user info
 void report_build_info(char *line);
 
+// Status auto-report ($14). Init (re)starts the timer, report_auto_status pushes a report
+// when one is due and something has changed.
+void report_auto_status_init();
+void report_auto_status();
+
 #ifdef DEBUG
   void report_realtime_debug();
 #endif
@@ -0,0 +1,158 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#include "grbl.h"
+#include <stdio.h>
+
+#if RESUME_N_AXIS != N_AXIS
+  #error "RESUME_N_AXIS must be equal to N_AXIS"
+#endif
+
+// The lines of resume_state_line, in this order. The ones which don't apply are skipped.
+#define RESUME_HOME 0     // $H, only if homing is enabled.
+#define RESUME_STOP 1     // Pen up before anything moves.
+#define RESUME_MOVE 2     // Back to the position, only if homing is enabled.
+#define RESUME_OFFSETS 3  // Coordinate system and tool length offset.
+#define RESUME_WORK 4     // G92, so the work position is what it was.
+#define RESUME_MOTION 5   // Motion mode and feed rate.
+#define RESUME_MODES 6
+#define RESUME_MIST 7
+#define RESUME_FLOOD 8
+#define RESUME_SPINDLE 9  // Pen down last, at the position.
+#define RESUME_LINES 10
+
+#define RESUME_DECIMALS 4 // More than the stepper resolution of any machine.
+
+
+void resume_state_save(resume_state_t *state)
+{
+  uint8_t idx;
+  for (idx=0; idx<N_AXIS; idx++) {
+    state->position[idx] = gc_state.position[idx];
+    state->work_position[idx] = gc_state.position[idx]-gc_state.coord_system[idx]-gc_state.coord_offset[idx];
+    if (idx == TOOL_LENGTH_OFFSET_AXIS) { state->work_position[idx] -= gc_state.tool_length_offset; }
+  }
+  state->feed_rate = gc_state.feed_rate;
+  state->spindle_speed = gc_state.spindle_speed;
+  state->tool_length_offset = gc_state.tool_length_offset;
+  state->motion = gc_state.modal.motion;
+  state->feed_rate_mode = gc_state.modal.feed_rate;
+  state->units = gc_state.modal.units;
+  state->distance = gc_state.modal.distance;
+  state->plane_select = gc_state.modal.plane_select;
+  state->tool_length = gc_state.modal.tool_length;
+  state->coord_select = gc_state.modal.coord_select;
+  state->spindle = gc_state.modal.spindle;
+  state->coolant = gc_state.modal.coolant;
+  // Everything the line (and the ones before) put into the planner, or will.
+  state->done_at = plan_get_completed_block_count()+plan_get_block_buffer_count()+mc_get_queued_motion_count();
+}
+
+
+bool resume_state_executed(const resume_state_t *state)
+{
+  // Difference, not comparison, the counter wraps around.
+  return((int32_t)(plan_get_completed_block_count()-state->done_at) >= 0);
+}
+
+
+bool resume_state_restorable(const resume_state_t *state)
+{
+  return((state->motion == MOTION_MODE_SEEK) || (state->motion == MOTION_MODE_LINEAR) || (state->motion == MOTION_MODE_NONE));
+}
+
+
+// Appends "X1.2345Y..." for all the axes.
+static int resume_print_axes(char *line, uint8_t size, const float *values)
+{
+  static const char axis_letters[N_AXIS] = { 'X', 'Y', 'Z' };
+  int len = 0;
+  uint8_t idx;
+  for (idx=0; idx<N_AXIS && len < size; idx++) {
+    len += snprintf(line+len, size-len, "%c%.*f", axis_letters[idx], RESUME_DECIMALS, (double)values[idx]);
+  }
+  return(len);
+}
+
+
+// Writes the line, returns false if it doesn't apply to the state.
+static bool resume_print_line(const resume_state_t *state, uint8_t which, char *line, uint8_t size)
+{
+  bool homing = bit_istrue(settings.flags,BITFLAG_HOMING_ENABLE);
+  int len = 0;
+
+  switch (which) {
+    case RESUME_HOME:
+      if (!homing) { return(false); }
+      snprintf(line, size, "$H");
+      break;
+    case RESUME_STOP:
+      snprintf(line, size, "M5M9");
+      break;
+    case RESUME_MOVE:
+      if (!homing) { return(false); }
+      len = snprintf(line, size, "G21G90G53G0");
+      resume_print_axes(line+len, size-len, state->position);
+      break;
+    case RESUME_OFFSETS:
+      len = snprintf(line, size, "G21G90G%d", 54+state->coord_select);
+      if (state->tool_length == TOOL_LENGTH_OFFSET_ENABLE_DYNAMIC) {
+        snprintf(line+len, size-len, "G43.1Z%.*f", RESUME_DECIMALS, (double)state->tool_length_offset);
+      } else {
+        snprintf(line+len, size-len, "G49");
+      }
+      break;
+    case RESUME_WORK:
+      len = snprintf(line, size, "G21G90G92");
+      resume_print_axes(line+len, size-len, state->work_position);
+      break;
+    case RESUME_MOTION:
+      if (state->motion == MOTION_MODE_NONE) {
+        snprintf(line, size, "G80");
+      } else if (state->feed_rate_mode == FEED_RATE_MODE_INVERSE_TIME) {
+        // Every motion line has its own F in G93, this one is there only to let G1 be set.
+        snprintf(line, size, "G93G%dF1", state->motion);
+      } else if (state->feed_rate > 0.0) {
+        snprintf(line, size, "G21G94G%dF%.*f", state->motion, RESUME_DECIMALS, (double)state->feed_rate);
+      } else {
+        snprintf(line, size, "G94G0");
+      }
+      break;
+    case RESUME_MODES:
+      snprintf(line, size, "G%dG%dG%dG%d", 17+state->plane_select, 90+state->distance,
+        (state->feed_rate_mode == FEED_RATE_MODE_INVERSE_TIME) ? 93 : 94, (state->units == UNITS_MODE_INCHES) ? 20 : 21);
+      break;
+    case RESUME_MIST:
+      if (bit_isfalse(state->coolant,COOLANT_MIST_ENABLE)) { return(false); }
+      snprintf(line, size, "M7");
+      break;
+    case RESUME_FLOOD:
+      if (bit_isfalse(state->coolant,COOLANT_FLOOD_ENABLE)) { return(false); }
+      snprintf(line, size, "M8");
+      break;
+    case RESUME_SPINDLE:
+      len = snprintf(line, size, "S%.*f", RESUME_DECIMALS, (double)state->spindle_speed);
+      if (state->spindle == SPINDLE_ENABLE_CW) { snprintf(line+len, size-len, "M3"); }
+      else if (state->spindle == SPINDLE_ENABLE_CCW) { snprintf(line+len, size-len, "M4"); }
+      break;
+  }
+  return(true);
+}
+
+
+bool resume_state_line(const resume_state_t *state, uint8_t n, char *line, uint8_t size)
+{
+  uint8_t which;
+  for (which=0; which<RESUME_LINES; which++) {
+    if (resume_print_line(state, which, line, size)) {
+      if (n == 0) { return(true); }
+      n--;
+    }
+  }
+  return(false);
+}
@@ -0,0 +1,69 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#ifndef resume_h
+#define resume_h
+#include <stdbool.h>
+#include <stdint.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  What's needed to continue a job after a power loss from the line following a given one: where
+  the tool is at the end of that line and the modal state of the parser. Plain data, so it can
+  be stored in the flash as it is.
+
+  The state is restored by a few g-code lines (resume_state_line) sent before the rest of the
+  job. If homing is enabled the machine is homed and the tool goes back to the position, pen
+  (spindle) off. Otherwise the machine is assumed not to have moved and only the work
+  coordinates are set to where they were.
+*/
+
+// N_AXIS. This header is included from C++, where nuts_bolts.h can't be (min and max macros).
+#define RESUME_N_AXIS 3
+
+typedef struct {
+  float position[RESUME_N_AXIS];      // Machine coordinates [mm].
+  float work_position[RESUME_N_AXIS]; // The same point in the work coordinates [mm].
+  float feed_rate;                    // [mm/min]
+  float spindle_speed;
+  float tool_length_offset;
+  uint8_t motion;
+  uint8_t feed_rate_mode;
+  uint8_t units;
+  uint8_t distance;
+  uint8_t plane_select;
+  uint8_t tool_length;
+  uint8_t coord_select;
+  uint8_t spindle;
+  uint8_t coolant;
+  uint32_t done_at; // plan_get_completed_block_count() once the line's motions are executed.
+} resume_state_t;
+
+// Takes the snapshot after a line was executed by the parser. Main thread only.
+void resume_state_save(resume_state_t *state);
+
+// True once the motions of the line left the planner. Any thread. Then only the stepper segment
+// buffer (a few ms of motion) is ahead of the position. A motion dropped as empty by the planner
+// makes it true one block later, which is on the safe side: a segment is drawn twice, not skipped.
+bool resume_state_executed(const resume_state_t *state);
+
+// False in an arc or probing motion mode. These can't be set without a motion, so the next
+// lines of the job, if they don't repeat the G word, would be something else. Such a state
+// shouldn't be stored, a later one should.
+bool resume_state_restorable(const resume_state_t *state);
+
+// Writes the n-th (from 0) line of the g-code which restores the state. Returns false after the
+// last one.
+bool resume_state_line(const resume_state_t *state, uint8_t n, char *line, uint8_t size);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
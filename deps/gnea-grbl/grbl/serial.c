@@ -26,35 +26,97 @@
 
 LOG_MODULE_REGISTER(serial);
 
-const struct device *uart = NULL;
+#define RX_PACKET_SIZE 64 // Full speed USB bulk packet. Read from the FIFO at once.
 
-K_MUTEX_DEFINE(rxUartMutex);
-RING_BUF_ITEM_DECLARE_SIZE(rxRingBuf, RX_BUFFER_SIZE);
-
-// uint8_t rxRingBufferBlock[RX_BUFFER_SIZE]; // Power of 2 is more efficient
-// here (according to the docs) struct ring_buf rxRingBuf; // This ringBuffer is
-// used both for the serial port and the sd card
-
-K_MUTEX_DEFINE(lineUartMutex);
-RING_BUF_ITEM_DECLARE_SIZE(lineRingBuf, TX_BUFFER_SIZE_WORDS);
-// uint32_t lineRingBufferBlock[TX_BUFFER_SIZE_WORDS];
-// struct ring_buf lineRingBuf; // Ring buffer for line based responses from the
-// GRBL used for interactions with the SD casrd subsystem.
+/*
+ * Input channels. Each one has its own RX ring and lines are never mixed:
+ * serial_read() takes whole lines from one channel at a time. `eol` counts the
+ * line ends in the ring, so a channel is picked only when it has a complete line
+ * to offer (or a full ring). `burst` is how many lines in a row a channel may
+ * take before the others get a turn.
+ */
+struct serial_channel {
+  struct ring_buf *rx;
+  atomic_t eol;
+  atomic_t overruns; // Bytes dropped because rx was full. Never reset.
+  uint8_t burst;
+};
+
+RING_BUF_DECLARE(usbRxRingBuf, RX_BUFFER_SIZE);
+RING_BUF_DECLARE(debugRxRingBuf, DEBUG_RX_BUFFER_SIZE);
+RING_BUF_DECLARE(sdRxRingBuf, SD_RX_BUFFER_SIZE);
+RING_BUF_DECLARE(uiRxRingBuf, UI_RX_BUFFER_SIZE);
+
+static struct serial_channel channels[N_SERIAL_CHANNEL] = {
+    [SERIAL_CHANNEL_USB] = {.rx = &usbRxRingBuf, .burst = 1},
+    [SERIAL_CHANNEL_DEBUG] = {.rx = &debugRxRingBuf, .burst = 1},
+    [SERIAL_CHANNEL_SD] = {.rx = &sdRxRingBuf, .burst = 8},
+    [SERIAL_CHANNEL_UI] = {.rx = &uiRxRingBuf, .burst = 1},
+};
+
+// Serializes writers of the channels fed by threads (SD, UI).
+K_MUTEX_DEFINE(channelWriteMutex);
+
+// Read side state. Touched only by the GRBL main thread.
+static uint8_t readChannel = SERIAL_CHANNEL_USB; // The line being read is from here.
+static bool midLine;     // Part of the line has been read. Stay on readChannel.
+static uint8_t burstLeft;
+
+// Where the output goes. SERIAL_CHANNEL_ALL unless a line is being executed.
+static uint8_t replyChannel = SERIAL_CHANNEL_ALL;
+
+// A UART (or CDC ACM) feeding one channel and receiving its output.
+static void uartSinkWrite(const uint8_t *data, uint32_t len, bool eol,
+                          void *user_data);
+
+struct serial_uart {
+  const struct device *dev;
+  struct ring_buf *tx; // Character based buffer for GRBL responses.
+  struct serial_sink sink;
+  uint8_t channel;
+};
+
+RING_BUF_DECLARE(usbTxRingBuf, TX_BUFFER_SIZE_BYTES);
+static struct serial_uart usbUart = {
+    .tx = &usbTxRingBuf,
+    .sink = {.write = uartSinkWrite, .user_data = &usbUart, .channel = SERIAL_CHANNEL_USB},
+    .channel = SERIAL_CHANNEL_USB};
+
+#if DT_NODE_EXISTS(DT_ALIAS(grbldebuguart))
+// NOTE: Must not be the console UART, printk would fight with the IRQ driven TX.
+RING_BUF_DECLARE(debugTxRingBuf, DEBUG_TX_BUFFER_SIZE);
+static struct serial_uart debugUart = {
+    .tx = &debugTxRingBuf,
+    .sink = {.write = uartSinkWrite, .user_data = &debugUart, .channel = SERIAL_CHANNEL_DEBUG},
+    .channel = SERIAL_CHANNEL_DEBUG};
+#endif
 
-// uint8_t txRingBufferBlock[TX_BUFFER_SIZE_BYTES];
-// struct ring_buf txRingBuf; // Character based buffer for GRBL responses. This
-// will be sent out via UART.
-RING_BUF_ITEM_DECLARE_SIZE(txRingBuf, TX_BUFFER_SIZE_BYTES);
+// The channel `ok:<n>` and the status report tell about: the one the line came
+// from, the host otherwise.
+static struct serial_channel *serial_reported_channel() {
+  return &channels[(replyChannel < N_SERIAL_CHANNEL) ? replyChannel : SERIAL_CHANNEL_USB];
+}
 
 // Returns the number of bytes available in the RX serial buffer.
 uint32_t serial_get_rx_buffer_available() {
-  return ring_buf_capacity_get(&rxRingBuf) - ring_buf_size_get(&rxRingBuf);
+  return ring_buf_space_get(serial_reported_channel()->rx);
+}
+
+// Returns the number of bytes dropped because the RX serial buffer was full.
+uint32_t serial_get_rx_overrun_count() {
+  return atomic_get(&serial_reported_channel()->overruns);
+}
+
+uint32_t serial_get_channel_overrun_count(uint8_t channel) {
+  return atomic_get(&channels[channel].overruns);
 }
 
 // Returns the number of bytes used in the RX serial buffer.
 // NOTE: Deprecated. Not used unless classic status reports are enabled in
 // config.h.
-uint32_t serial_get_rx_buffer_count() { return ring_buf_size_get(&rxRingBuf); }
+uint32_t serial_get_rx_buffer_count() {
+  return ring_buf_size_get(serial_reported_channel()->rx);
+}
 
 // Returns the number of bytes used in the TX serial buffer.
 // NOTE: Not used except for debugging and ensuring no TX bottlenecks.
@@ -63,81 +125,153 @@ uint32_t serial_get_rx_buffer_count() { return ring_buf_size_get(&rxRingBuf); }
 
 static void uartInterruptHandler(const struct device *dev, void *user_data);
 
-void serial_init() {
-  // Before error checking (which returns from this function and would leave
-  // ring buffers uninitialized). ring_buf_init (&rxRingBuf, sizeof
-  // (rxRingBufferBlock), rxRingBufferBlock); ring_buf_init (&lineRingBuf,
-  // sizeof (lineRingBufferBlock) / 4, lineRingBufferBlock); ring_buf_init
-  // (&txRingBuf, sizeof (txRingBufferBlock), txRingBufferBlock);
+// Everything GRBL prints is published to these. The UARTs are just some of them.
+static sys_slist_t sinks = SYS_SLIST_STATIC_INIT(&sinks);
+
+static bool serial_uart_init(struct serial_uart *uart,
+                             const struct device *dev) {
+  if (!device_is_ready(dev)) {
+    LOG_ERR("Problem configuring uart %s", dev->name);
+    return false;
+  }
 
+  // IRQ based API.
+  uart->dev = dev;
+  uart_irq_callback_user_data_set(dev, uartInterruptHandler, uart);
+  serial_sink_register(&uart->sink);
+
+  /* Enable rx interrupts */
+  uart_irq_rx_enable(dev);
+  return true;
+}
+
+void serial_init() {
   // This usart has to be initialized and set-up in src/mcu-peripherals.cc
   // uart = device_get_binding(DT_PROP(DT_ALIAS(grbluart), label));
-  uart = DEVICE_DT_GET(DT_ALIAS(grbluart));
+  serial_uart_init(&usbUart, DEVICE_DT_GET(DT_ALIAS(grbluart)));
 
-  // SD card functions check the uart variable to see if serial.c subsys. is
-  // ready. So in this line they would see it is (if uart != NULL).
+#if DT_NODE_EXISTS(DT_ALIAS(grbldebuguart))
+  serial_uart_init(&debugUart, DEVICE_DT_GET(DT_ALIAS(grbldebuguart)));
+#endif
+}
 
-  if (!uart) {
-    LOG_ERR("Problem configuring uart");
-    return;
-  }
+// Outgoing bytes are collected here and published once per line, so a whole
+// report costs every sink one call instead of one call per byte. txLineChannel
+// is the audience they were written for (replyChannel at the time).
+static uint8_t txLine[TX_LINE_BUFFER_SIZE];
+static uint32_t txLineLen = 0;
+static uint8_t txLineChannel = SERIAL_CHANNEL_ALL;
+
+// The UART sink. Commits the data to the TX ring with one claim/finish and
+// kicks the TX IRQ once. If the ring is full, it spins until the ISR makes
+// room (only aborting on reset). This sink never drops anything.
+static void uartSinkWrite(const uint8_t *data, uint32_t len, bool eol,
+                          void *user_data) {
+  ARG_UNUSED(eol);
+  struct serial_uart *uart = user_data;
+
+  while (len > 0) {
+    uint8_t *dst = NULL;
+    uint32_t claimed = ring_buf_put_claim(uart->tx, &dst, len);
+
+    if (claimed == 0) {
+      // TODO: Restructure st_prep_buffer() calls to be executed here during a
+      // long print.
+      uart_irq_tx_enable(uart->dev);
+
+      if (sys_rt_exec_state & EXEC_RESET) {
+        return;
+      } // Only check for abort to avoid an endless loop.
+
+      k_yield();
+      continue;
+    }
 
-  // IRQ based API.
-  uart_irq_callback_set(uart, uartInterruptHandler);
+    memcpy(dst, data, claimed);
+    ring_buf_put_finish(uart->tx, claimed);
+    data += claimed;
+    len -= claimed;
+  }
 
-  /* Enable rx interrupts */
-  uart_irq_rx_enable(uart);
+  uart_irq_tx_enable(uart->dev);
 }
 
-// Writes one byte to the TX serial buffer. Called by main program.
-void serial_write(uint8_t data) {
+/**
+ * Registers a sink which will receive the GRBL output from now on: replies to
+ * the lines from sink->channel and everything not being a reply (reports,
+ * alarms etc). A sink with channel SERIAL_CHANNEL_ALL gets all the output.
+ * Sinks are meant to be registered once and live forever. They are called from
+ * the GRBL main thread and must not keep the data pointer after they return.
+ * Every sink has its own policy for when it can't keep up (block, drop etc).
+ */
+void serial_sink_register(struct serial_sink *sink) {
+  unsigned int key = irq_lock();
+  sys_slist_append(&sinks, &sink->node);
+  irq_unlock(key);
+}
 
-  // First add a byte to the UART buffer. This gets sent to the PC.
-  while (ring_buf_put(&txRingBuf, &data, 1) != 1) {
-    // TODO: Restructure st_prep_buffer() calls to be executed here during a
-    // long print.
-    if (sys_rt_exec_state & EXEC_RESET) {
-      return;
-    } // Only check for abort to avoid an endless loop.
+// Publishes whatever has been collected in txLine. `eol` tells the sinks if
+// this is the end of a line or only a part of a longer one.
+static void serial_tx_flush_line(bool eol) {
+  if (txLineLen == 0) {
+    return;
   }
 
-  // And now another buffer that stores the same information (GRBL responses)
-  // but line by line. This is to make a cooperation with SD thread easy. Double
-  // buffered.
-  static uint8_t l2buffer[LINE_BUFFER_SIZE] = {'\0'};
-  static uint8_t len = 0;
-  static bool cr = false; // \r
-  bool lf = false;
-
-  if (data == '\r') {
-    cr = true;
-  } else if (cr && data == '\n') {
-    lf = true;
-    cr = false;
+  struct serial_sink *sink;
+  SYS_SLIST_FOR_EACH_CONTAINER(&sinks, sink, node) {
+    if (txLineChannel == SERIAL_CHANNEL_ALL ||
+        sink->channel == SERIAL_CHANNEL_ALL || sink->channel == txLineChannel) {
+      sink->write(txLine, txLineLen, eol, sink->user_data);
+    }
   }
 
-  l2buffer[len++] = data;
+  txLineLen = 0;
+}
 
-  // Adds only line by line.
-  if (lf) {
-    k_mutex_lock(&lineUartMutex, K_FOREVER);
+// Writes `len` bytes to the TX serial buffer. Output is buffered and flushed at
+// every line feed, so callers should pass whole strings instead of single
+// characters whenever they can. Called by main program.
+void serial_write_span(const uint8_t *data, uint32_t len) {
+  if (txLineChannel != replyChannel) {
+    serial_tx_flush_line(false); // Whatever is pending goes to the old audience.
+    txLineChannel = replyChannel;
+  }
 
-    // This data structure preserves the line length (and number of lines).
-    if (ring_buf_item_put(&lineRingBuf, 0, len, (uint32_t *)l2buffer,
-                          len / 4 + len % 4) != 0) {
-      LOG_ERR("lineRingBuf bytes skipped");
+  while (len > 0) {
+    const uint8_t *lf = memchr(data, '\n', len);
+    uint32_t chunk = (lf != NULL) ? (uint32_t)(lf - data) + 1 : len;
+    uint32_t room = TX_LINE_BUFFER_SIZE - txLineLen;
+
+    if (chunk > room) { // Longer than the scratch buffer. Send it in parts.
+      chunk = room;
+      lf = NULL;
     }
 
-    k_mutex_unlock(&lineUartMutex);
-    // uart_irq_tx_enable (uart);
-    len = 0;
-    l2buffer[0] = '\0';
-    cr = false;
-  }
+    memcpy(txLine + txLineLen, data, chunk);
+    txLineLen += chunk;
+    data += chunk;
+    len -= chunk;
 
-  uart_irq_tx_enable(uart);
+    if (lf != NULL || txLineLen == TX_LINE_BUFFER_SIZE) {
+      serial_tx_flush_line(lf != NULL);
+    }
+  }
 }
 
+// Writes one byte to the TX serial buffer. Called by main program.
+void serial_write(uint8_t data) { serial_write_span(&data, 1); }
+
+// Sends out a partial line (one not terminated with a line feed yet).
+void serial_flush() { serial_tx_flush_line(false); }
+
+// Directs the output to the sinks of one channel only (replies to a line from
+// it), or to all of them with SERIAL_CHANNEL_ALL. Cheap: a pending partial line
+// is only sent out when something is written for the new audience, so a switch
+// there and back without any output in between doesn't break the batching.
+void serial_reply_to(uint8_t channel) { replyChannel = channel; }
+
+uint8_t serial_get_reply_channel() { return replyChannel; }
+
 /*
 // Data Register Empty Interrupt handler
 ISR(SERIAL_UDRE)
@@ -160,21 +294,63 @@ UDRIE0); }
 }
 */
 
+// True if the channel has a whole line waiting or no room for the rest of it.
+static bool serial_channel_ready(struct serial_channel *ch) {
+  return atomic_get(&ch->eol) > 0 || ring_buf_space_get(ch->rx) == 0;
+}
+
+// Picks the channel the next line is read from. Round robin over the ready
+// channels, the current one keeps reading until it uses up its burst.
+static bool serial_select_channel() {
+  if (burstLeft > 0 && serial_channel_ready(&channels[readChannel])) {
+    return true;
+  }
+
+  for (uint8_t i = 1; i <= N_SERIAL_CHANNEL; ++i) {
+    uint8_t ch = (readChannel + i) % N_SERIAL_CHANNEL;
+
+    if (serial_channel_ready(&channels[ch])) {
+      readChannel = ch;
+      burstLeft = channels[ch].burst;
+      return true;
+    }
+  }
+
+  return false;
+}
+
 // Fetches the first byte in the serial read buffer. Called by main program.
 uint8_t serial_read() {
+  if (!midLine) {
+    if (!serial_select_channel()) {
+      return SERIAL_NO_DATA;
+    }
+
+    midLine = true;
+  }
+
+  struct serial_channel *ch = &channels[readChannel];
   uint8_t data;
 
-  k_mutex_lock(&rxUartMutex, K_FOREVER); // Isn't it too frequently?
-  uint32_t bytesRead = ring_buf_get(&rxRingBuf, &data, 1);
-  k_mutex_unlock(&rxUartMutex);
+  if (ring_buf_get(ch->rx, &data, 1) != 1) {
+    return SERIAL_NO_DATA; // Rest of the line is still on its way.
+  }
+
+  if (data == '\n' || data == '\r') {
+    atomic_dec(&ch->eol);
+    midLine = false;
 
-  if (bytesRead != 1) {
-    return SERIAL_NO_DATA;
+    if (burstLeft > 0) {
+      --burstLeft;
+    }
   }
 
   return data;
 }
 
+// The channel the last byte returned by serial_read() came from.
+uint8_t serial_get_read_channel() { return readChannel; }
+
 /**
  * Checks if `data` is a real-time command, runs it and returns true.
  * Renturns false otherwise.
@@ -274,37 +450,64 @@ bool serial_check_real_time_command(char data) {
   return true;
 }
 
+/*
+ * Reads the UART FIFO in whole packets straight into the channel's RX ring. If
+ * the ring is full, the packet still has to be read (and real-time commands in
+ * it executed), so it goes to a scratch buffer and its g-code is dropped.
+ */
+static void serial_rx_read(struct serial_uart *uart) {
+  struct serial_channel *ch = &channels[uart->channel];
+  // Binary frames only from the host. There is one frame decoder.
+  bool binary = (uart->channel == SERIAL_CHANNEL_USB);
+
+  while (true) {
+    uint8_t scratch[RX_PACKET_SIZE];
+    uint8_t *dst = NULL;
+    uint32_t claimed = ring_buf_put_claim(ch->rx, &dst, RX_PACKET_SIZE);
+
+    if (claimed == 0) {
+      dst = scratch;
+    }
+
+    int len = uart_fifo_read(uart->dev, dst,
+                             (claimed > 0) ? claimed : sizeof(scratch));
+
+    if (len <= 0) {
+      if (claimed > 0) {
+        ring_buf_put_finish(ch->rx, 0);
+      }
+
+      return;
+    }
+
+    uint32_t eol = 0;
+    uint32_t kept = serial_rx_filter(dst, len, binary, &eol);
+
+    if (claimed > 0) {
+      ring_buf_put_finish(ch->rx, kept);
+      atomic_add(&ch->eol, eol); // After the bytes are in.
+    } else if (kept > 0) {
+      atomic_add(&ch->overruns, kept); // Reported by the main program.
+    }
+  }
+}
+
 /**
  *
  */
 static void uartInterruptHandler(const struct device *dev, void *user_data) {
-  ARG_UNUSED(user_data);
+  struct serial_uart *uart = user_data;
 
   while (uart_irq_update(dev) && uart_irq_is_pending(dev)) {
 
     if (uart_irq_rx_ready(dev)) {
-      int recvLen = 0;
-      uint8_t data = 0;
-
-      while ((recvLen = uart_fifo_read(dev, &data, 1)) == 1) {
-        // Pick off realtime command characters directly from the serial stream.
-        // These characters are not passed into the main buffer, but these set
-        // system state flag bits for realtime execution.
-
-        if (!serial_check_real_time_command(data)) { // Write character to buffer
-          int written = ring_buf_put(&rxRingBuf, &data, 1);
-
-          if (written != 1) {
-            LOG_ERR("GRBL UART RX byte dropped.");
-          }
-        }
-      } // while
+      serial_rx_read(uart);
     }
 
     if (uart_irq_tx_ready(dev)) {
       uint8_t buffer[LINE_BUFFER_SIZE];
 
-      uint32_t bytesReadLen = ring_buf_get(&txRingBuf, buffer, sizeof(buffer));
+      uint32_t bytesReadLen = ring_buf_get(uart->tx, buffer, sizeof(buffer));
 
       if (bytesReadLen == 0) {
         uart_irq_tx_disable(dev);
@@ -321,92 +524,47 @@ static void uartInterruptHandler(const struct device *dev, void *user_data) {
 }
 
 /****************************************************************************/
-/* Access to the RX and TX buffers from the outside (for the SD card        */
-/* implementation).                                                         */
+/* Access to the RX buffers from the outside (for the SD card and the UI).  */
 /****************************************************************************/
 
-void serial_reset_read_buffer() { ring_buf_reset(&rxRingBuf); }
-void serial_reset_transmit_buffer() { ring_buf_reset(&lineRingBuf); }
-
-bool serial_is_initialized() { return uart != NULL; }
-
-/**
- * Disables both RX and TX IRQs.
- */
-void serial_disable_irqs() {
-  if (uart == NULL) {
-    return;
+// Empties all the channels. Used by e-stop and reset, an SD job is aborted too.
+void serial_reset_read_buffer() {
+  for (uint8_t i = 0; i < N_SERIAL_CHANNEL; ++i) {
+    ring_buf_reset(channels[i].rx);
+    atomic_clear(&channels[i].eol);
   }
 
-  uart_irq_rx_disable(uart);
-  // uart_irq_tx_disable(uart);
+  midLine = false;
+  burstLeft = 0;
+  serial_reply_to(SERIAL_CHANNEL_ALL); // The line being replied to is gone.
 }
 
+bool serial_is_initialized() { return usbUart.dev != NULL; }
+
 /**
- * Enables both RX and TX IRQs.
+ * Appends a string (a line[s]) to the RX buffer of a channel as if they had
+ * been received. All or nothing: returns the number of bytes written, 0 if
+ * there was no room for the whole string. For the channels fed by threads (SD,
+ * UI), do not call from an ISR.
  */
-void serial_enable_irqs() {
-  if (uart == NULL) {
-    return;
-  }
+uint32_t serial_channel_write(uint8_t channel, const char *str) {
+  struct serial_channel *ch = &channels[channel];
+  uint32_t len = strlen(str);
+  uint32_t eol = serial_count_eol((const uint8_t *)str, len);
 
-  uart_irq_rx_enable(uart);
-  // uart_irq_tx_enable(uart);
-}
+  k_mutex_lock(&channelWriteMutex, K_FOREVER);
+  uint32_t written = 0;
 
-static uint32_t serial_buffer_appendln_impl(const char *str, bool crlf) {
-  uart_irq_rx_disable(uart); // Disable the IRQ whch puts bytes into the
-                             // rxRingBuf (from the UART's register)
-  k_mutex_lock(&rxUartMutex,
-               K_FOREVER); // Lock the GRBL main thread which reads this buffer
-  uint32_t written =
-      ring_buf_put(&rxRingBuf, (const uint8_t *)str,
-                   strlen(str)); // Then finally put something into it
-
-  if (crlf) {
-    ring_buf_put(&rxRingBuf, (const uint8_t *)"\r\n", 2);
+  if (ring_buf_space_get(ch->rx) >= len) {
+    written = ring_buf_put(ch->rx, (const uint8_t *)str, len);
+    atomic_add(&ch->eol, eol);
   }
 
-  k_mutex_unlock(&rxUartMutex);
-  uart_irq_rx_enable(uart);
+  k_mutex_unlock(&channelWriteMutex);
   return written;
 }
 
-/**
- * Appends a string (a line[s]) to the RX buffer as if they has been sent
- * through UART. Do not call from the ISR, call from the user code. Can be
- * called only if UART IRQs are off!
- */
-uint32_t serial_buffer_append(const char *str) {
-  return serial_buffer_appendln_impl(str, false);
+// Bytes a serial_channel_write() to the channel can take now.
+uint32_t serial_channel_available(uint8_t channel) {
+  return ring_buf_space_get(channels[channel].rx);
 }
-
-/**
- * As the serial_buffer_append, but adds \r\n at the end.
- */
-uint32_t serial_buffer_appendln(const char *str) {
-  return serial_buffer_appendln_impl(str, true);
-}
-
-/**
- * Returns line size in bytes (can be 0). Or -1 if the buffer
- * is too small (bufSize).
- */
-int serial_get_tx_line(uint32_t *buffer, uint8_t bufSize) {
-  uint16_t type = 0;
-  uint8_t lineLen = 0;
-
-  k_mutex_lock(&lineUartMutex, K_FOREVER);
-  int ret = ring_buf_item_get(&lineRingBuf, &type, &lineLen, buffer, &bufSize);
-  k_mutex_unlock(&lineUartMutex);
-
-  if (ret == -EAGAIN) { // Ring buffer empty
-    return 0;
-  }
-
-  if (ret < 0) {
-    return ret;
-  }
-
-  return lineLen;
-}
\ No newline at end of file
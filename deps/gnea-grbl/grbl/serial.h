@@ -29,30 +29,69 @@ extern "C" {
 // #include <zephyr/drivers/ua>
 #include <stdint.h>
 #include <stdbool.h>
+#include <zephyr/sys/slist.h>
 
 #ifndef RX_BUFFER_SIZE
   #define RX_BUFFER_SIZE 1024
 #endif
 
+// RX buffers of the other input channels (RX_BUFFER_SIZE is the host's).
+#define DEBUG_RX_BUFFER_SIZE 256
+#define SD_RX_BUFFER_SIZE 1024
+#define UI_RX_BUFFER_SIZE 256
+
 #define TX_BUFFER_SIZE_BYTES 1024
+#define DEBUG_TX_BUFFER_SIZE 256
 #define TX_BUFFER_SIZE_WORDS (TX_BUFFER_SIZE_BYTES/4)
+#define TX_LINE_BUFFER_SIZE 128 // Scratch buffer for one outgoing line.
 #define SERIAL_NO_DATA 0xff
 
+// Input channels. Every one has its own RX buffer, lines from different channels are
+// never mixed and the replies go back only to the channel the line came from.
+#define SERIAL_CHANNEL_USB 0   // The host, DT alias grbluart.
+#define SERIAL_CHANNEL_DEBUG 1 // Optional second UART, DT alias grbldebuguart.
+#define SERIAL_CHANNEL_SD 2    // SD card jobs.
+#define SERIAL_CHANNEL_UI 3    // The display and its buttons.
+#define N_SERIAL_CHANNEL 4
+#define SERIAL_CHANNEL_ALL 0xff // Output which is not a reply. Goes to every sink.
+
 
 void serial_init();
 
 // Writes one byte to the TX serial buffer. Called by main program.
 void serial_write(uint8_t data);
 
-// Fetches the first byte in the serial read buffer. Called by main program.
+// Writes len bytes to the TX serial buffer. Output is flushed once per line.
+void serial_write_span(const uint8_t *data, uint32_t len);
+
+// Sends out a partial line (one without a line feed) right away.
+void serial_flush();
+
+// Fetches the first byte in the serial read buffer. Called by main program. Whole lines
+// are taken from one channel at a time.
 uint8_t serial_read();
 
-// Reset and empty data in read buffer. Used by e-stop and reset.
+// The channel the last byte returned by serial_read() came from.
+uint8_t serial_get_read_channel();
+
+// Sends the output to the sinks of one channel only (replies to its line) or, with
+// SERIAL_CHANNEL_ALL, to every sink.
+void serial_reply_to(uint8_t channel);
+uint8_t serial_get_reply_channel();
+
+// Reset and empty data in read buffers of all the channels. Used by e-stop and reset.
 void serial_reset_read_buffer();
 
-// Returns the number of bytes available in the RX serial buffer.
+// Returns the number of bytes available in the RX serial buffer. The one of the channel
+// being replied to, the host's otherwise. The same goes for the two below.
 uint32_t serial_get_rx_buffer_available();
 
+// Returns the number of bytes dropped because the RX serial buffer was full.
+uint32_t serial_get_rx_overrun_count();
+
+// The same for the given channel, whichever is being replied to.
+uint32_t serial_get_channel_overrun_count(uint8_t channel);
+
 // Returns the number of bytes used in the RX serial buffer.
 // NOTE: Deprecated. Not used unless classic status reports are enabled in config.h.
 uint32_t serial_get_rx_buffer_count();
@@ -61,16 +100,36 @@ uint32_t serial_get_rx_buffer_count();
 // NOTE: Not used except for debugging and ensuring no TX bottlenecks.
 // uint32_t serial_get_tx_buffer_count();
 
-void serial_reset_transmit_buffer ();
-uint32_t serial_buffer_append (const char *str);
-uint32_t serial_buffer_appendln (const char *str);
+// Receives the GRBL output. `data` is a whole line (`eol` set) or a part of a
+// line longer than TX_LINE_BUFFER_SIZE. Valid only during the call. `channel` selects
+// which replies the sink gets (SERIAL_CHANNEL_ALL for all of them).
+struct serial_sink {
+  sys_snode_t node;
+  void (*write)(const uint8_t *data, uint32_t len, bool eol, void *user_data);
+  void *user_data;
+  uint8_t channel;
+};
+
+// Subscribes the sink to everything GRBL prints. The UART is one of them.
+void serial_sink_register(struct serial_sink *sink);
+
+// Appends whole lines to the RX buffer of a channel as if they had been received. All or
+// nothing, returns 0 if there is no room. For the channels fed by threads (SD, UI).
+uint32_t serial_channel_write (uint8_t channel, const char *str);
+uint32_t serial_channel_available (uint8_t channel);
 
-void serial_disable_irqs ();
-void serial_enable_irqs ();
-int serial_get_tx_line (uint32_t *buffer, uint8_t bufSize);
 bool serial_is_initialized ();
 bool serial_check_real_time_command(char data) ;
 
+// Picks off real-time command characters (and binary stream frames, if `binary` is set)
+// from data received in place. These are executed right away and squeezed out, the rest
+// stays at the front of the buffer. Returns the number of bytes left, and adds the number
+// of line ends among them to `eol`. Usually nothing is squeezed out nor moved. In serial_rx.c.
+uint32_t serial_rx_filter(uint8_t *data, uint32_t len, bool binary, uint32_t *eol);
+
+// The number of line ends ('\n' and '\r') in data.
+uint32_t serial_count_eol(const uint8_t *data, uint32_t len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,115 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#include "grbl.h"
+
+/*
+ * The part of the receive path which needs no hardware: real-time commands and
+ * binary frames picked off the received bytes, line ends counted. Apart from
+ * serial.c so the host tests can run it (test/host/serialRxCheck.c).
+ */
+
+/*
+ * Word-at-a-time test for bytes which need attention in the ISR: the 4 ASCII
+ * real-time commands and everything above 0x7F (extended real-time commands,
+ * binary stream frame delimiters). HAS_ZERO_BYTE may report a false positive
+ * only next to a true one, so it's exact for telling if a word is clean.
+ */
+#define ONES 0x01010101U
+#define HIGHS 0x80808080U
+#define HAS_ZERO_BYTE(v) (((v) - ONES) & ~(v) & HIGHS)
+#define HAS_BYTE(v, b) HAS_ZERO_BYTE((v) ^ (ONES * (uint8_t)(b)))
+
+static inline bool serial_word_needs_attention(uint32_t word) {
+  return (word & HIGHS) || HAS_BYTE(word, CMD_RESET) ||
+         HAS_BYTE(word, CMD_STATUS_REPORT) || HAS_BYTE(word, CMD_CYCLE_START) ||
+         HAS_BYTE(word, CMD_FEED_HOLD);
+}
+
+static inline bool serial_byte_needs_attention(uint8_t data) {
+  return data > 0x7F || data == CMD_RESET || data == CMD_STATUS_REPORT ||
+         data == CMD_CYCLE_START || data == CMD_FEED_HOLD;
+}
+
+// Returns the length of the run of plain g-code bytes at the start of data.
+static uint32_t serial_plain_run(const uint8_t *data, uint32_t len,
+                                 bool binary) {
+#ifdef ENABLE_BINARY_STREAM
+  if (binary && bstream_is_receiving()) {
+    return 0; // Every byte of a frame goes to the decoder.
+  }
+#endif
+
+  uint32_t i = 0;
+
+  for (; i + sizeof(uint32_t) <= len; i += sizeof(uint32_t)) {
+    uint32_t word;
+    memcpy(&word, data + i, sizeof(word)); // Unaligned load.
+
+    if (serial_word_needs_attention(word)) {
+      break;
+    }
+  }
+
+  while (i < len && !serial_byte_needs_attention(data[i])) {
+    ++i;
+  }
+
+  return i;
+}
+
+uint32_t serial_count_eol(const uint8_t *data, uint32_t len) {
+  const uint8_t *end = data + len;
+  uint32_t count = 0;
+
+  for (const uint8_t *p = data; (p = memchr(p, '\n', end - p)) != NULL; ++p) {
+    ++count;
+  }
+
+  for (const uint8_t *p = data; (p = memchr(p, '\r', end - p)) != NULL; ++p) {
+    ++count;
+  }
+
+  return count;
+}
+
+uint32_t serial_rx_filter(uint8_t *data, uint32_t len, bool binary,
+                          uint32_t *eol) {
+  uint32_t kept = 0;
+  uint32_t i = 0;
+
+  while (i < len) {
+    uint32_t run = serial_plain_run(data + i, len - i, binary);
+
+    if (run > 0) {
+      if (kept != i) {
+        memmove(data + kept, data + i, run);
+      }
+
+      *eol += serial_count_eol(data + kept, run);
+      kept += run;
+      i += run;
+      continue;
+    }
+
+    uint8_t c = data[i++];
+
+#ifdef ENABLE_BINARY_STREAM
+    if (binary && bstream_receive(c)) {
+      continue; // Part of a binary stream frame.
+    }
+#endif
+
+    if (!serial_check_real_time_command(c)) {
+      data[kept++] = c;
+      *eol += (c == '\n' || c == '\r');
+    }
+  }
+
+  return kept;
+}
@@ -20,44 +20,65 @@
 */
 
 #include "grbl.h"
+#include <zephyr/fs/nvs.h>
+#include <stddef.h>
 
 settings_t settings;
 
-const settings_t defaults = {
-    .pulse_microseconds = DEFAULT_STEP_PULSE_MICROSECONDS,
-    .stepper_idle_lock_time = DEFAULT_STEPPER_IDLE_LOCK_TIME,
-    .step_invert_mask = DEFAULT_STEPPING_INVERT_MASK,
-    .dir_invert_mask = DEFAULT_DIRECTION_INVERT_MASK,
-    .status_report_mask = DEFAULT_STATUS_REPORT_MASK,
-    .junction_deviation = DEFAULT_JUNCTION_DEVIATION,
-    .arc_tolerance = DEFAULT_ARC_TOLERANCE,
-    .rpm_max = DEFAULT_SPINDLE_RPM_MAX,
-    .rpm_min = DEFAULT_SPINDLE_RPM_MIN,
-    .homing_dir_mask = DEFAULT_HOMING_DIR_MASK,
-    .homing_feed_rate = DEFAULT_HOMING_FEED_RATE,
-    .homing_seek_rate = DEFAULT_HOMING_SEEK_RATE,
-    .homing_debounce_delay = DEFAULT_HOMING_DEBOUNCE_DELAY,
-    .homing_pulloff = DEFAULT_HOMING_PULLOFF,
-    .flags = (DEFAULT_REPORT_INCHES << BIT_REPORT_INCHES) | \
-             (DEFAULT_LASER_MODE << BIT_LASER_MODE) | \
-             (DEFAULT_INVERT_ST_ENABLE << BIT_INVERT_ST_ENABLE) | \
-             (DEFAULT_HARD_LIMIT_ENABLE << BIT_HARD_LIMIT_ENABLE) | \
-             (DEFAULT_HOMING_ENABLE << BIT_HOMING_ENABLE) | \
-             (DEFAULT_SOFT_LIMIT_ENABLE << BIT_SOFT_LIMIT_ENABLE) | \
-             (DEFAULT_INVERT_LIMIT_PINS << BIT_INVERT_LIMIT_PINS) | \
-             (DEFAULT_INVERT_PROBE_PIN << BIT_INVERT_PROBE_PIN),
-    .steps_per_mm[X_AXIS] = DEFAULT_X_STEPS_PER_MM,
-    .steps_per_mm[Y_AXIS] = DEFAULT_Y_STEPS_PER_MM,
-    .steps_per_mm[Z_AXIS] = DEFAULT_Z_STEPS_PER_MM,
-    .max_rate[X_AXIS] = DEFAULT_X_MAX_RATE,
-    .max_rate[Y_AXIS] = DEFAULT_Y_MAX_RATE,
-    .max_rate[Z_AXIS] = DEFAULT_Z_MAX_RATE,
-    .acceleration[X_AXIS] = DEFAULT_X_ACCELERATION,
-    .acceleration[Y_AXIS] = DEFAULT_Y_ACCELERATION,
-    .acceleration[Z_AXIS] = DEFAULT_Z_ACCELERATION,
-    .max_travel[X_AXIS] = (-DEFAULT_X_MAX_TRAVEL),
-    .max_travel[Y_AXIS] = (-DEFAULT_Y_MAX_TRAVEL),
-    .max_travel[Z_AXIS] = (-DEFAULT_Z_MAX_TRAVEL)};
+/*
+  The global settings are stored in the NVS as they are in RAM, a settings_t, so booting is
+  two reads: the layout record, and if the layout is the one of this firmware, the values
+  straight into `settings`. The layout lists every key of SETTINGS_TABLE with its place in
+  settings_t. When it differs (a firmware with new, moved or removed settings), every setting
+  both layouts have is copied by key from the stored values and the rest get their defaults.
+
+  The values alternate between two NVS IDs when the layout changes: the new values are written
+  under the other ID first and the layout record pointing at them after, so a power loss in
+  between leaves the old layout with the old values. Otherwise the values are rewritten in place,
+  one NVS write (atomic) per change, deferred like the EEPROM ones (settings_flush).
+*/
+
+#define SETTING_KEY(n, field, mask, value) { n, offsetof(settings_t, field), sizeof(((settings_t *)0)->field), mask },
+#define SETTING_DEFAULT(n, field, mask, value) (value),
+
+static const setting_key_t setting_keys[] = { SETTINGS_TABLE(SETTING_KEY) };
+static const float setting_defaults[] = { SETTINGS_TABLE(SETTING_DEFAULT) };
+#define SETTINGS_KEY_COUNT (sizeof(setting_keys)/sizeof(setting_keys[0]))
+
+_Static_assert(SETTINGS_KEY_COUNT <= SETTINGS_MAX_KEYS, "Too many settings");
+_Static_assert(sizeof(settings_t) <= UINT8_MAX, "settings_t size doesn't fit the layout");
+
+static bool settings_changed;  // Since stored.
+static bool layout_stored;     // The NVS has the layout of this firmware.
+static uint8_t values_slot;    // The values are under SETTINGS_NVS_VALUES+values_slot.
+static settings_layout_t stored_layout; // Static, it's big.
+
+
+static void setting_put(const setting_key_t *key, uint8_t *image, float value)
+{
+  uint8_t *field = image+key->offset;
+  if (key->mask) {
+    if (value != 0) { *field |= key->mask; } else { *field &= ~key->mask; }
+  } else if (key->size == sizeof(uint8_t)) {
+    *field = value;
+  } else if (key->size == sizeof(uint16_t)) {
+    uint16_t v = value; memcpy(field, &v, sizeof(v));
+  } else {
+    memcpy(field, &value, sizeof(value));
+  }
+}
+
+
+// All the settings from the table.
+static void settings_default()
+{
+  uint8_t idx;
+  memset(&settings, 0, sizeof(settings)); // Padding too, the estimator hashes settings_t.
+  for (idx = 0; idx < SETTINGS_KEY_COUNT; idx++) {
+    setting_put(&setting_keys[idx], (uint8_t*)&settings, setting_defaults[idx]);
+  }
+}
+
 
 
 // Method to store startup lines into EEPROM
@@ -93,17 +114,17 @@ void settings_write_coord_data(uint8_t coord_select, float *coord_data)
 
 // Method to store Grbl global settings struct and version number into EEPROM
 // NOTE: This function can only be called in IDLE state.
+// NOTE: The values are in effect now, they are stored by settings_flush.
 void write_global_settings()
 {
-  eeprom_put_char(0, SETTINGS_VERSION);
-  memcpy_to_eeprom_with_checksum(EEPROM_ADDR_GLOBAL, (char*)&settings, sizeof(settings_t));
+  settings_changed = true;
 }
 
 
 // Method to restore EEPROM-saved Grbl global settings back to defaults.
 void settings_restore(uint8_t restore_flag) {
   if (restore_flag & SETTINGS_RESTORE_DEFAULTS) {    
-    settings = defaults;
+    settings_default();
     write_global_settings();
   }
 
@@ -173,22 +194,123 @@ uint8_t settings_read_coord_data(uint8_t coord_select, float *coord_data)
 }
 
 
-// Reads Grbl global settings struct from EEPROM.
-uint8_t read_global_settings() {
-  // Check version-byte of eeprom
-  uint8_t version = eeprom_get_char(0);
-  if (version == SETTINGS_VERSION) {
-    // Read settings-record and check checksum
-    if (!(memcpy_from_eeprom_with_checksum((char*)&settings, EEPROM_ADDR_GLOBAL, sizeof(settings_t)))) {
-      return(false);
+static bool settings_layout_valid(const settings_layout_t *layout, ssize_t len)
+{
+  uint8_t idx;
+  if (len < (ssize_t)offsetof(settings_layout_t, keys) || layout->version != SETTINGS_LAYOUT_VERSION) { return(false); }
+  if (layout->count > SETTINGS_MAX_KEYS || len != (ssize_t)(offsetof(settings_layout_t, keys)+layout->count*sizeof(setting_key_t))) { return(false); }
+  for (idx = 0; idx < layout->count; idx++) {
+    if (layout->keys[idx].offset+layout->keys[idx].size > layout->size) { return(false); }
+  }
+  return(true);
+}
+
+
+static bool settings_layout_current(const settings_layout_t *layout)
+{
+  return(layout->size == sizeof(settings_t) && layout->count == SETTINGS_KEY_COUNT &&
+         memcmp(layout->keys, setting_keys, sizeof(setting_keys)) == 0);
+}
+
+
+// The values stored with another layout: the settings both have are copied by key, the rest
+// are defaults. Stored with the new layout by the next flush.
+static uint8_t settings_migrate(struct nvs_fs *fs, const settings_layout_t *layout)
+{
+  static uint8_t image[UINT8_MAX];
+  uint8_t idx, old;
+  if (nvs_read(fs, SETTINGS_NVS_VALUES+values_slot, image, sizeof(image)) != layout->size) { return(false); }
+  settings_default();
+  for (old = 0; old < layout->count; old++) {
+    const setting_key_t *from = &layout->keys[old];
+    for (idx = 0; idx < SETTINGS_KEY_COUNT; idx++) {
+      const setting_key_t *to = &setting_keys[idx];
+      if (to->key != from->key || to->size != from->size || (to->mask == 0) != (from->mask == 0)) { continue; }
+      if (to->mask) {
+        setting_put(to, (uint8_t*)&settings, image[from->offset] & from->mask);
+      } else {
+        memcpy((uint8_t*)&settings+to->offset, image+from->offset, to->size);
+      }
     }
-  } else {
-    return(false);
   }
+  settings_changed = true;
+  return(true);
+}
+
+
+// The settings were kept in the emulated EEPROM before, in the same settings_t.
+static uint8_t settings_import_eeprom()
+{
+  if (eeprom_get_char(0) != SETTINGS_VERSION) { return(false); }
+  if (!(memcpy_from_eeprom_with_checksum((char*)&settings, EEPROM_ADDR_GLOBAL, sizeof(settings_t)))) { return(false); }
+  settings_changed = true;
+  return(true);
+}
+
+
+static bool settings_store(struct nvs_fs *fs)
+{
+  if (layout_stored) {
+    return(nvs_write(fs, SETTINGS_NVS_VALUES+values_slot, &settings, sizeof(settings_t)) >= 0);
+  }
+  // A new layout. The values go under the other ID, then the layout pointing at them commits both.
+  uint8_t slot = values_slot ^ 1;
+  stored_layout.version = SETTINGS_LAYOUT_VERSION;
+  stored_layout.values = slot;
+  stored_layout.count = SETTINGS_KEY_COUNT;
+  stored_layout.size = sizeof(settings_t);
+  memcpy(stored_layout.keys, setting_keys, sizeof(setting_keys));
+  if (nvs_write(fs, SETTINGS_NVS_VALUES+slot, &settings, sizeof(settings_t)) < 0) { return(false); }
+  if (nvs_write(fs, SETTINGS_NVS_LAYOUT, &stored_layout, offsetof(settings_layout_t, keys)+sizeof(setting_keys)) < 0) { return(false); }
+  nvs_delete(fs, SETTINGS_NVS_VALUES+values_slot);
+  values_slot = slot;
+  layout_stored = true;
   return(true);
 }
 
 
+// Writing the flash stops the CPU, the code runs from it: for tens of microseconds per record, for
+// hundreds of milliseconds when NVS erases a sector. The stepper interrupt would miss its
+// deadlines, so the records changed during a motion (G10, G28.1, G30.1, a startup line) wait
+// until the steppers have stopped and nothing is planned.
+void settings_flush()
+{
+  if (!((sys.state == STATE_IDLE) || (sys.state & (STATE_ALARM | STATE_CHECK_MODE | STATE_SLEEP)))) { return; }
+  if (plan_get_current_block() || mc_has_queued_motions() || estimator_active()) { return; }
+  if (settings_changed && eeprom_nvs() != NULL) {
+    eeprom_nvs_lock(); // The SD job journal writes to the same NVS.
+    settings_changed = !settings_store(eeprom_nvs());
+    eeprom_nvs_unlock();
+  }
+  eeprom_flush();
+}
+
+
+static uint8_t settings_read_nvs(struct nvs_fs *fs)
+{
+  layout_stored = false;
+  values_slot = 0;
+  ssize_t len = nvs_read(fs, SETTINGS_NVS_LAYOUT, &stored_layout, sizeof(stored_layout));
+  if (!settings_layout_valid(&stored_layout, len)) { return(settings_import_eeprom()); }
+  values_slot = stored_layout.values & 1;
+  if (!settings_layout_current(&stored_layout)) { return(settings_migrate(fs, &stored_layout)); }
+  layout_stored = true;
+  return(nvs_read(fs, SETTINGS_NVS_VALUES+values_slot, &settings, sizeof(settings_t)) == sizeof(settings_t));
+}
+
+
+// Reads Grbl global settings struct from EEPROM.
+// NOTE: From their own NVS records, see the top of this file.
+uint8_t read_global_settings() {
+  struct nvs_fs *fs = eeprom_nvs();
+  if (fs == NULL) { return(false); }
+  eeprom_nvs_lock();
+  uint8_t ok = settings_read_nvs(fs);
+  eeprom_nvs_unlock();
+  return(ok);
+}
+
+
 // A helper method to set settings from command line
 uint8_t settings_store_global_setting(uint8_t parameter, float value) {
   if (value < 0.0) { return(STATUS_NEGATIVE_VALUE); }
@@ -261,6 +383,11 @@ uint8_t settings_store_global_setting(uint8_t parameter, float value) {
         else { settings.flags &= ~BITFLAG_REPORT_INCHES; }
         system_flag_wco_change(); // Make sure WCO is immediately updated.
         break;
+      case 14:
+        if (value > UINT16_MAX) { return(STATUS_GCODE_MAX_VALUE_EXCEEDED); }
+        settings.status_auto_report_ms = trunc(value);
+        report_auto_status_init(); // Takes effect immediately.
+        break;
       case 20:
         if (int_value) {
           if (bit_isfalse(settings.flags, BITFLAG_HOMING_ENABLE)) { return(STATUS_SOFT_LIMIT_ERROR); }
@@ -310,6 +437,7 @@ void settings_init() {
     settings_restore(SETTINGS_RESTORE_ALL); // Force restore all EEPROM data.
     report_grbl_settings();
   }
+  report_auto_status_init();
 }
 
 
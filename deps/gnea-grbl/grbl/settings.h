@@ -30,7 +30,10 @@ extern "C" {
 
 // Version of the EEPROM data. Will be used to migrate existing data from older versions of Grbl
 // when firmware is upgraded. Always stored in byte 0 of eeprom
-#define SETTINGS_VERSION 10  // NOTE: Check settings_reset() when moving to next version.
+// NOTE: The global settings have their own NVS records now (SETTINGS_TABLE below), which carry
+// their layout and migrate by key. This only identifies the ones stored in the emulated EEPROM
+// before, which are taken over once.
+#define SETTINGS_VERSION 11  // NOTE: Check settings_reset() when moving to next version.
 
 // Define bit flag masks for the boolean settings in settings.flag.
 #define BIT_REPORT_INCHES      0
@@ -54,6 +57,7 @@ extern "C" {
 // Define status reporting boolean enable bit flags in settings.status_report_mask
 #define BITFLAG_RT_STATUS_POSITION_TYPE     bit(0)
 #define BITFLAG_RT_STATUS_BUFFER_STATE      bit(1)
+#define BITFLAG_RT_STATUS_RX_CREDITS        bit(2)
 
 // Define settings restore bitflags.
 #define SETTINGS_RESTORE_DEFAULTS bit(0)
@@ -113,9 +117,80 @@ typedef struct {
   float homing_seek_rate;
   uint16_t homing_debounce_delay;
   float homing_pulloff;
+
+  uint16_t status_auto_report_ms; // Status report push interval. Zero disables.
 } settings_t;
 extern settings_t settings;
 
+#ifndef DEFAULT_STATUS_AUTO_REPORT_INTERVAL
+  #define DEFAULT_STATUS_AUTO_REPORT_INTERVAL 0 // msec (0-65535, 0 disables)
+#endif
+
+// Every global setting, keyed by its `$n` number: X(key, field of settings_t, mask, default). The
+// mask picks a bit of settings.flags, 0 means the whole field (uint8_t, uint16_t or float). The
+// defaults are the values as kept in settings_t: acceleration in mm/min^2, max travel negative.
+// NOTE: Keys are never reused. A field may move, change or go away, the stored settings migrate.
+#define SETTINGS_TABLE(X) \
+  X(0,   pulse_microseconds,         0,                          DEFAULT_STEP_PULSE_MICROSECONDS) \
+  X(1,   stepper_idle_lock_time,     0,                          DEFAULT_STEPPER_IDLE_LOCK_TIME) \
+  X(2,   step_invert_mask,           0,                          DEFAULT_STEPPING_INVERT_MASK) \
+  X(3,   dir_invert_mask,            0,                          DEFAULT_DIRECTION_INVERT_MASK) \
+  X(4,   flags,                      BITFLAG_INVERT_ST_ENABLE,   DEFAULT_INVERT_ST_ENABLE) \
+  X(5,   flags,                      BITFLAG_INVERT_LIMIT_PINS,  DEFAULT_INVERT_LIMIT_PINS) \
+  X(6,   flags,                      BITFLAG_INVERT_PROBE_PIN,   DEFAULT_INVERT_PROBE_PIN) \
+  X(10,  status_report_mask,         0,                          DEFAULT_STATUS_REPORT_MASK) \
+  X(11,  junction_deviation,         0,                          DEFAULT_JUNCTION_DEVIATION) \
+  X(12,  arc_tolerance,              0,                          DEFAULT_ARC_TOLERANCE) \
+  X(13,  flags,                      BITFLAG_REPORT_INCHES,      DEFAULT_REPORT_INCHES) \
+  X(14,  status_auto_report_ms,      0,                          DEFAULT_STATUS_AUTO_REPORT_INTERVAL) \
+  X(20,  flags,                      BITFLAG_SOFT_LIMIT_ENABLE,  DEFAULT_SOFT_LIMIT_ENABLE) \
+  X(21,  flags,                      BITFLAG_HARD_LIMIT_ENABLE,  DEFAULT_HARD_LIMIT_ENABLE) \
+  X(22,  flags,                      BITFLAG_HOMING_ENABLE,      DEFAULT_HOMING_ENABLE) \
+  X(23,  homing_dir_mask,            0,                          DEFAULT_HOMING_DIR_MASK) \
+  X(24,  homing_feed_rate,           0,                          DEFAULT_HOMING_FEED_RATE) \
+  X(25,  homing_seek_rate,           0,                          DEFAULT_HOMING_SEEK_RATE) \
+  X(26,  homing_debounce_delay,      0,                          DEFAULT_HOMING_DEBOUNCE_DELAY) \
+  X(27,  homing_pulloff,             0,                          DEFAULT_HOMING_PULLOFF) \
+  X(30,  rpm_max,                    0,                          DEFAULT_SPINDLE_RPM_MAX) \
+  X(31,  rpm_min,                    0,                          DEFAULT_SPINDLE_RPM_MIN) \
+  X(32,  flags,                      BITFLAG_LASER_MODE,         DEFAULT_LASER_MODE) \
+  X(100, steps_per_mm[X_AXIS],       0,                          DEFAULT_X_STEPS_PER_MM) \
+  X(101, steps_per_mm[Y_AXIS],       0,                          DEFAULT_Y_STEPS_PER_MM) \
+  X(102, steps_per_mm[Z_AXIS],       0,                          DEFAULT_Z_STEPS_PER_MM) \
+  X(110, max_rate[X_AXIS],           0,                          DEFAULT_X_MAX_RATE) \
+  X(111, max_rate[Y_AXIS],           0,                          DEFAULT_Y_MAX_RATE) \
+  X(112, max_rate[Z_AXIS],           0,                          DEFAULT_Z_MAX_RATE) \
+  X(120, acceleration[X_AXIS],       0,                          DEFAULT_X_ACCELERATION) \
+  X(121, acceleration[Y_AXIS],       0,                          DEFAULT_Y_ACCELERATION) \
+  X(122, acceleration[Z_AXIS],       0,                          DEFAULT_Z_ACCELERATION) \
+  X(130, max_travel[X_AXIS],         0,                          (-DEFAULT_X_MAX_TRAVEL)) \
+  X(131, max_travel[Y_AXIS],         0,                          (-DEFAULT_Y_MAX_TRAVEL)) \
+  X(132, max_travel[Z_AXIS],         0,                          (-DEFAULT_Z_MAX_TRAVEL))
+
+// Where a setting is in settings_t. The layout the settings were stored with is stored along.
+typedef struct {
+  uint8_t key;    // $n
+  uint8_t offset; // In settings_t.
+  uint8_t size;   // Of the field: 1, 2 (integers) or 4 (a float).
+  uint8_t mask;   // Of a flag, 0 for the whole field.
+} setting_key_t;
+
+#define SETTINGS_MAX_KEYS 64
+
+// NVS record of the layout. The values are a settings_t, stored as it is, under
+// SETTINGS_NVS_VALUES+values (see settings.c).
+typedef struct {
+  uint8_t version; // SETTINGS_LAYOUT_VERSION
+  uint8_t values;  // 0 or 1.
+  uint8_t count;   // Keys, only that many are stored.
+  uint8_t size;    // sizeof(settings_t)
+  setting_key_t keys[SETTINGS_MAX_KEYS];
+} settings_layout_t;
+
+#define SETTINGS_LAYOUT_VERSION 1
+#define SETTINGS_NVS_LAYOUT 0x20 // NVS IDs, see eeprom.h.
+#define SETTINGS_NVS_VALUES 0x21 // And 0x22.
+
 // Initialize the configuration subsystem (load settings from EEPROM)
 void settings_init();
 
@@ -143,6 +218,10 @@ void settings_write_coord_data(uint8_t coord_select, float *coord_data);
 // Reads selected coordinate data from EEPROM
 uint8_t settings_read_coord_data(uint8_t coord_select, float *coord_data);
 
+// Writes what was stored since the last time to the flash, if the machine stands still.
+// The values are in effect (and read back) as soon as they're stored, this only persists them.
+void settings_flush();
+
 // Returns the step pin mask according to Grbl's internal axis numbering
 uint8_t get_step_pin_mask(uint8_t i);
 
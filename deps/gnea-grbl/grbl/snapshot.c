@@ -0,0 +1,87 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#include "grbl.h"
+#include <zephyr/sys/atomic.h>
+
+#if SNAPSHOT_N_AXIS != N_AXIS
+  #error "SNAPSHOT_N_AXIS must be equal to N_AXIS"
+#endif
+
+static machine_snapshot_t snapshot;
+static atomic_t snapshot_seq; // Odd while the snapshot is written.
+static uint32_t snapshot_published;
+
+
+void snapshot_publish()
+{
+  uint32_t now = k_uptime_get_32();
+  if ((now - snapshot_published < SNAPSHOT_PERIOD_MS) && (sys.state == snapshot.state)) { return; }
+  snapshot_published = now;
+
+  // Computed first, the readers spin only while the result is copied.
+  int32_t steps[N_AXIS];
+  float position[N_AXIS];
+  uint8_t idx;
+  memcpy(steps, sys_position, sizeof(steps));
+  system_convert_array_steps_to_mpos(position, steps);
+  for (idx=0; idx<N_AXIS; idx++) {
+    position[idx] -= gc_state.coord_system[idx]+gc_state.coord_offset[idx];
+    if (idx == TOOL_LENGTH_OFFSET_AXIS) { position[idx] -= gc_state.tool_length_offset; }
+  }
+  float rate = st_get_realtime_rate();
+
+  atomic_inc(&snapshot_seq);
+  snapshot.time_ms = now;
+  memcpy(snapshot.position, position, sizeof(position));
+  snapshot.rate = rate;
+  snapshot.state = sys.state;
+  snapshot.f_override = sys.f_override;
+  snapshot.r_override = sys.r_override;
+  snapshot.spindle_speed_ovr = sys.spindle_speed_ovr;
+  atomic_inc(&snapshot_seq);
+}
+
+
+// The number of attempts is bounded, so a reader can't livelock whatever the thread priorities
+// are. It doesn't come to that: a write takes microseconds and comes at most every
+// SNAPSHOT_PERIOD_MS (or on a state change). A reader sleeps while the sequence is odd, which
+// lets an interrupted writer finish even if it runs at the reader's priority or below.
+bool snapshot_read(machine_snapshot_t *s)
+{
+  machine_snapshot_t copy;
+  uint8_t attempt;
+  for (attempt=0; attempt<SNAPSHOT_READ_ATTEMPTS; attempt++) {
+    atomic_val_t seq = atomic_get(&snapshot_seq);
+    if (seq & 1) { k_msleep(1); continue; }
+    memcpy(&copy, &snapshot, sizeof(machine_snapshot_t));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE); // The copy is done before the sequence is read again.
+    if (atomic_get(&snapshot_seq) == seq) {
+      memcpy(s, &copy, sizeof(machine_snapshot_t));
+      return(true);
+    }
+  }
+  return(false);
+}
+
+
+const char *snapshot_state_name(uint8_t state)
+{
+  switch (state) {
+    case STATE_IDLE: return("Idle");
+    case STATE_CYCLE: return("Run");
+    case STATE_HOLD: return("Hold");
+    case STATE_JOG: return("Jog");
+    case STATE_HOMING: return("Home");
+    case STATE_ALARM: return("Alarm");
+    case STATE_CHECK_MODE: return("Check");
+    case STATE_SAFETY_DOOR: return("Door");
+    case STATE_SLEEP: return("Sleep");
+  }
+  return("?");
+}
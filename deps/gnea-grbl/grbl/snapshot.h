@@ -0,0 +1,54 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#ifndef snapshot_h
+#define snapshot_h
+#include <stdbool.h>
+#include <stdint.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  The machine state for the other threads of the firmware (the display), so they don't have to
+  ask for `?` and parse the report. The main thread publishes it from protocol_execute_realtime
+  every SNAPSHOT_PERIOD_MS, and at once when the state changes. Guarded by a sequence lock: the
+  writer makes the sequence odd, writes and makes it even again, a reader copies and tries again
+  if the sequence was odd or has changed meanwhile. The writer never waits for the readers.
+*/
+
+// N_AXIS. This header is included from C++, where nuts_bolts.h can't be (see RESUME_N_AXIS).
+#define SNAPSHOT_N_AXIS 3
+
+#define SNAPSHOT_PERIOD_MS 50
+#define SNAPSHOT_READ_ATTEMPTS 8 // Before a reader gives up, see snapshot_read().
+
+typedef struct {
+  uint32_t time_ms;                 // k_uptime_get_32 when published.
+  float position[SNAPSHOT_N_AXIS];  // Work position [mm], $13 doesn't apply.
+  float rate;                       // st_get_realtime_rate() [mm/min]
+  uint8_t state;                    // sys.state
+  uint8_t f_override;               // [%]
+  uint8_t r_override;
+  uint8_t spindle_speed_ovr;
+} machine_snapshot_t;
+
+// Main thread only.
+void snapshot_publish();
+
+// Any thread. Zeroes until the first publish. Returns false and leaves *snapshot alone if
+// every attempt overlapped a write.
+bool snapshot_read(machine_snapshot_t *snapshot);
+
+// "Idle", "Run" and so on, like in the status report.
+const char *snapshot_state_name(uint8_t state);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -181,6 +181,9 @@ typedef struct {
 } st_prep_t;
 static st_prep_t prep;
 
+// CPU cycles spent in the stepper ISR. Free running, wraps around. Read by the telemetry.
+static volatile uint32_t st_isr_cycles;
+
 void TIMER1_COMPA_vect ();
 void setServoPositionSteps (int absoluteSteps);
 
@@ -339,7 +342,7 @@ void st_go_idle()
 // TODO: Replace direct updating of the int32 position counters in the ISR somehow. Perhaps use smaller
 // int8 variables and update position counters only when a segment completes. This can get complicated
 // with probing and homing cycles that require true real-time positions.
-void TIMER1_COMPA_vect ()
+static void st_isr_step()
 {
   if (busy) { return; } // The busy-flag is used to avoid reentering this interrupt
 
@@ -545,6 +548,16 @@ void TIMER1_COMPA_vect ()
 }
 
 
+// The ISR entry. Only adds two cycle counter reads to the step ISR, so the load can be watched
+// (see telemetry.h) without disturbing the step timing.
+void TIMER1_COMPA_vect ()
+{
+  uint32_t start = k_cycle_get_32();
+  st_isr_step();
+  st_isr_cycles += k_cycle_get_32() - start;
+}
+
+
 /* The Stepper Port Reset Interrupt: Timer0 OVF interrupt handles the falling edge of the step
    pulse. This should always trigger before the next Timer1 COMPA interrupt and independently
    finish, if Timer1 is disabled after completing a move.
@@ -1195,6 +1208,19 @@ float st_get_realtime_rate()
   return 0.0f;
 }
 
+
+// Returns the number of step segments prepared and not executed yet (including the executing one).
+uint8_t st_get_segment_buffer_count()
+{
+  uint8_t tail = segment_buffer_tail; // Moved by the ISR.
+  if (segment_buffer_head >= tail) { return(segment_buffer_head-tail); }
+  return(SEGMENT_BUFFER_SIZE - (tail-segment_buffer_head));
+}
+
+
+// Returns the free running count of CPU cycles spent in the stepper ISR.
+uint32_t st_get_isr_cycles() { return(st_isr_cycles); }
+
 /**
  * This sets the Z position of my machine which uses a simple servo for that purpose. GRBL
  * thinks in stepper-motor steps, and so steps has to converted to something understandable
@@ -59,6 +59,12 @@ void st_update_plan_block_parameters();
 // Called by realtime status reporting if realtime rate reporting is enabled in config.h.
 float st_get_realtime_rate();
 
+// Returns the number of step segments waiting in the segment buffer.
+uint8_t st_get_segment_buffer_count();
+
+// Returns the free running count of CPU cycles spent in the stepper ISR. Wraps around.
+uint32_t st_get_isr_cycles();
+
 #ifdef __cplusplus
 }
 #endif
@@ -239,6 +239,18 @@ uint8_t system_execute_line(char *line)
           report_feedback_message(MESSAGE_RESTORE_DEFAULTS);
           mc_reset(); // Force reset to ensure settings are initialized correctly.
           break;
+        case 'E' : // Estimate the time and the bounds of a job file [IDLE]
+          if ((line[2] != '=') || (line[3] == 0)) { return(STATUS_INVALID_STATEMENT); }
+          if (sys.state != STATE_IDLE) { return(STATUS_IDLE_ERROR); }
+          {
+            estimate_t estimate;
+            helper_var = estimator_run_file(&line[3], &estimate);
+            // Up to the failed line, if any. Nothing if it didn't start or was reset.
+            if ((helper_var != STATUS_FILE_READ) && (helper_var != STATUS_IDLE_ERROR) && (helper_var != STATUS_ESTIMATE_ABORTED)) {
+              report_estimate(&estimate);
+            }
+            return(helper_var);
+          }
         case 'N' : // Startup lines. [IDLE/ALARM]
           if ( line[++char_counter] == 0 ) { // Print startup lines
             for (helper_var=0; helper_var < N_STARTUP_LINE; helper_var++) {
@@ -0,0 +1,179 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#include "grbl.h"
+#include <zephyr/drivers/uart.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/ring_buffer.h>
+
+LOG_MODULE_REGISTER(telemetry);
+
+#if DT_NODE_EXISTS(DT_ALIAS(grbltelemetryuart))
+
+BUILD_ASSERT(sizeof(telemetry_record_t) == 20 + 4 * N_AXIS, "Unexpected padding");
+BUILD_ASSERT((TELEMETRY_QUEUE_SIZE & (TELEMETRY_QUEUE_SIZE - 1)) == 0, "Not a power of 2");
+BUILD_ASSERT(!DT_SAME_NODE(DT_ALIAS(grbltelemetryuart), DT_ALIAS(grbluart)), "Port taken by GRBL");
+#if DT_NODE_EXISTS(DT_ALIAS(grbldebuguart))
+  BUILD_ASSERT(!DT_SAME_NODE(DT_ALIAS(grbltelemetryuart), DT_ALIAS(grbldebuguart)), "Port taken by GRBL");
+#endif
+
+#define TELEMETRY_SEND_PERIOD_MS 10 // The sender thread wakes up this often.
+#define TELEMETRY_TX_BUFFER_SIZE 1024
+#define TELEMETRY_STACK_SIZE 1024
+#define TELEMETRY_PRIORITY 14 // Below the GRBL main thread.
+
+// What the timer takes. Raw, the sender thread does the math.
+typedef struct {
+  uint32_t cycles;
+  uint32_t isr_cycles;
+  int32_t position[N_AXIS];
+  float rate;
+  uint8_t state;
+  uint8_t planner_blocks;
+  uint8_t segments;
+} telemetry_sample_t;
+
+// Single producer (the timer) single consumer (the sender thread) ring. Head and tail are
+// free running, only the producer moves the head and only the consumer moves the tail.
+static telemetry_sample_t samples[TELEMETRY_QUEUE_SIZE];
+static atomic_t sample_head;
+static atomic_t sample_tail;
+static atomic_t samples_dropped; // Queue was full.
+
+static const struct device *const telemetry_uart = DEVICE_DT_GET(DT_ALIAS(grbltelemetryuart));
+RING_BUF_DECLARE(telemetryTxRingBuf, TELEMETRY_TX_BUFFER_SIZE);
+
+
+// Runs in the system clock ISR. Only copies, the stepper ISR is never blocked.
+static void telemetry_timer_expiry(struct k_timer *timer)
+{
+  ARG_UNUSED(timer);
+  atomic_val_t head = atomic_get(&sample_head);
+
+  if ((head - atomic_get(&sample_tail)) >= TELEMETRY_QUEUE_SIZE) {
+    atomic_inc(&samples_dropped);
+    return;
+  }
+
+  telemetry_sample_t *sample = &samples[head & (TELEMETRY_QUEUE_SIZE - 1)];
+  sample->cycles = k_cycle_get_32();
+  sample->isr_cycles = st_get_isr_cycles();
+  memcpy(sample->position, (const void *)sys_position, sizeof(sample->position)); // Per axis consistent only.
+  sample->rate = st_get_realtime_rate();
+  sample->state = sys.state;
+  sample->planner_blocks = plan_get_block_buffer_count();
+  sample->segments = st_get_segment_buffer_count();
+  atomic_set(&sample_head, head + 1); // Publish.
+}
+
+K_TIMER_DEFINE(telemetry_timer, telemetry_timer_expiry, NULL);
+
+
+static void telemetry_uart_isr(const struct device *dev, void *user_data)
+{
+  ARG_UNUSED(user_data);
+
+  while (uart_irq_update(dev) && uart_irq_is_pending(dev)) {
+    if (!uart_irq_tx_ready(dev)) { continue; }
+
+    uint8_t *data;
+    uint32_t len = ring_buf_get_claim(&telemetryTxRingBuf, &data, TELEMETRY_TX_BUFFER_SIZE);
+    if (len == 0) {
+      uart_irq_tx_disable(dev);
+      continue;
+    }
+
+    int sent = uart_fifo_fill(dev, data, len);
+    ring_buf_get_finish(&telemetryTxRingBuf, (sent > 0) ? sent : 0);
+  }
+}
+
+
+static void telemetry_thread(void *p1, void *p2, void *p3)
+{
+  ARG_UNUSED(p1);
+  ARG_UNUSED(p2);
+  ARG_UNUSED(p3);
+
+  uint8_t seq = 0;
+  uint32_t dropped = 0;
+  uint64_t time_cycles = 0;
+  uint32_t last_cycles = 0;
+  uint32_t last_isr_cycles = 0;
+  bool first = true;
+
+  while (true) {
+    k_msleep(TELEMETRY_SEND_PERIOD_MS);
+
+    atomic_val_t tail = atomic_get(&sample_tail);
+    while (tail != atomic_get(&sample_head)) {
+      telemetry_sample_t sample = samples[tail & (TELEMETRY_QUEUE_SIZE - 1)];
+      atomic_set(&sample_tail, ++tail); // Copied, the timer may reuse the slot.
+      dropped += atomic_clear(&samples_dropped);
+
+      uint32_t elapsed = sample.cycles - last_cycles;
+      uint32_t isr_elapsed = sample.isr_cycles - last_isr_cycles;
+      last_cycles = sample.cycles;
+      last_isr_cycles = sample.isr_cycles;
+      if (first) {
+        elapsed = 0;
+        isr_elapsed = 0;
+        time_cycles = sample.cycles;
+        first = false;
+      }
+      time_cycles += elapsed;
+
+      telemetry_record_t record;
+      record.sync = TELEMETRY_SYNC;
+      record.seq = seq;
+      record.state = sample.state;
+      record.time_us = (uint32_t)k_cyc_to_us_floor64(time_cycles);
+      memcpy(record.position, sample.position, sizeof(record.position));
+      record.rate = sample.rate;
+      record.planner_blocks = sample.planner_blocks;
+      record.segments = sample.segments;
+      record.isr_load = (elapsed == 0) ? 0 : (uint16_t)MIN(((uint64_t)isr_elapsed * 10000) / elapsed, 10000);
+      record.dropped = MIN(dropped, UINT16_MAX);
+      record.crc = crc16_itu_t(0xffff, (const uint8_t *)&record, offsetof(telemetry_record_t, crc));
+
+      if (ring_buf_space_get(&telemetryTxRingBuf) < sizeof(record)) {
+        dropped++; // Port too slow (or nobody listens on the CDC ACM). This one is lost.
+        continue;
+      }
+
+      ring_buf_put(&telemetryTxRingBuf, (const uint8_t *)&record, sizeof(record));
+      seq++;
+      dropped = 0;
+    }
+
+    uart_irq_tx_enable(telemetry_uart);
+  }
+}
+
+K_THREAD_DEFINE(telemetry_tid, TELEMETRY_STACK_SIZE, telemetry_thread, NULL, NULL, NULL, TELEMETRY_PRIORITY, 0,
+                SYS_FOREVER_MS);
+
+
+void telemetry_init()
+{
+  if (!device_is_ready(telemetry_uart)) {
+    LOG_ERR("Problem configuring uart %s", telemetry_uart->name);
+    return;
+  }
+
+  uart_irq_callback_user_data_set(telemetry_uart, telemetry_uart_isr, NULL);
+  k_thread_start(telemetry_tid);
+  k_timer_start(&telemetry_timer, K_USEC(1000000 / TELEMETRY_RATE_HZ), K_USEC(1000000 / TELEMETRY_RATE_HZ));
+}
+
+#else
+
+void telemetry_init() {}
+
+#endif
@@ -0,0 +1,55 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#ifndef telemetry_h
+#define telemetry_h
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Binary telemetry for tuning acceleration and junction deviation. The machine state is
+  sampled TELEMETRY_RATE_HZ times a second by a kernel timer, queued in a lock-free ring and
+  sent by a low priority thread to the port the grbltelemetryuart device tree alias points at
+  (a second CDC ACM interface, or a plain UART other than the console and grbldebuguart). The
+  stream is one-way, there is nothing to enable: it runs as long as the alias exists.
+
+  Records are sent back to back, with no framing besides the sync word. A receiver looks for
+  TELEMETRY_SYNC, checks the CRC (CRC-16/CCITT-FALSE of everything before it, like in
+  binary_stream.h) and resynchronizes byte by byte if it doesn't match. All the fields are
+  little-endian. Gaps in seq mean records were lost on the way (host too slow), `dropped`
+  counts the samples lost before they were sent (port too slow).
+*/
+
+#define TELEMETRY_SYNC 0xA55A
+
+// Samples waiting for the sender thread. Must be a power of 2.
+#define TELEMETRY_QUEUE_SIZE 64
+
+// One record, 32 bytes with N_AXIS == 3.
+typedef struct {
+  uint16_t sync;             // TELEMETRY_SYNC
+  uint8_t seq;               // Increments with every record sent.
+  uint8_t state;             // sys.state
+  uint32_t time_us;          // Sample time, µs since boot. Wraps around.
+  int32_t position[N_AXIS];  // sys_position, machine position in steps.
+  float rate;                // st_get_realtime_rate(), commanded speed in mm/min.
+  uint8_t planner_blocks;    // plan_get_block_buffer_count()
+  uint8_t segments;          // st_get_segment_buffer_count()
+  uint16_t isr_load;         // CPU time spent in the stepper ISR since the last sample, 0.01%.
+  uint16_t dropped;          // Samples dropped since the previous record. Saturates.
+  uint16_t crc;
+} telemetry_record_t;
+
+// Starts the sampling. Does nothing if there is no grbltelemetryuart.
+void telemetry_init();
+
+#ifdef __cplusplus
+}
+#endif
+#endif
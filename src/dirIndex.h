@@ -0,0 +1,102 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace sd {
+
+/**
+ * One file. Date and time are packed the FAT way (FILINFO::fdate and ftime).
+ */
+struct DirEntry {
+        uint32_t size{};
+        uint16_t date{};
+        uint16_t time{};
+        uint16_t name{}; /// Offset into the arena.
+};
+
+/**
+ * Sorted list of the files of a directory. Built once (the directory is walked only then), after
+ * that any entry is reachable in O(1), so the UI can page through hundreds of files without
+ * touching the card. Names are kept NUL terminated one after another in a fixed arena.
+ */
+template <size_t MAX_ENTRIES, size_t ARENA_SIZE> class DirIndex {
+public:
+        static_assert (ARENA_SIZE <= UINT16_MAX + 1);
+
+        void clear ()
+        {
+                count = 0;
+                arenaUsed = 0;
+                full = false;
+        }
+
+        /// False (and the entry is skipped) if there's no room left, see truncated ().
+        bool add (const char *name, uint32_t size, uint16_t date = 0, uint16_t time = 0)
+        {
+                size_t len = strlen (name) + 1;
+
+                if (count == MAX_ENTRIES || arenaUsed + len > ARENA_SIZE) {
+                        full = true;
+                        return false;
+                }
+
+                std::copy_n (name, len, arena.begin () + arenaUsed);
+                entries[count++] = DirEntry{size, date, time, uint16_t (arenaUsed)};
+                arenaUsed += len;
+                return true;
+        }
+
+        /// By name, case insensitive like FAT itself.
+        void sort ()
+        {
+                std::sort (entries.begin (), entries.begin () + count, [this] (DirEntry const &a, DirEntry const &b) {
+                        return lessNoCase (name (a), name (b));
+                });
+        }
+
+        size_t size () const { return count; }
+        bool empty () const { return count == 0; }
+
+        /// Some files didn't fit.
+        bool truncated () const { return full; }
+
+        DirEntry const &operator[] (size_t i) const { return entries[i]; }
+        const char *name (size_t i) const { return name (entries[i]); }
+        const char *name (DirEntry const &e) const { return arena.data () + e.name; }
+
+private:
+        static bool lessNoCase (const char *a, const char *b)
+        {
+                for (; *a != '\0' && *b != '\0'; ++a, ++b) {
+                        char ca = upper (*a);
+                        char cb = upper (*b);
+
+                        if (ca != cb) {
+                                return ca < cb;
+                        }
+                }
+
+                return *a == '\0' && *b != '\0';
+        }
+
+        static char upper (char c) { return (c >= 'a' && c <= 'z') ? char (c - 'a' + 'A') : c; }
+
+        std::array<DirEntry, MAX_ENTRIES> entries{};
+        std::array<char, ARENA_SIZE> arena{};
+        size_t count{};
+        size_t arenaUsed{};
+        bool full{};
+};
+
+} // namespace sd
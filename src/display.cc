@@ -9,14 +9,23 @@
 #include "display.h"
 #include "Machine.h"
 #include "cfb_font_oldschool.h"
+#include "encoder.h"
+#include "grbl/report.h"
+#include "grbl/snapshot.h"
 #include "grblState.h"
+#include "screen.h"
 #include "sdCard.h"
+#include "sdEstimate.h"
+#include "sdJob.h"
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <optional>
 #include <zephyr/device.h>
 #include <zephyr/devicetree.h>
 #include <zephyr/display/cfb.h>
-#include <zephyr/drivers/gpio.h>
 #include <zephyr/init.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
@@ -45,10 +54,8 @@ K_THREAD_DEFINE (disp, 2048, displayThread, NULL, NULL, NULL, 14, 0, 0);
 namespace disp {
 
 namespace {
-        const gpio_dt_spec encoderA = GPIO_DT_SPEC_GET (DT_PATH (ui_buttons, encoder_a), gpios);
-        const gpio_dt_spec encoderB = GPIO_DT_SPEC_GET (DT_PATH (ui_buttons, encoder_b), gpios);
-        const gpio_dt_spec encoderEnter = GPIO_DT_SPEC_GET (DT_PATH (ui_buttons, enter), gpios);
         const struct device *display{};
+        Screen screen;
 } // namespace
 
 void init ()
@@ -72,38 +79,17 @@ void init ()
                 return;
         }
 
-        if (cfb_framebuffer_init (display)) {
-                LOG_ERR ("Framebuffer initialization failed!\n");
+        // The font comes from CFB (cfb_font_oldschool.h), the framebuffer is disp::Screen.
+        if (!screen.init (display)) {
+                LOG_ERR ("Screen initialization failed!\n");
                 return;
         }
 
-        cfb_framebuffer_clear (display, true);
         display_blanking_off (display);
 
-        cfb_framebuffer_set_font (disp::display, 0);
-        cfb_framebuffer_invert (display);
-
         /*--------------------------------------------------------------------------*/
 
-        if (!gpio_is_ready_dt (&encoderA)) {
-                LOG_ERR ("encoderA !ready");
-        }
-
-        if (!gpio_is_ready_dt (&encoderB)) {
-                LOG_ERR ("encoderB !ready");
-        }
-
-        if (!gpio_is_ready_dt (&encoderEnter)) {
-                LOG_ERR ("encoderEnter !ready");
-        }
-
-        int ret = gpio_pin_configure_dt (&encoderA, GPIO_INPUT);
-        ret |= gpio_pin_configure_dt (&encoderB, GPIO_INPUT);
-        ret |= gpio_pin_configure_dt (&encoderEnter, GPIO_INPUT);
-
-        if (ret != 0) {
-                LOG_ERR ("Encoder init failed");
-        }
+        encoderInit ();
 }
 
 } // namespace disp
@@ -115,46 +101,397 @@ namespace {
 
 enum class MenuType { main, jog, sdCard };
 
+/// Redrawn as a whole, the screen sends only what differs (the cursor moving is two glyphs).
 auto menu = [] (MenuType menuType, int selected) {
-        cfb_framebuffer_clear (disp::display, false);
+        using disp::screen;
+        screen.clear ();
         uint16_t margin = 2;
 
         switch (menuType) {
         case MenuType::main:
-                cfb_print (disp::display, "  Print from SD", margin, 0);
-                cfb_print (disp::display, "  Jogging menu", margin, 8);
+                screen.print ("  Print from SD", margin, 0);
+                screen.print ("  Jogging menu", margin, 8);
+                screen.print ("  Resume job", margin, 16);
+                screen.print ("  Dashboard", margin, 24);
+                screen.print ("  Unlock", margin, 32);
                 break;
 
         case MenuType::jog:
-                cfb_print (disp::display, "  Y+", margin, 0);
-                cfb_print (disp::display, "  Y-", margin, 8);
-                cfb_print (disp::display, "  X+", margin, 16);
-                cfb_print (disp::display, "  X-", margin, 24);
-                cfb_print (disp::display, "  Back", margin, 32);
+                screen.print ("  Y+", margin, 0);
+                screen.print ("  Y-", margin, 8);
+                screen.print ("  X+", margin, 16);
+                screen.print ("  X-", margin, 24);
+                screen.print ("  Knob X", margin, 32);
+                screen.print ("  Knob Y", margin, 40);
+                screen.print ("  Back", margin, 48);
                 break;
 
         default:
                 break;
         }
 
-        cfb_print (disp::display, ">", 2, selected * 8);
-        cfb_framebuffer_finalize (disp::display);
+        screen.print (">", 2, selected * 8);
+        screen.flush ();
 };
 
 /**
- * Prints file entries from the SD.
+ * File list. Row 0 is "Back", the files follow. Only the visible page is drawn, straight from
+ * the index, so a scroll step costs the same no matter how many files there are. The actions
+ * only mark the list dirty, it's drawn once after the event is handled. The last line shows the
+ * estimate of the selected file, looked up once the selection stays put for a while (the cached
+ * one, or GRBL is asked for it). It changes by itself, so it's a periodic update of the screen
+ * while the list is shown.
  */
-void sdMenu (int selected)
-{
-        cfb_framebuffer_clear (disp::display, false);
-        uint16_t margin = 2;
-        cfb_print (disp::display, "  Back", margin, 0);
+namespace sdList {
+        constexpr size_t ROWS = 64 / 8 - 1; // Display height / font height, less the estimate line.
+        constexpr size_t COLUMNS = 128 / 7; // Display width / font width.
+        constexpr uint32_t SETTLE_MS = 400;
+        constexpr uint32_t ESTIMATE_TIMEOUT_MS = 30000;
+        constexpr uint32_t POLL_MS = 100;   // For the estimate GRBL is working on.
+        size_t selected{};                  // 0 is "Back".
+        size_t top{};                       // First visible row.
+        bool cardPresent{};
+        bool shown{}; // Not redrawn over the other screens.
+        bool dirty{};
+        bool urgent{}; // The user has moved, sent without waiting.
+
+        enum class Eta { pending, requested, known, none };
+        Eta eta{};
+        uint32_t selectedAt{};
+        estimate_t estimate{};
+        grbl::Future estimateDone; // Of the last request, it may be another file's.
+
+        size_t rows () { return sd::index ().size () + 1; }
+
+        void selectionChanged ()
+        {
+                eta = Eta::pending;
+                selectedAt = k_uptime_get_32 ();
+                dirty = urgent = true;
+        }
 
-        sd::lsdir ("");
+        /// "12m34s 120x80mm", the box is X by Y.
+        void printEstimate (char *buf, size_t size)
+        {
+                if (eta == Eta::requested) {
+                        snprintf (buf, size, "  estimating...");
+                        return;
+                }
 
-        cfb_print (disp::display, ">", 2, selected * 8);
-        cfb_framebuffer_finalize (disp::display);
-}
+                if (eta != Eta::known) {
+                        return;
+                }
+
+                if (estimate.status != 0) {
+                        snprintf (buf, size, "  error %u", estimate.status);
+                        return;
+                }
+
+                auto const s = unsigned (estimate.seconds + 0.5F);
+                auto const w = unsigned (estimate.max[0] - estimate.min[0] + 0.5F);
+                auto const h = unsigned (estimate.max[1] - estimate.min[1] + 0.5F);
+                const char *outside = (estimate.outside != 0) ? "!" : "";
+
+                if (s >= 3600) {
+                        snprintf (buf, size, "  %uh%02um %ux%u%s", s / 3600, s / 60 % 60, w, h, outside);
+                }
+                else {
+                        snprintf (buf, size, "  %um%02us %ux%u%s", s / 60, s % 60, w, h, outside);
+                }
+        }
+
+        void draw ()
+        {
+                using disp::screen;
+                screen.clear ();
+                uint16_t margin = 2;
+                auto const &index = sd::index ();
+
+                for (size_t row = top; row < std::min (top + ROWS, rows ()); ++row) {
+                        std::array<char, COLUMNS + 1> line{};
+                        const char *text = (row == 0) ? "Back" : index.name (row - 1);
+                        snprintf (line.data (), line.size (), "  %s", text);
+                        screen.print (line.data (), margin, (row - top) * 8);
+                }
+
+                if (!cardPresent) {
+                        screen.print ("  (no card)", margin, 8);
+                }
+
+                if (selected != 0) {
+                        std::array<char, COLUMNS + 1> line{};
+                        printEstimate (line.data (), line.size ());
+                        screen.print (line.data (), margin, ROWS * 8);
+                }
+
+                screen.print (">", 2, (selected - top) * 8);
+                screen.flush (urgent ? disp::Screen::Update::now : disp::Screen::Update::periodic);
+                urgent = false;
+        }
+
+        /// Nothing is estimated while a job runs, GRBL would refuse anyway.
+        void updateEstimate ()
+        {
+                uint32_t const now = k_uptime_get_32 ();
+
+                if (selected == 0 || eta == Eta::known || eta == Eta::none || now - selectedAt < SETTLE_MS) {
+                        return;
+                }
+
+                std::array<char, 300> path{};
+
+                if (!sd::indexPath (selected - 1, path.data (), path.size ())) {
+                        eta = Eta::none;
+                        return;
+                }
+
+                if (eta == Eta::pending) {
+                        if (sd::cachedEstimate (path.data (), estimate)) {
+                                eta = Eta::known;
+                        }
+                        else if (sd::jobRunning ()) {
+                                eta = Eta::none;
+                        }
+                        else if (estimateDone.pending ()) { // GRBL is busy with the previous file.
+                                return;
+                        }
+                        else {
+                                eta = grbl::estimate (path.data (), &estimateDone) ? Eta::requested : Eta::none;
+                        }
+                }
+                else if (sd::lastEstimate (path.data (), estimate)) {
+                        eta = Eta::known;
+                }
+                else if (auto r = estimateDone.result (); r && r->status != STATUS_OK) { // Refused, not even started.
+                        eta = Eta::none;
+                }
+                else if (now - selectedAt > ESTIMATE_TIMEOUT_MS) {
+                        eta = Eta::none;
+                }
+                else {
+                        return;
+                }
+
+                dirty = true;
+        }
+
+        /// Until updateEstimate has something to do.
+        uint32_t dueIn ()
+        {
+                uint32_t const since = k_uptime_get_32 () - selectedAt;
+
+                if (!shown || selected == 0 || eta == Eta::known || eta == Eta::none) {
+                        return UINT32_MAX;
+                }
+
+                if (eta == Eta::pending && since < SETTLE_MS) {
+                        return SETTLE_MS - since;
+                }
+
+                if (eta == Eta::pending && !estimateDone.pending ()) {
+                        return 0;
+                }
+
+                return POLL_MS;
+        }
+
+        void redraw ()
+        {
+                if (!shown) {
+                        return;
+                }
+
+                updateEstimate ();
+
+                if (dirty) {
+                        dirty = false;
+                        draw ();
+                }
+        }
+
+        /// From the main menu.
+        void open ()
+        {
+                cardPresent = sd::refreshIndex ();
+                selected = top = 0;
+                shown = true;
+                selectionChanged ();
+        }
+
+        void close () { shown = false; }
+
+        void next ()
+        {
+                selected = (selected + 1 == rows ()) ? 0 : selected + 1;
+
+                if (selected == 0) {
+                        top = 0;
+                }
+                else if (selected >= top + ROWS) {
+                        ++top;
+                }
+
+                selectionChanged ();
+        }
+
+        void prev ()
+        {
+                selected = (selected == 0) ? rows () - 1 : selected - 1;
+
+                if (selected < top) {
+                        top = selected;
+                }
+                else if (selected >= top + ROWS) {
+                        top = selected + 1 - ROWS;
+                }
+
+                selectionChanged ();
+        }
+
+        void start ()
+        {
+                std::array<char, 300> path{};
+
+                if (!sd::indexPath (selected - 1, path.data (), path.size ()) || !sd::startJob (path.data ())) {
+                        LOG_ERR ("Can't start %s", path.data ());
+                }
+        }
+
+} // namespace sdList
+
+/**
+ * The machine and the SD job at a glance. The state, the work position, the feed and the
+ * overrides come from the snapshot GRBL publishes (grbl/snapshot.h), not from the status
+ * report. Redrawn every CONFIG_APP_DISPLAY_REFRESH_MS while shown, the screen sends only the
+ * digits which changed. Turning the knob overrides the feed.
+ */
+namespace dashboard {
+        constexpr size_t COLUMNS = 128 / 7;
+        bool shown{};
+        bool urgent{};
+        uint32_t drawnAt{};
+        machine_snapshot_t machine{}; // The last consistent copy.
+
+        /// "X  -12.345", printf may have no float support.
+        void printAxis (char *buf, size_t size, char axis, float mm)
+        {
+                auto const um = long (lroundf (mm * 1000.0F));
+                unsigned long const abs = std::labs (um);
+                snprintf (buf, size, "%c %s%lu.%03lu", axis, (um < 0) ? "-" : " ", abs / 1000, abs % 1000);
+        }
+
+        void printJob (char *buf, size_t size)
+        {
+                if (!sd::jobRunning ()) {
+                        snprintf (buf, size, "No job");
+                        return;
+                }
+
+                float left{};
+                auto const s = sd::jobStats ();
+                auto const percent = unsigned (sd::jobProgress (s, left) * 100.0F);
+
+                if (left < 0) {
+                        snprintf (buf, size, "Job %3u%%", percent);
+                        return;
+                }
+
+                auto const l = unsigned (left + 0.5F);
+
+                if (l >= 3600) {
+                        snprintf (buf, size, "Job %3u%% %uh%02um", percent, l / 3600, l / 60 % 60);
+                }
+                else {
+                        snprintf (buf, size, "Job %3u%% %um%02us", percent, l / 60, l % 60);
+                }
+        }
+
+        void draw ()
+        {
+                using disp::screen;
+                snapshot_read (&machine); // Shows the previous copy if this one fails.
+                auto const &m = machine;
+                std::array<char, COLUMNS + 1> line{};
+                uint16_t margin = 2;
+                screen.clear ();
+
+                snprintf (line.data (), line.size (), "%-6s F%u", snapshot_state_name (m.state), unsigned (m.rate + 0.5F));
+                screen.print (line.data (), margin, 0);
+
+                for (size_t i = 0; i < SNAPSHOT_N_AXIS; ++i) {
+                        printAxis (line.data (), line.size (), "XYZ"[i], m.position[i]);
+                        screen.print (line.data (), margin, (i + 1) * 8);
+                }
+
+                snprintf (line.data (), line.size (), "F%u%% R%u%% S%u%%", m.f_override, m.r_override, m.spindle_speed_ovr);
+                screen.print (line.data (), margin, 32);
+                printJob (line.data (), line.size ());
+                screen.print (line.data (), margin, 40);
+                screen.print ("  Back", margin, 56);
+                screen.print (">", 2, 56);
+                screen.flush (urgent ? disp::Screen::Update::now : disp::Screen::Update::periodic);
+        }
+
+        void redraw ()
+        {
+                uint32_t const now = k_uptime_get_32 ();
+
+                if (!shown || (!urgent && now - drawnAt < CONFIG_APP_DISPLAY_REFRESH_MS)) {
+                        return;
+                }
+
+                drawnAt = now;
+                draw ();
+                urgent = false;
+        }
+
+        uint32_t dueIn ()
+        {
+                uint32_t const since = k_uptime_get_32 () - drawnAt;
+
+                if (!shown) {
+                        return UINT32_MAX;
+                }
+
+                return (urgent || since >= CONFIG_APP_DISPLAY_REFRESH_MS) ? 0 : CONFIG_APP_DISPLAY_REFRESH_MS - since;
+        }
+
+        void open () { shown = urgent = true; }
+        void close () { shown = false; }
+
+        /// The knob turned while the dashboard is shown: 10% of the feed per click.
+        void feedOverride (int direction)
+        {
+                grbl::realtime ((direction < 0) ? COMMAND_RT_FEED_OVR_COARSE_MINUS : COMMAND_RT_FEED_OVR_COARSE_PLUS);
+        }
+
+} // namespace dashboard
+
+/**
+ * Jogging with the knob: every click moves the axis by STEP_MM, fast turns count more (see
+ * encoder.cc), and the clicks queued meanwhile go out as one jog. The dashboard shows where the
+ * machine is.
+ */
+namespace knob {
+        constexpr float STEP_MM = 0.1F;
+        char axis{};
+        uint16_t steps{}; // Of the input being handled.
+
+        void jog (int direction) { grbl::jogBy (axis, direction * steps * STEP_MM); }
+
+        void open (char a)
+        {
+                axis = a;
+                dashboard::open ();
+        }
+
+        void close ()
+        {
+                axis = 0;
+                dashboard::close ();
+        }
+
+} // namespace knob
 
 /**
  *
@@ -164,6 +501,8 @@ enum class Event { none, left, right, enter };
 constexpr auto enter = [] (Event e) { return e == Event::enter; };
 constexpr auto left = [] (Event e) { return e == Event::left; };
 constexpr auto right = [] (Event e) { return e == Event::right; };
+constexpr auto enterBack = [] (Event e) { return e == Event::enter && sdList::selected == 0; };
+constexpr auto enterFile = [] (Event e) { return e == Event::enter && sdList::selected != 0; };
 
 using namespace ls;
 auto menuMachine = machine (
@@ -173,22 +512,49 @@ auto menuMachine = machine (
 
         state ("MAIN_SD"_ST, entry ([] { menu (MenuType::main, 0); }), //
                transition ("MAIN_JOG"_ST, left),                       // Next menu item
-               transition ("MAIN_JOG"_ST, right),                      // Prev menu item
-               transition ("JOG_YP"_ST, enter)),                       // Enter
+               transition ("MAIN_UNLOCK"_ST, right),                   // Prev menu item
+               transition ("SD"_ST, enter, [] (auto) { sdList::open (); })), // Enter
 
         state ("MAIN_JOG"_ST, entry ([] { menu (MenuType::main, 1); }), //
-               transition ("MAIN_SD"_ST, left),                         // Next menu item
+               transition ("MAIN_RESUME"_ST, left),                     // Next menu item
                transition ("MAIN_SD"_ST, right),                        // Prev menu item
                transition ("JOG_YP"_ST, enter)),                        // Enter
 
+        state ("MAIN_RESUME"_ST, entry ([] { menu (MenuType::main, 2); }),              //
+               transition ("MAIN_DASH"_ST, left),                                       // Next menu item
+               transition ("MAIN_JOG"_ST, right),                                       // Prev menu item
+               transition ("DASH"_ST, enter, [] (auto) { sd::resumeJob (); })),         // The interrupted job
+
+        state ("MAIN_DASH"_ST, entry ([] { menu (MenuType::main, 3); }), //
+               transition ("MAIN_UNLOCK"_ST, left),                      // Next menu item
+               transition ("MAIN_RESUME"_ST, right),                     // Prev menu item
+               transition ("DASH"_ST, enter)),                           // Enter
+
+        // GRBL locks itself at power up if homing is enabled ($22), and after some alarms. $X,
+        // only when asked for. The dashboard shows if it worked.
+        state ("MAIN_UNLOCK"_ST, entry ([] { menu (MenuType::main, 4); }),      //
+               transition ("MAIN_SD"_ST, left),                                 // Next menu item
+               transition ("MAIN_DASH"_ST, right),                              // Prev menu item
+               transition ("DASH"_ST, enter, [] (auto) { grbl::unlock (); })), // Enter
+
+        /*--------------------------------------------------------------------------*/
+        /* Dashboard                                                                */
+        /*--------------------------------------------------------------------------*/
+
+        state ("DASH"_ST, entry ([] { dashboard::open (); }),                               //
+               transition ("DASH"_ST, left, [] (auto) { dashboard::feedOverride (-1); }), // Slower
+               transition ("DASH"_ST, right, [] (auto) { dashboard::feedOverride (1); }), // Faster
+               transition ("MAIN_DASH"_ST, enter, [] (auto) { dashboard::close (); })),    // Back
+
         /*--------------------------------------------------------------------------*/
         /* SD card menu                                                             */
         /*--------------------------------------------------------------------------*/
 
-        state ("SD"_ST, entry ([] { sdMenu (0); }) //
-               /* transition ("MAIN_SD"_ST, left),                   // Next menu item
-               transition ("MAIN_SD"_ST, right),                  // Prev menu item
-               transition ("JOG_YP"_ST, enter) */),                  // Enter
+        state ("SD"_ST, entry ([] { sdList::dirty = sdList::urgent = true; }), //
+               transition ("SD"_ST, left, [] (auto) { sdList::next (); }),    // Next file
+               transition ("SD"_ST, right, [] (auto) { sdList::prev (); }),   // Prev file
+               transition ("MAIN_SD"_ST, enterBack, [] (auto) { sdList::close (); }), // Back
+               transition ("DASH"_ST, enterFile, [] (auto) { sdList::close (); sdList::start (); })), // Run the job, watch it
 
         /*--------------------------------------------------------------------------*/
         /* Jog menu                                                                 */
@@ -210,14 +576,38 @@ auto menuMachine = machine (
                transition ("JOG_XP"_ST, enter, [] (auto) { grbl::jog (grbl::JogDirection::xPositive); })),
 
         state ("JOG_XN"_ST, entry ([] { menu (MenuType::jog, 3); }),                                       //
-               transition ("JOG_BACK"_ST, left),                                                           //
+               transition ("JOG_KNOB_X"_ST, left),                                                         //
                transition ("JOG_XP"_ST, right),                                                            //
-               transition ("JOG_XN"_ST, enter, [] (auto) { grbl::jog (grbl::JogDirection::yPositive); })), //
+               transition ("JOG_XN"_ST, enter, [] (auto) { grbl::jog (grbl::JogDirection::xNegative); })), //
+
+        state ("JOG_KNOB_X"_ST, entry ([] { menu (MenuType::jog, 4); }), //
+               transition ("JOG_KNOB_Y"_ST, left),                       //
+               transition ("JOG_XN"_ST, right),                          //
+               transition ("KNOB_X"_ST, enter, [] (auto) { knob::open ('X'); })),
 
-        state ("JOG_BACK"_ST, entry ([] { menu (MenuType::jog, 4); }), //
+        state ("JOG_KNOB_Y"_ST, entry ([] { menu (MenuType::jog, 5); }), //
+               transition ("JOG_BACK"_ST, left),                         //
+               transition ("JOG_KNOB_X"_ST, right),                      //
+               transition ("KNOB_Y"_ST, enter, [] (auto) { knob::open ('Y'); })),
+
+        state ("JOG_BACK"_ST, entry ([] { menu (MenuType::jog, 6); }), //
                transition ("JOG_YP"_ST, left),                         //
-               transition ("JOG_XN"_ST, right),                        //
-               transition ("MAIN_JOG"_ST, enter))                       //
+               transition ("JOG_KNOB_Y"_ST, right),                    //
+               transition ("MAIN_JOG"_ST, enter)),                     //
+
+        /*--------------------------------------------------------------------------*/
+        /* Knob jogging                                                             */
+        /*--------------------------------------------------------------------------*/
+
+        state ("KNOB_X"_ST, entry ([] {}),                                         //
+               transition ("KNOB_X"_ST, left, [] (auto) { knob::jog (-1); }),      // Turned counter clockwise
+               transition ("KNOB_X"_ST, right, [] (auto) { knob::jog (1); }),      //
+               transition ("JOG_KNOB_X"_ST, enter, [] (auto) { knob::close (); })), // Back
+
+        state ("KNOB_Y"_ST, entry ([] {}),                                         //
+               transition ("KNOB_Y"_ST, left, [] (auto) { knob::jog (-1); }),      //
+               transition ("KNOB_Y"_ST, right, [] (auto) { knob::jog (1); }),      //
+               transition ("JOG_KNOB_Y"_ST, enter, [] (auto) { knob::close (); })) // Back
 );
 
 void displayThread (void *, void *, void *)
@@ -228,45 +618,30 @@ void displayThread (void *, void *, void *)
 
         // Enter into initial state, and execute its entry state (that displays the menu).
         menuMachine.run (Event::none);
-        bool prevE{};
-        uint8_t state = 0x04;
-        uint8_t output{};
-        bool first = true;
 
         while (true) {
-                constexpr std::array<std::array<uint8_t, 4>, 5> ENC = {{
-                        {0x00, 0x01, 0x02, 0x01},
-                        {0x10, 0x01, 0x01, 0x23},
-                        {0x20, 0x01, 0x02, 0x13},
-                        {0x01, 0x01, 0x02, 0x03},
-                }};
+                // Sleeps until the knob moves, or something on the screen has to change by itself.
+                uint32_t const due = std::min ({sdList::dueIn (), dashboard::dueIn (), screen.heldFor ()});
 
-                uint8_t event = gpio_pin_get_dt (&encoderB) << 1 | gpio_pin_get_dt (&encoderA);
-                auto x = ENC[state][event];
-                state = x & 0x03;
+                if (Input input; waitInput (input, (due == UINT32_MAX) ? K_FOREVER : K_MSEC (due))) {
+                        knob::steps = input.steps;
 
-                if (!first) {
-                        output = x & 0x30;
-                }
-
-                first = false;
-
-                if (bool e = gpio_pin_get_dt (&encoderEnter); e != prevE) {
-                        prevE = e;
-
-                        if (e) {
+                        if (input.type == Input::Type::enter) {
                                 menuMachine.run (Event::enter);
                         }
+                        else if (knob::axis != 0) { // Jogging: the clicks go out as one jog.
+                                menuMachine.run ((input.type == Input::Type::left) ? Event::left : Event::right);
+                        }
+                        else {
+                                for (uint8_t i = 0; i < input.detents; ++i) {
+                                        menuMachine.run ((input.type == Input::Type::left) ? Event::left : Event::right);
+                                }
+                        }
                 }
 
-                if (output == 0x20) {
-                        menuMachine.run (Event::left);
-                }
-                else if (output == 0x10) {
-                        menuMachine.run (Event::right);
-                }
-
-                k_sleep (K_MSEC (4));
+                sdList::redraw ();
+                dashboard::redraw ();
+                screen.flush (Screen::Update::periodic); // What was held back.
         }
 }
 } // namespace
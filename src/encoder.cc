@@ -0,0 +1,161 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#include "encoder.h"
+#include <algorithm>
+#include <array>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER (encoder);
+
+/*
+ * Both edges of A, B and the button raise an interrupt. The A/B one feeds the pins to the
+ * transition table (a full quadrature cycle per click, bounces go back and forth between the
+ * states and never complete one), the button one takes a press if the pin was released for
+ * DEBOUNCE_MS. The clicks are timed, the faster they come the more steps they count for
+ * (ACCELERATION). Nothing is polled: without input the display thread sleeps.
+ */
+
+namespace disp {
+namespace {
+        const gpio_dt_spec encoderA = GPIO_DT_SPEC_GET (DT_PATH (ui_buttons, encoder_a), gpios);
+        const gpio_dt_spec encoderB = GPIO_DT_SPEC_GET (DT_PATH (ui_buttons, encoder_b), gpios);
+        const gpio_dt_spec encoderEnter = GPIO_DT_SPEC_GET (DT_PATH (ui_buttons, enter), gpios);
+
+        constexpr uint32_t DEBOUNCE_MS = 20;
+
+        /// Steps of a click which came within ms of the previous one in the same direction.
+        struct Acceleration {
+                uint32_t ms;
+                uint8_t steps;
+        };
+
+        constexpr std::array<Acceleration, 3> ACCELERATION = {{{20, 10}, {50, 5}, {100, 2}}};
+
+        /// Low 2 bits: the next state, 0x10 and 0x20: a click completed. Row 4 is the start.
+        constexpr std::array<std::array<uint8_t, 4>, 5> ENC = {{
+                {0x00, 0x01, 0x02, 0x01},
+                {0x10, 0x01, 0x01, 0x23},
+                {0x20, 0x01, 0x02, 0x13},
+                {0x01, 0x01, 0x02, 0x03},
+        }};
+
+        K_MSGQ_DEFINE (inputs, sizeof (Input), 32, 4);
+
+        std::array<gpio_callback, 3> callbacks; // A, B, enter.
+
+        uint8_t state = 0x04;        // Of ENC. ISR only.
+        uint32_t lastClick{};        // ISR only.
+        Input::Type lastDirection{}; // ISR only.
+        bool pressed{};              // ISR only.
+        uint32_t releasedAt{};       // ISR only.
+
+        /// Dropped if the thread is 32 inputs behind.
+        void put (Input const &input) { k_msgq_put (&inputs, &input, K_NO_WAIT); }
+
+        void onRotation (const struct device *, gpio_callback *, uint32_t)
+        {
+                uint8_t const pins = gpio_pin_get_dt (&encoderB) << 1 | gpio_pin_get_dt (&encoderA);
+                uint8_t const x = ENC[state][pins];
+                state = x & 0x03;
+
+                if ((x & 0x30) == 0) {
+                        return;
+                }
+
+                auto const type = ((x & 0x30) == 0x20) ? Input::Type::left : Input::Type::right;
+                uint32_t const now = k_uptime_get_32 ();
+                uint8_t steps = 1;
+
+                if (type == lastDirection) {
+                        for (auto const &a : ACCELERATION) {
+                                if (now - lastClick < a.ms) {
+                                        steps = a.steps;
+                                        break;
+                                }
+                        }
+                }
+
+                lastClick = now;
+                lastDirection = type;
+                put (Input{type, 1, steps});
+        }
+
+        void onEnter (const struct device *, gpio_callback *, uint32_t)
+        {
+                bool const e = gpio_pin_get_dt (&encoderEnter) != 0;
+                uint32_t const now = k_uptime_get_32 ();
+
+                if (e == pressed) {
+                        return;
+                }
+
+                pressed = e;
+
+                if (!e) {
+                        releasedAt = now;
+                        return;
+                }
+
+                if (now - releasedAt >= DEBOUNCE_MS) {
+                        put (Input{Input::Type::enter, 1, 1});
+                }
+        }
+
+        bool configure (gpio_dt_spec const &spec, gpio_callback &callback, gpio_callback_handler_t handler)
+        {
+                if (!gpio_is_ready_dt (&spec)) {
+                        return false;
+                }
+
+                int ret = gpio_pin_configure_dt (&spec, GPIO_INPUT);
+                gpio_init_callback (&callback, handler, BIT (spec.pin));
+                ret |= gpio_add_callback (spec.port, &callback);
+                ret |= gpio_pin_interrupt_configure_dt (&spec, GPIO_INT_EDGE_BOTH);
+                return ret == 0;
+        }
+
+} // namespace
+
+/****************************************************************************/
+
+bool encoderInit ()
+{
+        bool ok = configure (encoderA, callbacks[0], onRotation);
+        ok = configure (encoderB, callbacks[1], onRotation) && ok;
+        ok = configure (encoderEnter, callbacks[2], onEnter) && ok;
+
+        if (!ok) {
+                LOG_ERR ("Encoder init failed");
+        }
+
+        return ok;
+}
+
+/****************************************************************************/
+
+bool waitInput (Input &input, k_timeout_t timeout)
+{
+        if (k_msgq_get (&inputs, &input, timeout) != 0) {
+                return false;
+        }
+
+        Input next;
+
+        while (input.type != Input::Type::enter && k_msgq_peek (&inputs, &next) == 0 && next.type == input.type) {
+                k_msgq_get (&inputs, &next, K_NO_WAIT);
+                input.detents = std::min (input.detents + next.detents, UINT8_MAX);
+                input.steps = std::min (input.steps + next.steps, UINT16_MAX);
+        }
+
+        return true;
+}
+
+} // namespace disp
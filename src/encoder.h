@@ -0,0 +1,32 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#pragma once
+#include <cstdint>
+#include <zephyr/kernel.h>
+
+/*
+ * The rotary encoder and its button, decoded in the GPIO interrupts (encoder.cc). The display
+ * thread sleeps in waitInput until there's something to do.
+ */
+namespace disp {
+
+struct Input {
+        enum class Type : uint8_t { left, right, enter };
+        Type type{};
+        uint8_t detents{}; /// Clicks of the knob in this direction, 1 for enter.
+        uint16_t steps{};  /// The same with the acceleration: a click counts more when the knob turns fast.
+};
+
+/// The pins and their interrupts. False if they can't be used.
+bool encoderInit ();
+
+/// The next input, the clicks queued meanwhile in the same direction merged. False on timeout.
+bool waitInput (Input &input, k_timeout_t timeout);
+
+} // namespace disp
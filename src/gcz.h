@@ -0,0 +1,208 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Compressed g-code jobs (.gcz). The host tool (deps/gnea-grbl/doc/script/gcz.py) first
+ * rewrites the job the way Grbl would see it anyway: comments, white space and '%' removed,
+ * letters capitalized, needless zeros in numbers dropped (G02 -> G2, 2.000000 -> 2) as long as
+ * read_float gives exactly the same float. Then it compresses the result with LZSS:
+ *
+ * Header, 12 bytes:
+ *   "GCZ1"
+ *   uint32 LE  decoded size
+ *   uint32 LE  CRC-32 (IEEE, the zlib one) of the decoded data
+ *
+ * Body: groups of a flag byte followed by up to 8 items, the first item described by the least
+ * significant bit. Bit set: a literal byte. Bit clear: a match, uint16 LE where the lower
+ * WINDOW_BITS are the distance back minus 1, and the upper bits the length minus MIN_MATCH.
+ * Matches may overlap the bytes they produce.
+ *
+ * Decoding needs only the last WINDOW_SIZE decoded bytes and is done in a streaming fashion, so
+ * the file can be read in chunks of any size.
+ */
+
+namespace gcz {
+
+static constexpr uint8_t MAGIC[] = {'G', 'C', 'Z', '1'};
+static constexpr size_t HEADER_SIZE = 12;
+static constexpr unsigned WINDOW_BITS = 12;
+static constexpr size_t WINDOW_SIZE = 1 << WINDOW_BITS;
+static constexpr unsigned MIN_MATCH = 3;
+static constexpr unsigned MAX_MATCH = MIN_MATCH + (1 << (16 - WINDOW_BITS)) - 1;
+
+/// CRC-32 as in zlib, bit by bit. The card is much slower than this anyway.
+inline uint32_t crc32Update (uint32_t crc, uint8_t byte)
+{
+        crc ^= byte;
+
+        for (int i = 0; i < 8; ++i) {
+                crc = (crc >> 1) ^ (0xedb88320U & (0U - (crc & 1U)));
+        }
+
+        return crc;
+}
+
+enum class Status {
+        ok,        /// So far so good, feed more.
+        finished,  /// Everything decoded, size and CRC match.
+        badHeader, /// Not a .gcz file.
+        badData,   /// Match pointing before the start, or more data than the header says.
+        badCrc     /// Decoded as many bytes as expected, but the CRC doesn't match.
+};
+
+/**
+ * Streaming decoder. Feed it the file as it is read, decoded bytes are passed to the sink one
+ * by one.
+ */
+class Decoder {
+public:
+        /// Feeds `len` bytes of the file. Sink is called as `sink (uint8_t)` for every decoded
+        /// byte. Once something else than Status::ok is returned, the decoder stays in that state.
+        template <typename Sink> Status feed (const uint8_t *data, size_t len, Sink &&sink);
+
+        /// Status::finished if the whole file was fed and it was fine.
+        Status status () const { return (state == State::done) ? Status::finished : (state == State::error) ? error : Status::ok; }
+
+        uint32_t decodedSize () const { return size; }
+        uint32_t decoded () const { return produced; }
+
+        /// Ready for the next file. The window doesn't need clearing.
+        void reset ()
+        {
+                state = State::header;
+                error = Status::ok;
+                crc = 0xffffffffU;
+                size = expectedCrc = produced = 0;
+                headerLen = flags = itemsLeft = 0;
+        }
+
+private:
+        enum class State { header, flags, literal, matchLow, matchHigh, done, error };
+
+        template <typename Sink> void emit (uint8_t byte, Sink &sink);
+
+        /// After the last byte the rest of the flags are padding.
+        void checkEnd ()
+        {
+                if (produced == size) {
+                        state = ((crc ^ 0xffffffffU) == expectedCrc) ? State::done : State::error;
+                        error = (state == State::error) ? Status::badCrc : Status::ok;
+                }
+        }
+
+        Status fail (Status s)
+        {
+                state = State::error;
+                error = s;
+                return s;
+        }
+
+        State state{State::header};
+        Status error{Status::ok};
+        std::array<uint8_t, HEADER_SIZE> header{};
+        std::array<uint8_t, WINDOW_SIZE> window{};
+        uint32_t size{};
+        uint32_t expectedCrc{};
+        uint32_t crc{0xffffffffU};
+        uint32_t produced{};
+        uint8_t headerLen{};
+        uint8_t flags{};
+        uint8_t itemsLeft{}; // In the current flag group.
+        uint8_t matchLow{};
+};
+
+/*--------------------------------------------------------------------------*/
+
+template <typename Sink> void Decoder::emit (uint8_t byte, Sink &sink)
+{
+        window[produced % WINDOW_SIZE] = byte;
+        ++produced;
+        crc = crc32Update (crc, byte);
+        sink (byte);
+}
+
+/*--------------------------------------------------------------------------*/
+
+template <typename Sink> Status Decoder::feed (const uint8_t *data, size_t len, Sink &&sink)
+{
+        for (size_t i = 0; i < len; ++i) {
+                uint8_t byte = data[i];
+
+                switch (state) {
+                case State::header:
+                        header[headerLen++] = byte;
+
+                        if (headerLen == sizeof (MAGIC) && !std::equal (std::begin (MAGIC), std::end (MAGIC), header.begin ())) {
+                                return fail (Status::badHeader);
+                        }
+
+                        if (headerLen == HEADER_SIZE) {
+                                size = header[4] | (header[5] << 8) | (header[6] << 16) | (uint32_t (header[7]) << 24);
+                                expectedCrc = header[8] | (header[9] << 8) | (header[10] << 16) | (uint32_t (header[11]) << 24);
+                                state = State::flags;
+                                checkEnd ();
+                        }
+                        continue;
+
+                case State::flags:
+                        flags = byte;
+                        itemsLeft = 8;
+                        state = (flags & 1) ? State::literal : State::matchLow;
+                        continue;
+
+                case State::literal:
+                        emit (byte, sink);
+                        break;
+
+                case State::matchLow:
+                        matchLow = byte;
+                        state = State::matchHigh;
+                        continue;
+
+                case State::matchHigh: {
+                        uint16_t item = matchLow | (byte << 8);
+                        uint32_t distance = (item & (WINDOW_SIZE - 1)) + 1;
+                        uint32_t length = (item >> WINDOW_BITS) + MIN_MATCH;
+
+                        if (distance > produced || produced + length > size) {
+                                return fail (Status::badData);
+                        }
+
+                        for (uint32_t j = 0; j < length; ++j) {
+                                emit (window[(produced - distance) % WINDOW_SIZE], sink);
+                        }
+                } break;
+
+                case State::done:
+                        return fail (Status::badData); // Trailing garbage.
+
+                case State::error:
+                        return error;
+                }
+
+                // An item is complete.
+                flags >>= 1;
+                --itemsLeft;
+                state = (itemsLeft == 0) ? State::flags : (flags & 1) ? State::literal : State::matchLow;
+                checkEnd ();
+
+                if (state == State::error) {
+                        return error;
+                }
+        }
+
+        return status ();
+}
+
+} // namespace gcz
@@ -7,297 +7,200 @@
  ****************************************************************************/
 
 #include "grblState.h"
-#include "Machine.h"
-#include "grbl/protocol.h"
-#include "grbl/serial.h"
-#include <climits>
-#include <cstdlib>
-#include <ctre.hpp>
-#include <etl/string.h>
-#include <zephyr/kernel.h>
+#include "grbl/report.h"
+#include <cstring>
 #include <zephyr/logging/log.h>
 
 /*
- * https://github.com/gnea/grbl/issues/822 - good summary of the protocol.
- * https://github.com/wnelis/Grbl-driver-python/blob/master/GrblDriver.py - Python code written by the guy from the above thread.
- *
- * To sum things up:
- * - 3 types of requests : g-code blocks, control commands and real-time commands
- * - 2? types of resonses:
- *   - push commands (async)
- *   - responses to the above requests
- * The so called "streaming protocol" (called this way by the op) is the request-response
- * flow involving the c-command blocks and control commands.
- *
- * empty string, g-code or system command ($x) -> response:
- * ok | error:num
- * ^X : welcome
- * !, ? and ~ are treated somewhat differently, but I can't see how.
- *
- * Push messages:
- *   gdWelcomeMsg,		        # Soft reset completed message
- *   '^ALARM:',				# Alarm message
- *   '^\[MSG:.*\]$',			# Unsolicited feedback message
- *   '^>.*:(?:ok|error:.*)$',		# Start up message ($N)
- *   '^$'				# Empty line
- *
- * "Verbose" messages:
- * <Idle|MPos:0.000,3.000,0.000|F:0|WCO:0.000,0.000,0.000>
- * <Idle|MPos:0.000,3.000,0.000|F:0>
+ * The UI used to write lines to its serial channel and to run a state machine on the replies,
+ * matched with regexes in a thread of its own. Now the commands are posted to GRBL as they are
+ * (grbl/command.h), the results come back to a callback, and the state is in the snapshot.
+ * The protocol notes (https://github.com/gnea/grbl/issues/822) still apply to the host.
  */
 
 LOG_MODULE_REGISTER (grbl);
 
-using string = etl::string<LINE_BUFFER_SIZE>;
-
-void grblResponseThread (void *, void *, void *);
-void grblRequestThread (void *, void *, void *);
+namespace grbl {
+namespace {
 
-constexpr int SD_CARD_STACK_SIZE = 32768;
-constexpr int SD_CARD_PRIORITY = 13; // The same as the main thread! Time slicing is ON!
+        /// For the commands nobody waits for. Called from the GRBL main thread.
+        void logFailure (const command_result_t *result, void *)
+        {
+                if (result->status != STATUS_OK) {
+                        LOG_WRN ("UI command failed: error:%u (%s)", result->status, snapshot_state_name (result->state));
+                }
+        }
 
-K_THREAD_DEFINE (sdrx, SD_CARD_STACK_SIZE, grblResponseThread, NULL, NULL, NULL, SD_CARD_PRIORITY, 0, 0);
-K_MUTEX_DEFINE (machineMutex);
+        command_t jogCommand (float x, float y, float z, float feedRate)
+        {
+                command_t command{};
+                command.type = COMMAND_JOG;
+                command.args.jog.distance[0] = x;
+                command.args.jog.distance[1] = y;
+                command.args.jog.distance[2] = z;
+                command.args.jog.feed_rate = feedRate;
+                return command;
+        }
 
-// To make things easier.
-static_assert (LINE_BUFFER_SIZE % 4 == 0);
+} // namespace
 
-/*
-Actions
-- Wait for the system to get ready.
-  - For instance chceck if peripherals are initialized or something.
-- Reset the GRBL. It can be in unknown state. UGS sequence is (I think) this : ^X, $$, $G
-- $X : Unlock
-- $H : Home
-- $N probably those 2 lines that got stored in the EEPROM ?
-- $$ : current settings
-- $x=val - store a setting?
-- $G : supported comands? Noo, too few.
-- $# some state. Don't know the meaning.
-- $SLP : sleep (^X to wake up)
-- $ : help
-- $I version
-- $J : ?
-$C : ?
-
-
-
-
-TODO move to a separate file (differentiate to sd and grbl)
-TODO change namespace name to grbl
-*/
+/****************************************************************************/
 
-namespace grbl {
-void executeLine (const char *line);
-void executeCommand (char command);
+void Future::complete (const command_result_t *result, void *future)
+{
+        auto *f = static_cast<Future *> (future);
+        atomic_set (&f->value, atomic_val_t (result->state) << 8 | result->status);
+        k_sem_give (&f->sem);
+}
 
-using namespace ls;
+/****************************************************************************/
 
-enum class Error { none, one, two };
-enum class Alarm { none, limit, two };
-enum class StateName { idle, alarm, hold };
+std::optional<command_result_t> Future::result () const
+{
+        atomic_val_t const v = atomic_get (&value);
 
-/**
- * Tracks the state of the GRBL. We probably could reach out to the GRBL itself since it
- * is runninng alongside in another thread, but I feel that communicating wit it the normal
- * way is the right thing to do. Everythong stays separated.
- */
-struct ReceivedState {
-        Error error{};
-        Alarm alarm{};
-        StateName stateName{};
-};
+        if (v < 0) {
+                return {};
+        }
 
-ReceivedState receivedState;
+        return command_result_t{uint8_t (v & 0xff), uint8_t (v >> 8)};
+}
 
-struct RequestedState {
-        JogDirection jogDirection{};
-};
+/****************************************************************************/
 
-RequestedState requestedState;
+bool Future::wait (k_timeout_t timeout)
+{
+        if (!pending ()) {
+                return true;
+        }
 
-/**
- * State machine conditions.
- */
+        if (k_sem_take (&sem, timeout) != 0) {
+                return false;
+        }
 
-/// Gcode and status response:
-constexpr auto gCodeResponse = [] (auto const &s) { return ctre::match<"^(?:ok|error:(\\d*))(\r\n)?$"> (s); };
-constexpr auto ok = [] (auto const &s) { return s == "ok\r\n"; };
-/// Push messages:
-// constexpr auto welcomeMessage = [] (auto const &s) { return ctre::match<"^Grbl.+\\](\r\n)?$"> (s); };
-// constexpr auto welcomeMessage = [] (auto const &s) { return ctre::match<"^Grbl.+\\](\r\n)?$"> ("Grbl 1.1h ['$' for help]"); };
-constexpr auto welcomeMessage = [] (auto const &s) { return s == "Grbl 1.1h ['$' for help]\r\n"; };
-// auto welcomeMessage = [] { return [] (auto const &s) { return ctre::match<"^Grbl.+\\](\r\n)?$"> (s); }; };
-constexpr auto settingMessage = [] (auto const &s) { return ctre::match<"^\\$\\d+=.*(\r\n)?"> (s); };
-constexpr auto msgMessage = [] (auto const &s) { return ctre::match<"^\\[MSG:.*\\](\r\n)?$"> (s); };
-constexpr auto lockedMessage = [] (auto const &s) { return ctre::match<"^\\[MSG:'\\$H'\\|'\\$X' to unlock\\](\r\n)?$"> (s); };
-constexpr auto unlockedMessage = [] (auto const &s) { return ctre::match<"^\\[MSG:Caution: Unlocked\\](\r\n)?$"> (s); };
-constexpr auto alarmMessage = [] (auto const &s) { return ctre::match<"^ALARM:(\\d*)(\r\n)?$"> (s); };
-constexpr auto errorMessage = [] (auto const &s) { return ctre::match<"^error:(\\d*)(\r\n)?$"> (s); };
-/// Verbose (responses to the "?")
-constexpr auto verboseMessage = [] (auto const &s) { return ctre::match<"^<([a-zA-Z]*)\\|MPos:(.*),(.*),(.*)\\|F:(\\d*).*(\r\n)?$"> (s); };
-constexpr auto idleVerbose = [] (auto const &s) { return ctre::match<"^<Idle.*(\r\n)?$"> (s); };
-constexpr auto jogVerbose = [] (auto const &s) { return ctre::match<"^<Jog.*(\r\n)?$"> (s); };
-constexpr auto alarmVerbose = [] (auto const &s) { return ctre::match<"^<Alarm.*(\r\n)?$"> (s); };
-
-constexpr char CMD_RESET = 0x18;
-constexpr char CMD_STATUS_REPORT = '?';
-constexpr char CMD_CYCLE_START = '~';
-constexpr char CMD_FEED_HOLD = '!';
-
-/**
- * Tracks GRBL's state. A minimal subset of what the UGS can do.
- */
-auto grblMachine
-        = machine (state ("init"_ST, entry ([] {
-                                  printk ("# init\r\n");
-                                  executeCommand (CMD_RESET);
-                          }),
-                          transition ("ready"_ST, welcomeMessage)),
-
-                   state ("ready"_ST, entry ([] () { printk ("# ready\r\n"); }),
-                          transition ("locked"_ST, lockedMessage),                           // GRBL locked itself. Immediately unlock.
-                          transition ("jog"_ST, [] (string const &s) { return s == "jog"; }) // User action jog along Y in the positive dir.
-                          ),
-
-                   state ("locked"_ST, entry ([] (auto) { // Automatic unlocking state.
-                                  printk ("# locked\r\n");
-                                  executeLine ("$X\r\n"); // Send command to the GRBL.
-                          }),
-                          transition ("ready"_ST, unlockedMessage)), // Transition back to ready upon receiving a response.
-
-                   state ("jog"_ST, entry ([] (auto) {
-                                  printk ("# jog\r\n");
-
-                                  switch (requestedState.jogDirection) {
-                                  case JogDirection::xPositive:
-                                          grbl::executeLine ("$J=G21G91X10F500\r\n");
-                                          break;
-
-                                  case JogDirection::xNegative:
-                                          grbl::executeLine ("$J=G21G91X-10F500\r\n");
-                                          break;
-
-                                  case JogDirection::yPositive:
-                                          grbl::executeLine ("$J=G21G91Y10F500\r\n");
-                                          break;
-
-                                  case JogDirection::yNegative:
-                                          grbl::executeLine ("$J=G21G91Y-10F500\r\n");
-                                          break;
-
-                                  default:
-                                          break;
-                                  }
-                          }),
-                          transition ("waitidle"_ST, ok)),
-
-                   state ("waitidle"_ST, entry ([] {
-                                  printk ("# wi\r\n");
-                                  executeCommand (CMD_STATUS_REPORT);
-                                  k_sleep (K_MSEC (250));
-                          }),
-                          transition ("ready"_ST, idleVerbose), transition ("alarm"_ST, alarmVerbose),
-                          transition ("waitidle"_ST, [] (auto) { return true; })),
-
-                   state ("alarm"_ST, entry ([] { printk ("# ALARM"); }), transition ("ready"_ST, [] (string const &s) { return s == ""; })),
-                   state ("waitrsp"_ST, entry ([] () {}), transition ("ready"_ST, [] (string const &s) { return s == ""; })));
-
-/**
- *
- */
-void jog (JogDirection dir)
-{
-        k_mutex_lock (&machineMutex, K_FOREVER);
-        requestedState.jogDirection = dir;
-        grblMachine.run (string ("jog"));
-        k_mutex_unlock (&machineMutex);
+        k_sem_give (&sem); // Ready for the other waiters, taken back by the next post.
+        return true;
 }
 
-/**
- * Get and return next response if there is some in the ring buffer.
- */
-string response ()
+/****************************************************************************/
+
+bool post (command_t &command, Future *future)
 {
-        string rsp;
-        rsp.resize (rsp.max_size ());
-        auto ret = serial_get_tx_line (reinterpret_cast<uint32_t *> (rsp.data ()), rsp.size () / 4);
+        if (future != nullptr) {
+                if (future->pending ()) {
+                        LOG_WRN ("Future still pending, command %u not posted", command.type);
+                        return false;
+                }
 
-        if (ret < 0) {
-                printk ("rsp buffer error");
-                return {};
+                k_sem_reset (&future->sem);
+                atomic_set (&future->value, Future::PENDING);
+                command.done = Future::complete;
+                command.user_data = future;
         }
+        else {
+                command.done = logFailure;
+        }
+
+        if (!command_post (&command)) {
+                LOG_WRN ("GRBL command queue full, command %u dropped", command.type);
 
-        rsp.resize (ret);
-        return rsp;
+                if (future != nullptr) {
+                        atomic_set (&future->value, Future::NONE);
+                }
+
+                return false;
+        }
+
+        return true;
 }
 
-} // namespace grbl
+/****************************************************************************/
 
-/**
- *
- */
-void grblResponseThread (void *, void *, void *)
+bool jog (JogDirection dir, Future *future)
 {
-        while (true) {
-                k_sleep (K_MSEC (10));
+        constexpr float STEP = 10;  // mm
+        constexpr float FEED = 500; // mm/min
 
-                string rsp = grbl::response ();
+        switch (dir) {
+        case JogDirection::xPositive:
+                return jogBy ('X', STEP, FEED, future);
 
-                if (!rsp.empty ()) {
-                        printk ("< %s", rsp.c_str ()); // Formatted synchronously, so no worries aboyt rsp.
-                }
+        case JogDirection::xNegative:
+                return jogBy ('X', -STEP, FEED, future);
+
+        case JogDirection::yPositive:
+                return jogBy ('Y', STEP, FEED, future);
 
-                k_mutex_lock (&machineMutex, K_FOREVER);
-                grbl::grblMachine.run (rsp);
-                k_mutex_unlock (&machineMutex);
+        case JogDirection::yNegative:
+                return jogBy ('Y', -STEP, FEED, future);
+
+        default:
+                return false;
         }
 }
 
-/**
- *
- */
-void grblRequestThread (void *, void *, void *)
+/****************************************************************************/
+
+bool jogBy (char axis, float mm, float feedRate, Future *future)
 {
-        while (true) {
-                grbl::executeLine ("G0 X-0.5 Y0.\r\n");
-                k_sleep (K_SECONDS (3));
-                grbl::executeLine ("G0 X0. Y0.\r\n");
-                k_sleep (K_SECONDS (3));
+        command_t command;
+
+        switch (axis) {
+        case 'X':
+                command = jogCommand (mm, 0, 0, feedRate);
+                break;
+
+        case 'Y':
+                command = jogCommand (0, mm, 0, feedRate);
+                break;
+
+        case 'Z':
+                command = jogCommand (0, 0, mm, feedRate);
+                break;
+
+        default:
+                return false;
         }
+
+        return post (command, future);
 }
 
-namespace grbl {
+/****************************************************************************/
 
-/**
- *
- */
-void executeLine (const char *line)
+bool home (Future *future)
 {
-        if (!serial_is_initialized ()) {
-                LOG_WRN ("Serial subsystem is required for SD card to operate.");
-                return;
-        }
+        command_t command{};
+        command.type = COMMAND_HOME;
+        return post (command, future);
+}
+
+/****************************************************************************/
 
-        serial_disable_irqs ();
-        printk ("> %s", line); // Formatted synchronously, so no worries aboyt rsp.
-        serial_buffer_append (line);
-        serial_enable_irqs ();
+bool unlock (Future *future)
+{
+        command_t command{};
+        command.type = COMMAND_UNLOCK;
+        return post (command, future);
 }
 
-/**
- *
- */
-void executeCommand (char command)
+/****************************************************************************/
+
+bool estimate (const char *path, Future *future)
 {
-        if (!serial_is_initialized ()) {
-                LOG_WRN ("Serial subsystem is required for SD card to operate.");
-                return;
+        command_t command{};
+        command.type = COMMAND_ESTIMATE;
+
+        if (strlen (path) >= sizeof (command.args.path)) {
+                LOG_WRN ("Path too long to estimate: %s", path);
+                return false;
         }
 
-        serial_disable_irqs ();
-        serial_check_real_time_command (command);
-        serial_enable_irqs ();
+        strcpy (command.args.path, path);
+        return post (command, future);
 }
 
-} // namespace grbl
\ No newline at end of file
+/****************************************************************************/
+
+bool state (machine_snapshot_t *m) { return snapshot_read (m); }
+
+} // namespace grbl
@@ -7,10 +7,67 @@
  ****************************************************************************/
 
 #pragma once
+#include "grbl/command.h"
+#include "grbl/snapshot.h"
+#include <optional>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
 
+/*
+ * The UI's way to GRBL: typed commands executed by its main thread (grbl/command.h), the state
+ * read from the snapshot it publishes (grbl/snapshot.h). No text goes either way. A command
+ * given no Future has its failures logged, and that's it.
+ */
 namespace grbl {
 
+/**
+ * The result of a command, for the thread which posted it to poll or to wait for. Can be
+ * given to the next command once this one has completed. Must outlive the command.
+ */
+class Future {
+public:
+        Future () { k_sem_init (&sem, 0, 1); }
+        Future (Future const &) = delete;
+        Future &operator= (Future const &) = delete;
+
+        bool pending () const { return atomic_get (&value) == PENDING; }
+
+        /// Nothing while pending, or if the future wasn't used yet.
+        std::optional<command_result_t> result () const;
+
+        /// Until the command completes. False on timeout.
+        bool wait (k_timeout_t timeout);
+
+private:
+        friend bool post (command_t &command, Future *future);
+        static void complete (const command_result_t *result, void *future);
+
+        static constexpr atomic_val_t NONE = -2;
+        static constexpr atomic_val_t PENDING = -1;
+        atomic_t value = ATOMIC_INIT (NONE); // state << 8 | status when completed.
+        k_sem sem{};
+};
+
 enum class JogDirection { yPositive, yNegative, xPositive, xNegative };
-void jog (JogDirection dir);
 
-} // namespace grbl
\ No newline at end of file
+/// 10 mm at once, from the jog menu.
+bool jog (JogDirection dir, Future *future = nullptr);
+
+/// Relative jog of one axis ('X', 'Y' or 'Z') by mm, for the knob. Queued after the previous ones.
+bool jogBy (char axis, float mm, float feedRate = 3000, Future *future = nullptr);
+
+bool home (Future *future = nullptr);
+bool unlock (Future *future = nullptr);
+
+/// The time and the bounds of a job file, see sdEstimate.h for the result. GRBL takes no lines
+/// while the estimate runs, so it's refused unless the machine is idle. A reset stops it.
+bool estimate (const char *path, Future *future = nullptr);
+
+/// Feed hold, cycle start, the overrides. At once, from any thread.
+inline void realtime (command_realtime_t command) { command_realtime (command); }
+
+/// What the machine is doing, as of at most SNAPSHOT_PERIOD_MS ago. False, and *m is left
+/// alone, if no consistent copy could be made (see snapshot_read).
+bool state (machine_snapshot_t *m);
+
+} // namespace grbl
@@ -0,0 +1,169 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#include "screen.h"
+#include <algorithm>
+#include <zephyr/display/cfb.h>
+#include <zephyr/drivers/display.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/iterable_sections.h>
+
+LOG_MODULE_REGISTER (screen);
+
+namespace disp {
+namespace {
+        /*
+         * The panel runs in the reverse mode (PIXEL_FORMAT_MONO10, see disp::init), where a 0
+         * lights the pixel. The frame keeps the ink as 1s, like the font has it.
+         */
+        constexpr uint8_t TO_PANEL = 0xff;
+} // namespace
+
+/****************************************************************************/
+
+bool Screen::init (const struct device *d)
+{
+        display = d;
+        const struct cfb_font *f{};
+        STRUCT_SECTION_GET (cfb_font, 0, &f);
+
+        // Vertically packed, LSB on top: a byte per column, like a page of the SSD1306.
+        if (f == nullptr || f->height != 8 || (f->caps & CFB_FONT_MONO_VPACKED) == 0 || (f->caps & CFB_FONT_MSB_FIRST) != 0) {
+                LOG_ERR ("No suitable font");
+                return false;
+        }
+
+        font = static_cast<const uint8_t *> (f->data);
+        fontWidth = f->width;
+        firstChar = f->first_char;
+        lastChar = f->last_char;
+        clear ();
+        panelKnown = false;
+        flush ();
+        return true;
+}
+
+/****************************************************************************/
+
+void Screen::clear ()
+{
+        for (auto &page : frame) {
+                page.fill (0);
+        }
+}
+
+/****************************************************************************/
+
+void Screen::print (const char *text, uint16_t x, uint16_t y)
+{
+        if (font == nullptr || y % 8 != 0 || y >= HEIGHT) {
+                return;
+        }
+
+        Page &page = frame[y / 8];
+
+        for (; *text != '\0' && x < WIDTH; ++text) {
+                auto c = uint8_t (*text);
+
+                if (c < firstChar || c > lastChar) {
+                        c = '?';
+                }
+
+                const uint8_t *glyph = font + (c - firstChar) * fontWidth;
+
+                for (uint8_t column = 0; column < fontWidth && x < WIDTH; ++column, ++x) {
+                        page[x] = glyph[column];
+                }
+        }
+}
+
+/****************************************************************************/
+
+void Screen::flush (Update update)
+{
+        if (display == nullptr) {
+                return;
+        }
+
+        uint32_t const now = k_uptime_get_32 ();
+
+        if (update == Update::periodic && panelKnown && now - lastFlush < PERIODIC_MS) {
+                held = true;
+                return;
+        }
+
+        held = false;
+
+        bool any = false;
+        bool failed = false;
+
+        for (uint16_t p = 0; p < PAGES; ++p) {
+                Page const &drawn = frame[p];
+                Page &shown = panel[p];
+                uint16_t first = 0;
+                uint16_t last = WIDTH;
+
+                if (panelKnown) {
+                        while (first < WIDTH && drawn[first] == shown[first]) {
+                                ++first;
+                        }
+
+                        if (first == WIDTH) {
+                                continue;
+                        }
+
+                        while (drawn[last - 1] == shown[last - 1]) {
+                                --last;
+                        }
+                }
+
+                std::array<uint8_t, WIDTH> out;
+                uint16_t const width = last - first;
+
+                for (uint16_t i = 0; i < width; ++i) {
+                        out[i] = drawn[first + i] ^ TO_PANEL;
+                }
+
+                display_buffer_descriptor desc{};
+                desc.buf_size = width;
+                desc.width = width;
+                desc.height = 8;
+                desc.pitch = width;
+
+                if (int ret = display_write (display, first, p * 8, &desc, out.data ()); ret != 0) {
+                        LOG_ERR ("Write of page %u failed (%d)", p, ret);
+                        failed = true;
+                        continue; // Stays different, tried again next time.
+                }
+
+                std::copy (drawn.begin () + first, drawn.begin () + last, shown.begin () + first);
+                sent += width;
+                any = true;
+        }
+
+        panelKnown = panelKnown || !failed; // Until all of it has been written once.
+
+        if (any) {
+                lastFlush = now;
+        }
+}
+
+/****************************************************************************/
+
+uint32_t Screen::heldFor () const
+{
+        if (!held) {
+                return UINT32_MAX;
+        }
+
+        uint32_t const since = k_uptime_get_32 () - lastFlush;
+        return (since < PERIODIC_MS) ? PERIODIC_MS - since : 0;
+}
+
+} // namespace disp
@@ -0,0 +1,70 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#pragma once
+#include <array>
+#include <cstdint>
+
+struct device;
+
+namespace disp {
+
+/**
+ * The picture on the OLED, in place of the character framebuffer, which sends the whole 1 kB
+ * over I2C on every change. The SSD1306 memory is 8 pages of 8 rows, a byte is a column of a
+ * page. Two copies are kept: what is drawn, and what the panel shows. flush sends only the
+ * pages which differ, and of those only the columns from the first to the last changed one, so
+ * moving the cursor is a couple of glyphs, not the whole screen. Drawing is text only, in rows
+ * of 8 px (the font height), starting at a page. Used by the display thread only.
+ */
+class Screen {
+public:
+        static constexpr uint16_t WIDTH = 128;
+        static constexpr uint16_t HEIGHT = 64;
+        static constexpr uint16_t PAGES = HEIGHT / 8;
+
+        /// What flush is called for: an answer to the user (sent at once), or something which
+        /// changes by itself, like a position or progress (at most every PERIODIC_MS).
+        enum class Update { now, periodic };
+        static constexpr uint32_t PERIODIC_MS = CONFIG_APP_DISPLAY_REFRESH_MS; // Kconfig
+
+        /// The panel and the font (the first one of CFB). False if there's no font.
+        bool init (const struct device *display);
+
+        void clear ();
+
+        /// Text from x, y being a multiple of 8. Clipped at the right edge.
+        void print (const char *text, uint16_t x, uint16_t y);
+
+        /// Sends what was drawn since. A periodic update which comes too early is held, the
+        /// next flush (of any kind) sends it.
+        void flush (Update update = Update::now);
+
+        /// Milliseconds until a held periodic update is due, UINT32_MAX if there's none.
+        uint32_t heldFor () const;
+
+        /// Bytes written to the panel so far, the commands not counted.
+        uint32_t bytesSent () const { return sent; }
+
+private:
+        using Page = std::array<uint8_t, WIDTH>;
+
+        const struct device *display{};
+        const uint8_t *font{};
+        uint8_t fontWidth{};
+        uint8_t firstChar{};
+        uint8_t lastChar{};
+        std::array<Page, PAGES> frame{};
+        std::array<Page, PAGES> panel{};
+        bool panelKnown{};
+        bool held{};
+        uint32_t lastFlush{};
+        uint32_t sent{};
+};
+
+} // namespace disp
@@ -8,7 +8,11 @@
 
 #include "sdCard.h"
 #include <ff.h>
+#include <cstdio>
+#include <cstring>
+#include <strings.h>
 #include <zephyr/fs/fs.h>
+#include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/storage/disk_access.h>
 
@@ -27,6 +31,17 @@ static struct fs_mount_t mp = {
  *  in ffconf.h
  */
 static const char *const disk_mount_pt = "/SD:";
+static const char *const disk_pdrv = "SD";
+
+/*
+ * Mounting happens in main (init) and then in the UI thread when the card is changed. The index
+ * is built from the UI thread only, the first time it's needed after every mount.
+ */
+K_MUTEX_DEFINE (mountMutex);
+static bool mounted;
+static atomic_t mountCount;
+static atomic_val_t indexedMount = -1;
+static sd::Index dirIndex;
 
 namespace sd {
 
@@ -37,7 +52,6 @@ void init ()
 {
         /* raw disk i/o */
         do {
-                static const char *disk_pdrv = "SD";
                 uint64_t memory_size_mb;
                 uint32_t block_count;
                 uint32_t block_size;
@@ -65,7 +79,11 @@ void init ()
 
         mp.mnt_point = disk_mount_pt;
 
+        k_mutex_lock (&mountMutex, K_FOREVER);
         int res = fs_mount (&mp);
+        mounted = (res == FR_OK);
+        atomic_inc (&mountCount);
+        k_mutex_unlock (&mountMutex);
 
         if (res == FR_OK) {
                 printk ("Disk mounted.\n");
@@ -118,4 +136,121 @@ int lsdir (const char *path)
         return res;
 }
 
-} // namespace sd
\ No newline at end of file
+/*--------------------------------------------------------------------------*/
+
+namespace {
+
+/**
+ * Remounts after the card was taken out (or failed). Unmounts if it's not there.
+ */
+bool checkMount ()
+{
+        k_mutex_lock (&mountMutex, K_FOREVER);
+        bool present = (disk_access_status (disk_pdrv) == DISK_STATUS_OK);
+
+        if (!present && mounted) {
+                fs_unmount (&mp);
+                mounted = false;
+                LOG_INF ("Card removed");
+        }
+
+        if (present && !mounted) {
+                mounted = (fs_mount (&mp) == FR_OK);
+                atomic_inc (&mountCount);
+        }
+
+        bool ret = mounted;
+        k_mutex_unlock (&mountMutex);
+        return ret;
+}
+
+/**
+ * Walks the root directory once. FatFS is used directly, because fs_readdir doesn't give the
+ * modification time. Directories, hidden and system files are skipped, jobs are just files. So
+ * are the cached estimates (sdEstimate.h).
+ */
+int buildIndex ()
+{
+        static FF_DIR dir;
+        static FILINFO info;
+        const char *path = disk_mount_pt + 1; // FatFS volumes have no leading slash.
+        int64_t start = k_uptime_get ();
+
+        dirIndex.clear ();
+        FRESULT res = f_opendir (&dir, path);
+
+        if (res != FR_OK) {
+                return res;
+        }
+
+        while ((res = f_readdir (&dir, &info)) == FR_OK && info.fname[0] != '\0') {
+                size_t const len = strlen (info.fname);
+                bool const estimate = len > 4 && strcasecmp (info.fname + len - 4, ".est") == 0;
+
+                if ((info.fattrib & (AM_DIR | AM_HID | AM_SYS)) == 0 && !estimate) {
+                        dirIndex.add (info.fname, info.fsize, info.fdate, info.ftime);
+                }
+        }
+
+        f_closedir (&dir);
+        dirIndex.sort ();
+
+        if (dirIndex.truncated ()) {
+                LOG_WRN ("Too many files, only %u indexed", unsigned (dirIndex.size ()));
+        }
+
+        LOG_INF ("%u files indexed in %d ms", unsigned (dirIndex.size ()), int (k_uptime_get () - start));
+        return res;
+}
+
+} // namespace
+
+/*--------------------------------------------------------------------------*/
+
+bool refreshIndex ()
+{
+        if (!checkMount ()) {
+                dirIndex.clear ();
+                indexedMount = -1;
+                return false;
+        }
+
+        atomic_val_t current = atomic_get (&mountCount);
+
+        if (indexedMount == current) {
+                return true;
+        }
+
+        if (int res = buildIndex (); res != FR_OK) {
+                LOG_ERR ("Error reading the card [%d]", res);
+                dirIndex.clear ();
+
+                // Probably gone. Next time it'll be remounted.
+                k_mutex_lock (&mountMutex, K_FOREVER);
+                fs_unmount (&mp);
+                mounted = false;
+                k_mutex_unlock (&mountMutex);
+                return false;
+        }
+
+        indexedMount = current;
+        return true;
+}
+
+/*--------------------------------------------------------------------------*/
+
+Index const &index () { return dirIndex; }
+
+/*--------------------------------------------------------------------------*/
+
+bool indexPath (size_t i, char *buf, size_t size)
+{
+        if (i >= dirIndex.size ()) {
+                return false;
+        }
+
+        int len = snprintf (buf, size, "%s/%s", disk_mount_pt, dirIndex.name (i));
+        return len > 0 && size_t (len) < size;
+}
+
+} // namespace sd
@@ -7,10 +7,26 @@
  ****************************************************************************/
 
 #pragma once
+#include "dirIndex.h"
+#include <cstddef>
 
 namespace sd {
 
 void init ();
 int lsdir (const char *path);
 
-} // namespace sd
\ No newline at end of file
+/// Files in the root directory of the card.
+using Index = DirIndex<256, 4096>;
+
+/**
+ * Makes the index up to date: it is rebuilt after the card was (re)mounted, otherwise left
+ * alone. Cheap enough to call every time the file list is shown. Returns false if there's no
+ * card. The index is meant to be used by one thread only (the UI one).
+ */
+bool refreshIndex ();
+Index const &index ();
+
+/// Full path of the i-th file of the index, to be passed to fs_open.
+bool indexPath (size_t i, char *buf, size_t size);
+
+} // namespace sd
@@ -0,0 +1,275 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#include "sdEstimate.h"
+#include "gcz.h"
+#include "grbl/report.h"
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <ff.h>
+#include <strings.h>
+#include <zephyr/fs/fs.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER (sdEstimate);
+
+/*
+ * estimator_run_file is called by GRBL (`$E`) in its main thread, the machine being idle. The
+ * file is read in small pieces and fed to the estimator, .gcz ones through a decoder of their
+ * own (a job may be running, waiting for the card, with its decoder in the middle of a file).
+ * A successful estimate is written to <path>.est together with what it depends on: the size
+ * and the modification time of the file, and estimator_settings_hash. The last result (failed
+ * ones as well) is also kept in RAM for the UI to poll.
+ */
+
+namespace sd {
+namespace {
+
+        constexpr size_t MAX_PATH = 96;
+        constexpr std::array<char, 4> MAGIC = {'E', 'S', 'T', '1'};
+        constexpr char SUFFIX[] = ".est";
+
+        /// What a cached estimate is valid for.
+        struct Fingerprint {
+                uint32_t size{};
+                uint16_t date{};
+                uint16_t time{};
+                uint32_t settingsHash{};
+
+                bool operator== (Fingerprint const &o) const
+                {
+                        return size == o.size && date == o.date && time == o.time && settingsHash == o.settingsHash;
+                }
+        };
+
+        /// The .est file.
+        struct Record {
+                std::array<char, 4> magic{};
+                Fingerprint fingerprint{};
+                estimate_t estimate{};
+        };
+
+        struct Last {
+                std::array<char, MAX_PATH> path{};
+                Fingerprint fingerprint{};
+                estimate_t estimate{};
+        };
+
+        K_MUTEX_DEFINE (lastMutex);
+        Last last; // Guarded by lastMutex.
+        K_MUTEX_DEFINE (infoMutex);
+        gcz::Decoder decoder; // The window is 4 kB, it's not on any stack.
+        std::array<uint8_t, 1024> buffer;
+
+        bool fingerprint (const char *path, Fingerprint &fp)
+        {
+                static FILINFO info; // Has a long name buffer, too big for the UI stack. Guarded by infoMutex.
+
+                if (path[0] != '/') {
+                        return false;
+                }
+
+                // FatFS is used directly, because fs_stat doesn't give the modification time.
+                k_mutex_lock (&infoMutex, K_FOREVER);
+                bool ok = f_stat (path + 1, &info) == FR_OK;
+                fp = Fingerprint{uint32_t (info.fsize), info.fdate, info.ftime, estimator_settings_hash ()};
+                k_mutex_unlock (&infoMutex);
+                return ok;
+        }
+
+        bool cachePath (const char *path, std::array<char, MAX_PATH + sizeof (SUFFIX)> &cache)
+        {
+                return snprintf (cache.data (), cache.size (), "%s%s", path, SUFFIX) < int (cache.size ());
+        }
+
+        bool readCache (const char *path, Fingerprint const &fp, estimate_t &estimate)
+        {
+                std::array<char, MAX_PATH + sizeof (SUFFIX)> cache{};
+                fs_file_t file;
+                fs_file_t_init (&file);
+
+                if (!cachePath (path, cache) || fs_open (&file, cache.data (), FS_O_READ) != 0) {
+                        return false;
+                }
+
+                Record record;
+                bool ok = fs_read (&file, &record, sizeof (record)) == sizeof (record) && record.magic == MAGIC && record.fingerprint == fp;
+                fs_close (&file);
+
+                if (ok) {
+                        estimate = record.estimate;
+                }
+
+                return ok;
+        }
+
+        void writeCache (const char *path, Fingerprint const &fp, estimate_t const &estimate)
+        {
+                std::array<char, MAX_PATH + sizeof (SUFFIX)> cache{};
+                fs_file_t file;
+                fs_file_t_init (&file);
+
+                if (!cachePath (path, cache) || fs_open (&file, cache.data (), FS_O_CREATE | FS_O_WRITE) != 0) {
+                        LOG_WRN ("Can't write %s", cache.data ());
+                        return;
+                }
+
+                Record record{MAGIC, fp, estimate};
+
+                if (fs_truncate (&file, 0) != 0 || fs_write (&file, &record, sizeof (record)) != sizeof (record)) {
+                        LOG_WRN ("Can't write %s", cache.data ());
+                }
+
+                fs_close (&file);
+        }
+
+        void remember (const char *path, Fingerprint const &fp, estimate_t const &estimate)
+        {
+                k_mutex_lock (&lastMutex, K_FOREVER);
+                strncpy (last.path.data (), path, last.path.size () - 1);
+                last.fingerprint = fp;
+                last.estimate = estimate;
+                k_mutex_unlock (&lastMutex);
+        }
+
+        /// Whole file through the estimator. False if it can't be read.
+        bool run (const char *path, estimate_t &estimate)
+        {
+                fs_file_t file;
+                fs_file_t_init (&file);
+
+                if (int ret = fs_open (&file, path, FS_O_READ); ret != 0) {
+                        LOG_ERR ("Can't open %s (%d)", path, ret);
+                        return false;
+                }
+
+                if (uint8_t status = estimator_begin (); status != STATUS_OK) {
+                        fs_close (&file);
+                        estimate = estimate_t{};
+                        estimate.status = status;
+                        return true;
+                }
+
+                size_t const len = strlen (path);
+                bool const compressed = len > 4 && strcasecmp (path + len - 4, ".gcz") == 0;
+                decoder.reset ();
+                bool more = true;
+                bool readOk = true;
+
+                while (more) {
+                        ssize_t n = fs_read (&file, buffer.data (), buffer.size ());
+
+                        if (n <= 0) {
+                                readOk = (n == 0);
+                                break;
+                        }
+
+                        if (!compressed) {
+                                more = estimator_feed (buffer.data (), n);
+                                continue;
+                        }
+
+                        gcz::Status status = decoder.feed (buffer.data (), n, [&more] (uint8_t c) { more = more && estimator_feed (&c, 1); });
+                        readOk = (status == gcz::Status::ok || status == gcz::Status::finished);
+                        more = more && readOk;
+                }
+
+                // A .gcz which stopped early (a failed line) is fine, a truncated one is not.
+                if (compressed && readOk && more && decoder.status () != gcz::Status::finished) {
+                        readOk = false;
+                }
+
+                estimator_end (&estimate);
+                fs_close (&file);
+
+                if (!readOk) {
+                        LOG_ERR ("Can't read %s", path);
+                }
+
+                return readOk;
+        }
+
+} // namespace
+
+/****************************************************************************/
+
+bool lastEstimate (const char *path, estimate_t &estimate)
+{
+        k_mutex_lock (&lastMutex, K_FOREVER);
+        bool found = strcmp (last.path.data (), path) == 0 && last.fingerprint.settingsHash == estimator_settings_hash ();
+
+        if (found) {
+                estimate = last.estimate;
+        }
+
+        k_mutex_unlock (&lastMutex);
+        return found;
+}
+
+/****************************************************************************/
+
+bool cachedEstimate (const char *path, estimate_t &estimate)
+{
+        Fingerprint fp;
+
+        if (!fingerprint (path, fp)) {
+                return false;
+        }
+
+        k_mutex_lock (&lastMutex, K_FOREVER);
+        bool found = strcmp (last.path.data (), path) == 0 && last.fingerprint == fp;
+
+        if (found) {
+                estimate = last.estimate;
+        }
+
+        k_mutex_unlock (&lastMutex);
+        return found || readCache (path, fp, estimate);
+}
+
+} // namespace sd
+
+/****************************************************************************/
+
+extern "C" uint8_t estimator_run_file (const char *path, estimate_t *estimate)
+{
+        using namespace sd;
+        Fingerprint fp;
+
+        if (strlen (path) >= MAX_PATH || !fingerprint (path, fp)) {
+                return STATUS_FILE_READ;
+        }
+
+        if (readCache (path, fp, *estimate)) {
+                remember (path, fp, *estimate);
+                return estimate->status;
+        }
+
+        int64_t start = k_uptime_get ();
+
+        if (!run (path, *estimate)) {
+                return STATUS_FILE_READ;
+        }
+
+        if (estimate->status == STATUS_IDLE_ERROR || estimate->status == STATUS_ESTIMATE_ABORTED) { // Not started, or not finished.
+                return estimate->status;
+        }
+
+        LOG_INF ("%s: %u lines, %u s, estimated in %d ms", path, unsigned (estimate->lines), unsigned (estimate->seconds),
+                 int (k_uptime_get () - start));
+
+        remember (path, fp, *estimate);
+
+        if (estimate->status == STATUS_OK) {
+                writeCache (path, fp, *estimate);
+        }
+
+        return estimate->status;
+}
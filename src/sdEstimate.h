@@ -0,0 +1,25 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#pragma once
+#include "grbl/estimator.h"
+
+/*
+ * Time and bounds of the jobs on the card. GRBL computes them for `$E=path` (grbl/estimator.h),
+ * this module reads the file for it and caches the result next to it (job.ngc.est), so a job is
+ * estimated once as long as the file and the settings stay the same. See sdEstimate.cc.
+ */
+namespace sd {
+
+/// The result of the last `$E` if it was for this path, never touches the card. For polling.
+bool lastEstimate (const char *path, estimate_t &estimate);
+
+/// The last result, or the cached one if it's still valid. Reads the card (only the .est file).
+bool cachedEstimate (const char *path, estimate_t &estimate);
+
+} // namespace sd
@@ -0,0 +1,608 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#include "sdJob.h"
+#include "gcz.h"
+#include "sdEstimate.h"
+#include "sdJournal.h"
+#include "grbl/protocol.h"
+#include "grbl/serial.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <ff.h>
+#include <strings.h>
+#include <zephyr/fs/fs.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+
+/*
+ * Two threads. The reader reads the file in CHUNK_SIZE chunks into one of the two buffers
+ * while the feeder splits the other one into lines and hands them to GRBL through the SD
+ * channel (serial_channel_write), many lines in one go. Chunks are multiples of the sector
+ * size at aligned offsets, so FatFS reads them straight into the buffers without copying
+ * them through its sector window.
+ *
+ * Backpressure: GRBL takes the next line only when the previous one found room in the
+ * planner. Until then the SD channel stays full and the feeder waits, so the card is read
+ * exactly as fast as the machine moves, with the two chunks, the channel and the planner
+ * buffered ahead.
+ *
+ * sphere.ngc is 36.8 kB for ~3 minutes of plotting, about 200 B/s, while the card gives tens
+ * of kB/s even at 500 kHz. cardWaits and starved in JobStats tell if that ever stops being
+ * true: the planner ran dry while the feeder waited for the card.
+ *
+ * Progress is journaled (sdJournal.cc). A resumed job starts with the lines restoring the
+ * state (resume_state_line), then the file goes on from the journaled offset: a plain file
+ * is seeked to the chunk containing it, a .gcz is decoded from the start and the data before
+ * the offset dropped.
+ */
+
+LOG_MODULE_REGISTER (sdJob);
+
+extern "C" uint8_t plan_get_block_buffer_count ();
+
+namespace sd {
+namespace {
+
+constexpr size_t CHUNK_SIZE = 4096;                  // 8 sectors.
+constexpr size_t BATCH_SIZE = SD_RX_BUFFER_SIZE / 2; // Lines written to the channel at once.
+constexpr size_t MAX_LINE = LINE_BUFFER_SIZE;        // What GRBL takes, see LineAssembler::compact.
+constexpr int STACK_SIZE = 2048;
+constexpr int PRIORITY = 12; // Above the GRBL main thread. Both threads mostly wait.
+
+struct Chunk {
+        alignas (4) std::array<uint8_t, CHUNK_SIZE> data;
+        ssize_t len{}; // 0 at the end of the file, negative errno on an error.
+};
+
+std::array<Chunk, 2> chunks;
+K_SEM_DEFINE (freeChunks, 2, 2);
+K_SEM_DEFINE (fullChunks, 0, 2);
+K_SEM_DEFINE (readerStart, 0, 1);
+K_SEM_DEFINE (feederStart, 0, 1);
+
+fs_file_t file;
+bool compressed{};
+bool resuming{};
+journal::Interrupted resumed; // Valid if resuming.
+gcz::Decoder decoder; // The window is 4 kB, it's not on any stack.
+
+atomic_t running;
+atomic_t stopRequested;
+atomic_t aborted; // GRBL reset or alarm.
+atomic_t replies;
+atomic_t errors;
+uint32_t startedAt; // Set before the threads are started.
+
+K_MUTEX_DEFINE (statsMutex);
+JobStats stats; // Written only by the feeder thread, always with the mutex held.
+
+void setStatus (int status)
+{
+        k_mutex_lock (&statsMutex, K_FOREVER);
+        stats.status = status;
+        k_mutex_unlock (&statsMutex);
+}
+
+/*--------------------------------------------------------------------------*/
+
+/**
+ * Serial sink. Replies to the SD lines and the async output. Runs in the GRBL main thread.
+ */
+void replySinkWrite (const uint8_t *data, uint32_t len, bool eol, void * /* userData */)
+{
+        static bool fragment{};
+        bool const lineStart = !fragment;
+        fragment = !eol;
+
+        if (!lineStart || atomic_get (&running) == 0) {
+                return;
+        }
+
+        auto startsWith = [data, len] (const char *prefix) {
+                size_t n = strlen (prefix);
+                return len >= n && memcmp (data, prefix, n) == 0;
+        };
+
+        if (startsWith ("ok")) {
+                journal::lineDone (atomic_inc (&replies) + 1);
+        }
+        else if (startsWith ("error:")) {
+                atomic_inc (&errors);
+                atomic_inc (&replies);
+        }
+        else if (startsWith ("ALARM:") || startsWith ("Grbl ")) {
+                atomic_set (&aborted, 1); // The lines in the channel are gone.
+        }
+        else if (startsWith ("[MSG:RX overrun]")) {
+                atomic_inc (&errors); // Bytes of the job were lost, a line went out damaged.
+        }
+}
+
+/*--------------------------------------------------------------------------*/
+
+bool shouldStop () { return atomic_get (&stopRequested) != 0 || atomic_get (&aborted) != 0 || atomic_get (&errors) != 0; }
+
+/**
+ * Collects lines and writes them to the SD channel in batches.
+ */
+class LineAssembler {
+public:
+        void reset () { resumeAt (0, 0, 0); }
+
+        /// Bytes of the file (decompressed) start at `from`, the ones before `to` are dropped.
+        /// `lines` were executed before.
+        void resumeAt (uint32_t from, uint32_t to, uint32_t lines)
+        {
+                batchLen = lineLen = 0;
+                compacted = cut = false;
+                comment = 0;
+                offset = from;
+                skipTo = to;
+                fileLines = batchFileLines = lines;
+                batchOffset = to;
+        }
+
+        /// False when the job has to stop.
+        bool feed (uint8_t c)
+        {
+                if (offset++ < skipTo) {
+                        return true;
+                }
+
+                if (c == '\n' || c == '\r') {
+                        return endLine (true);
+                }
+
+                if (!compacted && lineLen < MAX_LINE) {
+                        line[lineLen++] = c;
+                        return true;
+                }
+
+                if (!compacted) {
+                        compact ();
+                }
+
+                keep (c);
+                return true;
+        }
+
+        /// The last line may have no line feed.
+        bool finish () { return endLine (true) && flush (); }
+
+        /// A line not from the file.
+        bool sendLine (const char *text)
+        {
+                lineLen = std::min (strlen (text), MAX_LINE);
+                memcpy (line.data (), text, lineLen);
+                return endLine (false);
+        }
+
+        /// Sends the batch. Waits for room in the channel, that is for the planner.
+        bool flush ()
+        {
+                if (batchLen == 0) {
+                        return true;
+                }
+
+                batch[batchLen] = '\0';
+
+                while (serial_channel_available (SERIAL_CHANNEL_SD) < batchLen) {
+                        if (shouldStop ()) {
+                                return false;
+                        }
+
+                        k_msleep (1);
+                }
+
+                journal::batchSent (stats.lines + batchLines, batchFileLines, batchOffset);
+                serial_channel_write (SERIAL_CHANNEL_SD, batch.data ());
+                k_mutex_lock (&statsMutex, K_FOREVER);
+                stats.bytes += batchLen;
+                stats.lines += batchLines;
+                k_mutex_unlock (&statsMutex);
+                batchLen = batchLines = 0;
+                return !shouldStop ();
+        }
+
+private:
+        /**
+         * A line longer than MAX_LINE loses its white space and comments, the way GRBL drops them
+         * (protocol.c). What's still too long is cut, but then GRBL gets MAX_LINE characters and
+         * reports an overflow, so the cut line is never executed.
+         */
+        void compact ()
+        {
+                size_t const len = lineLen;
+                lineLen = 0;
+                compacted = true;
+
+                for (size_t i = 0; i < len; ++i) {
+                        keep (line[i]);
+                }
+        }
+
+        void keep (uint8_t c)
+        {
+                if (comment != 0) {
+                        comment = (comment == '(' && c == ')') ? 0 : comment;
+                }
+                else if (c == '(' || c == ';') {
+                        comment = c;
+                }
+                else if (c <= ' ' || c == '/') {
+                        // White space and block delete.
+                }
+                else if (lineLen < MAX_LINE) {
+                        line[lineLen++] = c;
+                }
+                else {
+                        cut = true;
+                }
+        }
+
+        bool endLine (bool fromFile)
+        {
+                // Empty, or the second half of a "\r\n". A compacted one is sent even if empty
+                // (GRBL says ok), it was counted by the estimate.
+                bool const empty = lineLen == 0 && !compacted;
+
+                if (cut) {
+                        LOG_WRN ("Line %u is too long", fileLines + 1);
+                        k_mutex_lock (&statsMutex, K_FOREVER);
+                        ++stats.truncated;
+                        k_mutex_unlock (&statsMutex);
+                }
+
+                compacted = cut = false;
+                comment = 0;
+
+                if (empty) {
+                        return true;
+                }
+
+                if (batchLen + lineLen + 1 > BATCH_SIZE && !flush ()) {
+                        return false;
+                }
+
+                memcpy (&batch[batchLen], line.data (), lineLen);
+                batchLen += lineLen;
+                batch[batchLen++] = '\n'; // Exactly one reply per line.
+                ++batchLines;
+                fileLines += fromFile;
+                batchFileLines = fileLines;
+                batchOffset = std::max (offset, skipTo);
+                lineLen = 0;
+                return true;
+        }
+
+        std::array<char, MAX_LINE> line;
+        size_t lineLen{};
+        bool compacted{};  // The line was too long, white space and comments are dropped.
+        bool cut{};        // And still too long.
+        uint8_t comment{}; // '(' or ';' while in one, when compacted.
+        std::array<char, BATCH_SIZE + 1> batch;
+        size_t batchLen{};
+        uint32_t batchLines{};
+        uint32_t offset{};         // Of the next byte fed.
+        uint32_t skipTo{};         // Bytes before are not sent.
+        uint32_t fileLines{};      // Sent from the file.
+        uint32_t batchFileLines{}; // fileLines and offset after the last line in the batch.
+        uint32_t batchOffset{};
+};
+
+LineAssembler assembler;
+
+/*--------------------------------------------------------------------------*/
+
+void readerThread (void *, void *, void *)
+{
+        while (true) {
+                k_sem_take (&readerStart, K_FOREVER);
+                size_t i = 0;
+
+                while (true) {
+                        k_sem_take (&freeChunks, K_FOREVER);
+                        Chunk &chunk = chunks[i];
+                        ssize_t const len = shouldStop () ? 0 : fs_read (&file, chunk.data.data (), CHUNK_SIZE);
+                        chunk.len = len;
+                        i = (i + 1) % chunks.size ();
+
+                        if (len <= 0) {
+                                fs_close (&file); // Before the feeder ends the job and the file can be reopened.
+                        }
+
+                        k_sem_give (&fullChunks);
+
+                        if (len <= 0) {
+                                break;
+                        }
+                }
+        }
+}
+
+K_THREAD_DEFINE (sdReader, STACK_SIZE, readerThread, NULL, NULL, NULL, PRIORITY, 0, 0);
+
+/*--------------------------------------------------------------------------*/
+
+/// Feeds one chunk to the assembler, through the decoder for .gcz files.
+bool feedChunk (Chunk const &chunk)
+{
+        if (!compressed) {
+                for (ssize_t j = 0; j < chunk.len; ++j) {
+                        if (!assembler.feed (chunk.data[j])) {
+                                return false;
+                        }
+                }
+
+                return true;
+        }
+
+        bool ok = true;
+        gcz::Status status = decoder.feed (chunk.data.data (), chunk.len, [&ok] (uint8_t c) { ok = ok && assembler.feed (c); });
+
+        if (status != gcz::Status::ok && status != gcz::Status::finished) {
+                LOG_ERR ("Damaged .gcz file (%d)", int (status));
+                setStatus (-EILSEQ);
+                return false;
+        }
+
+        return ok;
+}
+
+void feederThread (void *, void *, void *)
+{
+        static serial_sink replySink{.write = replySinkWrite, .channel = SERIAL_CHANNEL_SD};
+        serial_sink_register (&replySink);
+
+        while (true) {
+                k_sem_take (&feederStart, K_FOREVER);
+                uint32_t const start = k_uptime_get_32 ();
+                size_t i = 0;
+                bool sending = true;
+                char preamble[64];
+
+                for (uint8_t n = 0; resuming && sending && resume_state_line (&resumed.state, n, preamble, sizeof (preamble)); ++n) {
+                        sending = assembler.sendLine (preamble);
+                }
+
+                // Until the end of the file. Chunks are taken even after a stop, the reader waits for them.
+                while (true) {
+                        if (k_sem_take (&fullChunks, K_NO_WAIT) != 0) {
+                                if (sending && stats.lines > 0) { // Not at the start, GRBL had nothing to wait for yet.
+                                        k_mutex_lock (&statsMutex, K_FOREVER);
+                                        ++stats.cardWaits;
+                                        stats.starved += (plan_get_block_buffer_count () == 0);
+                                        k_mutex_unlock (&statsMutex);
+                                }
+
+                                k_sem_take (&fullChunks, K_FOREVER);
+                        }
+
+                        Chunk const &chunk = chunks[i];
+                        i = (i + 1) % chunks.size ();
+                        ssize_t const len = chunk.len;
+
+                        if (len < 0) {
+                                LOG_ERR ("Read error %d", int (len));
+                                setStatus (len);
+                        }
+
+                        if (sending && len > 0) {
+                                k_mutex_lock (&statsMutex, K_FOREVER);
+                                stats.fileBytes += len;
+                                k_mutex_unlock (&statsMutex);
+                                sending = feedChunk (chunk);
+                        }
+
+                        k_sem_give (&freeChunks);
+
+                        if (len <= 0) {
+                                break;
+                        }
+                }
+
+                if (sending && stats.status == 0) {
+                        sending = assembler.finish ();
+
+                        if (compressed && decoder.status () != gcz::Status::finished) {
+                                LOG_ERR ("Truncated .gcz file");
+                                setStatus (-EILSEQ);
+                        }
+                }
+
+                // Every line sent gets its reply, unless GRBL was reset.
+                while (uint32_t (atomic_get (&replies)) < stats.lines && atomic_get (&aborted) == 0) {
+                        k_msleep (10);
+                }
+
+                k_mutex_lock (&statsMutex, K_FOREVER);
+                stats.replies = atomic_get (&replies);
+                stats.errors = atomic_get (&errors);
+                stats.elapsedMs = k_uptime_get_32 () - start;
+                JobStats const s = stats;
+                k_mutex_unlock (&statsMutex);
+
+                bool const completed = sending && s.errors == 0 && s.status == 0 && atomic_get (&aborted) == 0 && atomic_get (&stopRequested) == 0;
+                uint32_t const ms = std::max (s.elapsedMs, uint32_t (1));
+                LOG_INF ("Job %s: %u lines (%u too long), %u bytes read (%u sent) in %u ms, %u B/s, %u lines/s, %u card waits, planner starved %u times",
+                         completed ? "done" : "stopped",
+                         s.lines, s.truncated, s.fileBytes, s.bytes, s.elapsedMs, uint32_t (uint64_t (s.fileBytes) * 1000 / ms),
+                         uint32_t (uint64_t (s.lines) * 1000 / ms), s.cardWaits, s.starved);
+
+                journal::jobEnded (completed);
+                atomic_set (&running, 0);
+        }
+}
+
+K_THREAD_DEFINE (sdFeeder, STACK_SIZE, feederThread, NULL, NULL, NULL, PRIORITY, 0, 0);
+
+/*--------------------------------------------------------------------------*/
+
+bool start (const char *path, journal::Interrupted const *resume)
+{
+        if (!atomic_cas (&running, 0, 1)) {
+                LOG_WRN ("A job is running already");
+                return false;
+        }
+
+        // fs_stat has the size only, a resume checks the date and time too. Static, the long name
+        // buffer is too big for the UI stack. Only one caller gets past the running check.
+        static FILINFO info;
+        fs_file_t_init (&file);
+
+        if (int ret = (path[0] == '/') ? f_stat (path + 1, &info) : FR_INVALID_NAME; ret != FR_OK) {
+                LOG_ERR ("Can't open %s (%d)", path, ret);
+                atomic_set (&running, 0);
+                return false;
+        }
+
+        uint32_t const size = info.fsize;
+
+        if (resume != nullptr && (size != resume->size || info.fdate != resume->date || info.ftime != resume->time || resume->offset > size)) {
+                LOG_ERR ("%s was changed since, it can't be resumed", path);
+                atomic_set (&running, 0);
+                return false;
+        }
+
+        if (int ret = fs_open (&file, path, FS_O_READ); ret != 0) {
+                LOG_ERR ("Can't open %s (%d)", path, ret);
+                atomic_set (&running, 0);
+                return false;
+        }
+
+        size_t const len = strlen (path);
+        compressed = len > 4 && strcasecmp (path + len - 4, ".gcz") == 0;
+        decoder.reset ();
+        assembler.reset ();
+        resuming = resume != nullptr;
+
+        if (resuming) {
+                resumed = *resume;
+                // A .gcz has to be decoded from the start. The offset is in the decoded data.
+                uint32_t const from = compressed ? 0 : resume->offset / CHUNK_SIZE * CHUNK_SIZE;
+
+                if (int ret = fs_seek (&file, from, FS_SEEK_SET); ret != 0) {
+                        LOG_ERR ("Can't seek %s (%d)", path, ret);
+                        fs_close (&file);
+                        atomic_set (&running, 0);
+                        return false;
+                }
+
+                assembler.resumeAt (from, resume->offset, resume->line);
+        }
+
+        JobStats fresh{};
+        fresh.fileSize = size;
+
+        if (resuming) {
+                fresh.firstByte = compressed ? 0 : resume->offset / CHUNK_SIZE * CHUNK_SIZE;
+                fresh.firstLine = resume->line;
+        }
+
+        if (estimate_t e; cachedEstimate (path, e) && e.status == 0) {
+                fresh.estimatedLines = e.lines;
+                fresh.estimatedSeconds = e.seconds;
+        }
+
+        k_mutex_lock (&statsMutex, K_FOREVER);
+        stats = fresh;
+        startedAt = k_uptime_get_32 ();
+        k_mutex_unlock (&statsMutex);
+
+        atomic_clear (&stopRequested);
+        atomic_clear (&aborted);
+        atomic_clear (&replies);
+        atomic_clear (&errors);
+
+        journal::jobStarted (path, size, info.fdate, info.ftime, resuming);
+        LOG_INF ("%s %s", resuming ? "Resuming" : "Starting", path);
+        k_sem_give (&readerStart);
+        k_sem_give (&feederStart);
+        return true;
+}
+
+} // namespace
+
+/*--------------------------------------------------------------------------*/
+
+bool startJob (const char *path) { return start (path, nullptr); }
+
+/*--------------------------------------------------------------------------*/
+
+bool resumeJob ()
+{
+        journal::Interrupted job;
+
+        if (!journal::interrupted (job)) {
+                LOG_WRN ("No job to resume");
+                return false;
+        }
+
+        LOG_INF ("Resuming after line %u", job.line);
+        return start (job.path.data (), &job);
+}
+
+/*--------------------------------------------------------------------------*/
+
+void stopJob () { atomic_set (&stopRequested, 1); }
+
+/*--------------------------------------------------------------------------*/
+
+bool jobRunning () { return atomic_get (&running) != 0; }
+
+/*--------------------------------------------------------------------------*/
+
+JobStats jobStats ()
+{
+        k_mutex_lock (&statsMutex, K_FOREVER);
+        JobStats s = stats;
+        k_mutex_unlock (&statsMutex);
+
+        if (atomic_get (&running) != 0) {
+                s.replies = atomic_get (&replies);
+                s.errors = atomic_get (&errors);
+                s.elapsedMs = k_uptime_get_32 () - startedAt;
+        }
+
+        return s;
+}
+
+/*--------------------------------------------------------------------------*/
+
+float jobProgress (JobStats const &s, float &secondsLeft)
+{
+        float done{};
+
+        if (s.estimatedLines > 0) {
+                // Both count the lines with anything in them (see estimate_t). The replies of a
+                // resumed job include the lines restoring the state, a few.
+                done = float (s.firstLine + s.replies) / float (s.estimatedLines);
+        }
+        else if (s.fileSize > 0) {
+                done = float (s.firstByte + s.fileBytes) / float (s.fileSize);
+        }
+
+        done = std::min (done, 1.0F);
+
+        if (s.estimatedLines > 0) {
+                secondsLeft = s.estimatedSeconds * (1.0F - done);
+        }
+        else if (done > 0.01F) {
+                secondsLeft = s.elapsedMs / 1000.0F * (1.0F - done) / done;
+        }
+        else {
+                secondsLeft = -1;
+        }
+
+        return done;
+}
+
+} // namespace sd
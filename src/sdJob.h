@@ -0,0 +1,55 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#pragma once
+#include <cstdint>
+
+namespace sd {
+
+/**
+ * Numbers of the last (or the current) job.
+ */
+struct JobStats {
+        uint32_t fileBytes{};  /// Read from the card.
+        uint32_t bytes{};      /// Sent to GRBL (more than fileBytes for a .gcz).
+        uint32_t lines{};      /// Sent to GRBL.
+        uint32_t truncated{};  /// Too long for GRBL even without white space and comments (error:11).
+        uint32_t replies{};    /// 'ok's and errors received.
+        uint32_t errors{};     /// The job stops at the first one.
+        uint32_t elapsedMs{};  /// From the start to the last reply.
+        uint32_t cardWaits{};  /// Times the lines ran out before the next chunk was read.
+        uint32_t starved{};    /// Out of those, times the planner was empty as well.
+        int status{};          /// 0 or the negative errno of the card.
+        uint32_t fileSize{};   /// Of the file on the card.
+        uint32_t firstByte{};  /// Where the reading started, not 0 for a resumed plain file.
+        uint32_t firstLine{};  /// Lines executed before, by the interrupted job.
+        uint32_t estimatedLines{};  /// Of the whole file if the estimate was known at the start, or 0.
+        float estimatedSeconds{};
+};
+
+/// Runs a g-code file (.gcz ones are decompressed on the fly). False if a job is running
+/// already or the file can't be opened.
+bool startJob (const char *path);
+
+/// Continues the job cut short by a power loss (or stopped) after its last journaled line,
+/// see sdJournal.h. False if there's none, or the file was changed since.
+bool resumeJob ();
+
+/// Sends no more lines. The ones GRBL has already got are still executed.
+void stopJob ();
+
+bool jobRunning ();
+
+/// While the job runs elapsedMs is the time so far.
+JobStats jobStats ();
+
+/// How much of the job is done, 0 to 1, and the seconds left (negative if unknown). By the
+/// lines executed if the file was estimated, otherwise by the bytes read (ahead of the machine).
+float jobProgress (JobStats const &s, float &secondsLeft);
+
+} // namespace sd
@@ -0,0 +1,335 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#include "sdJournal.h"
+#include "grbl/eeprom.h"
+#include <algorithm>
+#include <cstring>
+#include <zephyr/fs/nvs.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <nvs_priv.h> // The NVS internals, from the Zephyr sources (see CMakeLists.txt).
+
+/*
+ * Every PERIOD_MS the journal thread asks for a snapshot. The serial sink takes it in the GRBL
+ * main thread right after the 'ok' of the last line of a batch, since for those the feeder
+ * told the file offset (batchSent). The snapshot is the parser state after that line, so it's
+ * ahead of the machine by what's in the planner. It's written only once the planner has
+ * executed it (resume_state_executed), then the position in it is where the tool really is.
+ *
+ * Writing to the flash stops the CPU, the code runs from the same flash. A write of a record
+ * takes tens of µs, which the steppers don't notice, but when the NVS sector is full the next
+ * write erases one, which takes hundreds of ms. So the sector is changed at the start of a job
+ * (while the machine is idle) if less than RESERVE of it is free, and in the middle of a job
+ * records which don't fit are dropped. 3/4 of a 16 kB sector is ~170 records, 85 minutes of
+ * journal at 30 s.
+ */
+
+LOG_MODULE_REGISTER (sdJournal);
+
+extern "C" uint8_t plan_get_block_buffer_count ();
+extern "C" uint8_t mc_get_queued_motion_count ();
+
+namespace sd::journal {
+namespace {
+
+constexpr uint16_t JOB_ID = 0x100;
+constexpr uint16_t PROGRESS_ID = 0x101;
+constexpr uint16_t FILLER_ID = 0x102;
+constexpr int PERIOD_MS = 30000;
+constexpr size_t MAX_MARKS = 16; // Batches in flight, the SD channel holds 2 or 3.
+constexpr int STACK_SIZE = 1024;
+constexpr int PRIORITY = 14; // The lowest, below GRBL.
+
+// NVS addresses are sector << ADDR_SECT_SHIFT | offset, every entry takes an ATE.
+constexpr uint32_t ATE_SIZE = sizeof (nvs_ate);
+static_assert (ADDR_OFFS_MASK + 1 == 1U << ADDR_SECT_SHIFT, "hasRoom and makeRoom expect the NVS address layout");
+
+struct JobRecord {
+        std::array<char, MAX_PATH> path;
+        uint32_t size;
+        uint16_t date;
+        uint16_t time;
+};
+
+struct ProgressRecord {
+        uint32_t line;
+        uint32_t offset;
+        resume_state_t state;
+};
+
+struct Mark {
+        uint32_t reply;
+        uint32_t line;
+        uint32_t offset;
+};
+
+/*
+ * Marks are a single producer (the feeder), single consumer (the sink) queue. Head and tail
+ * count from the start of the job, the index is modulo MAX_MARKS.
+ */
+std::array<Mark, MAX_MARKS> marks;
+atomic_t marksHead;
+atomic_t marksTail;
+
+atomic_t active;
+atomic_t wanted;         // The journal thread waits for a snapshot.
+ProgressRecord snapshot; // Written by the sink when wanted is set, then handed over with snapshotTaken.
+K_SEM_DEFINE (snapshotTaken, 0, 1);
+K_SEM_DEFINE (started, 0, 1);
+K_SEM_DEFINE (wake, 0, 1);
+
+/// Free bytes in the current sector, minus the ATEs NVS keeps for itself. Reads the NVS write
+/// pointers, so only with eeprom_nvs_lock held.
+bool hasRoom (nvs_fs *fs, size_t len)
+{
+        uint32_t free = (fs->ate_wra & ADDR_OFFS_MASK) - (fs->data_wra & ADDR_OFFS_MASK);
+        return free >= len + 4 * ATE_SIZE;
+}
+
+/**
+ * Fills the rest of the sector, so NVS moves on to the next one (and erases the oldest) now,
+ * and not in the middle of the job.
+ */
+void makeRoom (nvs_fs *fs)
+{
+        if (hasRoom (fs, fs->sector_size * 3 / 4)) {
+                return;
+        }
+
+        std::array<uint8_t, 64> filler{};
+        uint32_t const sector = fs->ate_wra >> ADDR_SECT_SHIFT;
+        uint32_t const maxWrites = fs->sector_size / filler.size () + 1;
+
+        for (uint32_t i = 0; (fs->ate_wra >> ADDR_SECT_SHIFT) == sector && i < maxWrites; ++i) {
+                filler.front () = i; // Identical data wouldn't be written.
+
+                if (nvs_write (fs, FILLER_ID, filler.data (), filler.size ()) < 0) {
+                        break;
+                }
+        }
+
+        nvs_delete (fs, FILLER_ID);
+        LOG_INF ("NVS sector changed");
+}
+
+/*--------------------------------------------------------------------------*/
+
+void write (ProgressRecord const &record)
+{
+        static bool warned{};
+        eeprom_nvs_lock ();
+        nvs_fs *fs = eeprom_nvs ();
+
+        if (fs != nullptr && atomic_get (&active) != 0) {
+                if (hasRoom (fs, sizeof (record))) {
+                        nvs_write (fs, PROGRESS_ID, &record, sizeof (record));
+                        warned = false;
+                }
+                else if (!warned) {
+                        LOG_WRN ("NVS sector full, journal stopped at line %u", record.line);
+                        warned = true;
+                }
+        }
+
+        eeprom_nvs_unlock ();
+}
+
+/// Waits, but not past the end of the job.
+template <typename Predicate> bool waitWhileActive (Predicate predicate)
+{
+        while (atomic_get (&active) != 0) {
+                if (predicate ()) {
+                        return true;
+                }
+
+                k_msleep (20);
+        }
+
+        return false;
+}
+
+/*--------------------------------------------------------------------------*/
+
+void journalThread (void *, void *, void *)
+{
+        // GRBL sets up the NVS in its thread.
+        for (int i = 0; i < 50 && eeprom_nvs () == nullptr; ++i) {
+                k_msleep (100);
+        }
+
+        if (Interrupted job; interrupted (job)) {
+                LOG_INF ("%s was interrupted after line %u, it can be resumed from the menu", job.path.data (), job.line);
+        }
+
+        while (true) {
+                k_sem_take (&started, K_FOREVER);
+
+                while (atomic_get (&active) != 0) {
+                        k_sem_take (&wake, K_MSEC (PERIOD_MS)); // Given at the end of the job.
+                        atomic_set (&wanted, 1);
+
+                        if (!waitWhileActive ([] { return k_sem_take (&snapshotTaken, K_NO_WAIT) == 0; })) {
+                                break;
+                        }
+
+                        if (!waitWhileActive ([] { return resume_state_executed (&snapshot.state); })) {
+                                break;
+                        }
+
+                        write (snapshot);
+                }
+
+                atomic_clear (&wanted);
+        }
+}
+
+K_THREAD_DEFINE (sdJournal, STACK_SIZE, journalThread, NULL, NULL, NULL, PRIORITY, 0, 0);
+
+} // namespace
+
+/*--------------------------------------------------------------------------*/
+
+void jobStarted (const char *path, uint32_t size, uint16_t date, uint16_t time, bool resumed)
+{
+        JobRecord record{};
+        bool const fits = strlen (path) < record.path.size ();
+        strncpy (record.path.data (), path, record.path.size () - 1);
+        record.size = size;
+        record.date = date;
+        record.time = time;
+
+        eeprom_nvs_lock ();
+        nvs_fs *fs = eeprom_nvs ();
+
+        if (fs != nullptr) {
+                makeRoom (fs);
+
+                if (!resumed || !fits) {
+                        nvs_delete (fs, PROGRESS_ID);
+                }
+
+                if (!fits) {
+                        nvs_delete (fs, JOB_ID);
+                        LOG_WRN ("Path too long, the job isn't journaled");
+                }
+                else if (!resumed) {
+                        nvs_write (fs, JOB_ID, &record, sizeof (record));
+                }
+        }
+
+        eeprom_nvs_unlock ();
+
+        atomic_clear (&marksHead);
+        atomic_clear (&marksTail);
+        atomic_clear (&wanted);
+        k_sem_reset (&snapshotTaken);
+        k_sem_reset (&wake);
+        atomic_set (&active, fs != nullptr && fits);
+        k_sem_give (&started);
+}
+
+/*--------------------------------------------------------------------------*/
+
+void batchSent (uint32_t reply, uint32_t line, uint32_t offset)
+{
+        uint32_t const head = atomic_get (&marksHead);
+
+        // Never full in practice. A missing mark would only make the journal coarser.
+        if (head - uint32_t (atomic_get (&marksTail)) < MAX_MARKS) {
+                marks[head % MAX_MARKS] = Mark{reply, line, offset};
+                atomic_set (&marksHead, head + 1);
+        }
+}
+
+/*--------------------------------------------------------------------------*/
+
+void lineDone (uint32_t reply)
+{
+        uint32_t const head = atomic_get (&marksHead);
+        uint32_t tail = atomic_get (&marksTail);
+
+        while (tail != head && marks[tail % MAX_MARKS].reply < reply) {
+                ++tail;
+        }
+
+        if (tail != head && marks[tail % MAX_MARKS].reply == reply) {
+                Mark const &mark = marks[tail % MAX_MARKS];
+
+                if (atomic_get (&wanted) != 0) {
+                        resume_state_save (&snapshot.state);
+
+                        if (resume_state_restorable (&snapshot.state)) {
+                                snapshot.line = mark.line;
+                                snapshot.offset = mark.offset;
+                                atomic_clear (&wanted);
+                                k_sem_give (&snapshotTaken);
+                        }
+                }
+
+                ++tail;
+        }
+
+        atomic_set (&marksTail, tail);
+}
+
+/*--------------------------------------------------------------------------*/
+
+void jobEnded (bool completed)
+{
+        atomic_clear (&active);
+        k_sem_give (&wake);
+
+        if (!completed) {
+                return; // The last record stays for a resume.
+        }
+
+        // Erasing may start the garbage collection, not while the machine moves.
+        while (plan_get_block_buffer_count () != 0 || mc_get_queued_motion_count () != 0) {
+                k_msleep (50);
+        }
+
+        eeprom_nvs_lock ();
+
+        if (nvs_fs *fs = eeprom_nvs (); fs != nullptr) {
+                nvs_delete (fs, PROGRESS_ID);
+                nvs_delete (fs, JOB_ID);
+        }
+
+        eeprom_nvs_unlock ();
+}
+
+/*--------------------------------------------------------------------------*/
+
+bool interrupted (Interrupted &job)
+{
+        JobRecord jobRecord{};
+        ProgressRecord progress{};
+        eeprom_nvs_lock ();
+        nvs_fs *fs = eeprom_nvs ();
+        bool const found = fs != nullptr && nvs_read (fs, JOB_ID, &jobRecord, sizeof (jobRecord)) == sizeof (jobRecord)
+                && nvs_read (fs, PROGRESS_ID, &progress, sizeof (progress)) == sizeof (progress);
+        eeprom_nvs_unlock ();
+
+        if (!found || atomic_get (&active) != 0) {
+                return false;
+        }
+
+        jobRecord.path.back () = '\0';
+        job.path = jobRecord.path;
+        job.size = jobRecord.size;
+        job.date = jobRecord.date;
+        job.time = jobRecord.time;
+        job.line = progress.line;
+        job.offset = progress.offset;
+        job.state = progress.state;
+        return true;
+}
+
+} // namespace sd::journal
@@ -0,0 +1,51 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#pragma once
+#include "grbl/resume.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Progress of the SD job, kept in the NVS so a job cut short by a power loss can be resumed
+ * from the line following the last executed one. See sdJournal.cc.
+ */
+namespace sd::journal {
+
+constexpr size_t MAX_PATH = 96; // Longer paths are not journaled.
+
+/// What's left of a job which didn't end normally.
+struct Interrupted {
+        std::array<char, MAX_PATH> path{};
+        uint32_t size{};   /// Of the file, with the date and time to tell if it was changed since.
+        uint16_t date{};   /// Of the last change, packed the FAT way (FILINFO::fdate and ftime).
+        uint16_t time{};
+        uint32_t line{};   /// Lines of the file executed.
+        uint32_t offset{}; /// Where the next line starts (in the decompressed data of a .gcz).
+        resume_state_t state{};
+};
+
+/// At the start of a job, the machine is idle. A resumed job keeps its last record until a
+/// new one is written. Size, date and time of the file as in Interrupted.
+void jobStarted (const char *path, uint32_t size, uint16_t date, uint16_t time, bool resumed);
+
+/// The feeder, before a batch of lines goes to GRBL: once reply number `reply` arrives, the
+/// file is done up to `line` and `offset`.
+void batchSent (uint32_t reply, uint32_t line, uint32_t offset);
+
+/// The serial sink (GRBL main thread), for every 'ok'.
+void lineDone (uint32_t reply);
+
+/// After the last reply. The journal of a completed job is erased once the machine stops.
+void jobEnded (bool completed);
+
+/// Reads the journal of the last job if it didn't end normally.
+bool interrupted (Interrupted &job);
+
+} // namespace sd::journal
@@ -0,0 +1,300 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+/*
+ * Checks the EEPROM emulation (eeprom.c) through settings.c, on the NVS in RAM of grblStubs.c,
+ * which counts the accesses. A blank flash gets the defaults with every record written once, a
+ * reboot reads them back without writing anything, a setting or a coordinate set changed is one
+ * NVS write of its record, an unchanged one none, reads never touch the flash, values of a
+ * different size are replaced by the defaults and a failed write is retried.
+ *
+ * The global settings: the defaults generated from SETTINGS_TABLE are the ones of defaults.h, a
+ * boot reads them with two NVS reads (the time is printed), values stored by a firmware with
+ * another layout are taken over by key, also when the power went out in the middle of storing
+ * them in the new one, and so are the ones from the emulated EEPROM of older versions.
+ *
+ * Then a job: settings and coordinates changed with motions planned and running take effect at
+ * once, the motions are not stopped for them, and the flash is written only after the planner
+ * has run empty. A write with motions on their way would stall the stepper interrupt (the CPU
+ * stops while the flash is written), the stub counts those.
+ *
+ * Usage: eeprom-check
+ */
+
+#include "grblStubs.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+
+static uint32_t failures;
+
+static void expect (const char *name, bool ok)
+{
+        printf ("%-40s %s\n", name, ok ? "" : "FAILED");
+        failures += !ok;
+}
+
+uint8_t read_global_settings (); // settings.c, not in settings.h.
+
+/// No files here.
+uint8_t estimator_run_file (const char *path, estimate_t *estimate) { return STATUS_FILE_READ; }
+
+/// Power up: the shadow is loaded, the settings read, and the main loop flushes what was restored.
+static void boot ()
+{
+        stubReset ();
+        init_nvs ();
+        settings_init ();
+        settings_flush ();
+}
+
+/// `$n=value` from the main loop.
+static void store (uint8_t parameter, float value)
+{
+        settings_store_global_setting (parameter, value);
+        settings_flush ();
+}
+
+static uint8_t execute (const char *text)
+{
+        char line[LINE_BUFFER_SIZE];
+        strcpy (line, text);
+        return (line[0] == '$') ? system_execute_line (line) : gc_execute_line (line);
+}
+
+static void expectDefaults ()
+{
+        stubNvsErase ();
+        boot ();
+        uint8_t const flags = (DEFAULT_REPORT_INCHES << BIT_REPORT_INCHES) | (DEFAULT_LASER_MODE << BIT_LASER_MODE) |
+                (DEFAULT_INVERT_ST_ENABLE << BIT_INVERT_ST_ENABLE) | (DEFAULT_HARD_LIMIT_ENABLE << BIT_HARD_LIMIT_ENABLE) |
+                (DEFAULT_HOMING_ENABLE << BIT_HOMING_ENABLE) | (DEFAULT_SOFT_LIMIT_ENABLE << BIT_SOFT_LIMIT_ENABLE) |
+                (DEFAULT_INVERT_LIMIT_PINS << BIT_INVERT_LIMIT_PINS) | (DEFAULT_INVERT_PROBE_PIN << BIT_INVERT_PROBE_PIN);
+        bool ok = settings.pulse_microseconds == DEFAULT_STEP_PULSE_MICROSECONDS && settings.flags == flags;
+        ok = ok && settings.status_report_mask == DEFAULT_STATUS_REPORT_MASK && settings.homing_debounce_delay == DEFAULT_HOMING_DEBOUNCE_DELAY;
+        ok = ok && settings.junction_deviation == (float)DEFAULT_JUNCTION_DEVIATION && settings.rpm_max == (float)DEFAULT_SPINDLE_RPM_MAX;
+        ok = ok && settings.steps_per_mm[Z_AXIS] == (float)DEFAULT_Z_STEPS_PER_MM && settings.acceleration[Y_AXIS] == (float)DEFAULT_Y_ACCELERATION;
+        ok = ok && settings.max_travel[X_AXIS] == (float)-DEFAULT_X_MAX_TRAVEL && settings.max_travel[Z_AXIS] == (float)-DEFAULT_Z_MAX_TRAVEL;
+        expect ("Defaults from the table", ok);
+}
+
+static void expectFastBoot ()
+{
+        boot ();
+        stubNvsResetCounters ();
+        struct timespec start, end;
+        uint32_t const rounds = 10000;
+        bool ok = true;
+        clock_gettime (CLOCK_MONOTONIC, &start);
+
+        for (uint32_t i = 0; i < rounds; ++i) {
+                ok = ok && read_global_settings ();
+        }
+
+        clock_gettime (CLOCK_MONOTONIC, &end);
+        double us = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / 1e3 / rounds;
+        printf ("Settings loaded in %.3f us\n", us);
+        expect ("Settings load, two reads", ok && stubNvsReads == 2 * rounds && stubNvsWrites == 0);
+}
+
+/// Stores values as an older firmware would have: $110 first, $0 moved, $13 in another bit,
+/// a setting which is gone ($200) and none of the others.
+static void storeOldLayout (float maxRateX, uint8_t pulse)
+{
+        struct {
+                float maxRateX;
+                uint8_t pulse;
+                uint8_t flags;
+                uint16_t gone;
+        } values = {maxRateX, pulse, 0x80, 7};
+
+        settings_layout_t layout = {SETTINGS_LAYOUT_VERSION, 0, 4, sizeof (values)};
+        layout.keys[0] = (setting_key_t){110, offsetof (typeof (values), maxRateX), sizeof (float), 0};
+        layout.keys[1] = (setting_key_t){0, offsetof (typeof (values), pulse), sizeof (uint8_t), 0};
+        layout.keys[2] = (setting_key_t){13, offsetof (typeof (values), flags), sizeof (uint8_t), 0x80};
+        layout.keys[3] = (setting_key_t){200, offsetof (typeof (values), gone), sizeof (uint16_t), 0};
+
+        stubNvsErase ();
+        stubReset ();
+        init_nvs ();
+        nvs_write (eeprom_nvs (), SETTINGS_NVS_VALUES, &values, sizeof (values));
+        nvs_write (eeprom_nvs (), SETTINGS_NVS_LAYOUT, &layout, offsetof (settings_layout_t, keys) + 4 * sizeof (setting_key_t));
+}
+
+static bool migrated (float maxRateX, uint8_t pulse)
+{
+        return settings.max_rate[X_AXIS] == maxRateX && settings.pulse_microseconds == pulse && bit_istrue (settings.flags, BITFLAG_REPORT_INCHES) &&
+                settings.max_rate[Y_AXIS] == DEFAULT_Y_MAX_RATE && settings.steps_per_mm[X_AXIS] == DEFAULT_X_STEPS_PER_MM;
+}
+
+static void expectMigration ()
+{
+        storeOldLayout (777.0F, 9);
+        boot ();
+        expect ("Other layout, kept by key", migrated (777.0F, 9));
+
+        stubNvsResetCounters ();
+        boot ();
+        expect ("Other layout, stored in the new one", migrated (777.0F, 9) && stubNvsWrites == 0);
+
+        // The new values are written, the layout pointing at them is not.
+        storeOldLayout (888.0F, 10);
+        stubReset ();
+        init_nvs ();
+        settings_init ();
+        stubNvsFailAfter = 1;
+        stubNvsFailures = 1;
+        settings_flush ();
+        bool const interrupted = stubNvsFailAfter == 0 && stubNvsFailures == 0;
+        boot ();
+        expect ("Other layout, power lost, old values", interrupted && migrated (888.0F, 10));
+
+        stubNvsResetCounters ();
+        boot ();
+        expect ("Other layout, power lost, then stored", migrated (888.0F, 10) && stubNvsWrites == 0);
+}
+
+/// Version 11 kept the settings in the emulated EEPROM.
+static void expectEepromImport ()
+{
+        stubNvsErase ();
+        boot ();
+        settings.max_rate[Z_AXIS] = 321.0F;
+        eeprom_put_char (0, SETTINGS_VERSION);
+        memcpy_to_eeprom_with_checksum (EEPROM_ADDR_GLOBAL, (char *)&settings, sizeof (settings_t));
+        eeprom_flush ();
+        nvs_delete (eeprom_nvs (), SETTINGS_NVS_LAYOUT);
+        nvs_delete (eeprom_nvs (), SETTINGS_NVS_VALUES);
+        nvs_delete (eeprom_nvs (), SETTINGS_NVS_VALUES + 1);
+
+        boot ();
+        expect ("EEPROM settings taken over", settings.max_rate[Z_AXIS] == 321.0F);
+        stubNvsResetCounters ();
+        boot ();
+        expect ("EEPROM settings, stored", settings.max_rate[Z_AXIS] == 321.0F && stubNvsWrites == 0);
+}
+
+static void expectDeferredWhileMoving ()
+{
+        boot ();
+        stubNvsResetCounters ();
+
+        // Streaming: the lines are planned, the cycle hasn't started yet.
+        execute ("G1X10F600");
+        execute ("X20");
+        execute ("X30");
+        bool ok = execute ("$110=500") == STATUS_OK;
+        settings_flush (); // Before protocol_auto_cycle_start.
+        sys.state = STATE_CYCLE;
+        uint8_t const planned = plan_get_block_buffer_count ();
+        ok = ok && execute ("G10L2P2X5") == STATUS_OK && execute ("G28.1") == STATUS_OK;
+        ok = ok && execute ("X40") == STATUS_OK;
+        expect ("Job, motions not stopped", ok && plan_get_block_buffer_count () == planned + 1);
+
+        float g55[N_AXIS];
+        settings_read_coord_data (1, g55);
+        expect ("Job, new values in effect", settings.max_rate[X_AXIS] == 500.0F && g55[X_AXIS] == 5.0F);
+
+        // The stepper interrupt runs the blocks, the main loop keeps trying to flush.
+        bool written = false;
+
+        while (plan_get_current_block () != NULL) {
+                settings_flush ();
+                written = written || stubNvsWrites != 0;
+                plan_discard_current_block ();
+        }
+
+        settings_flush ();
+        expect ("Job, nothing written while moving", !written && stubNvsWrites == 0);
+
+        sys.state = STATE_IDLE; // The cycle has ended.
+        settings_flush ();
+        // The settings, G55 and G28 records.
+        expect ("Job, written once idle", stubNvsWrites == 3 && stubNvsWritesMoving == 0);
+
+        boot ();
+        memset (g55, 0, sizeof (g55));
+        settings_read_coord_data (1, g55);
+        expect ("Job, values kept", settings.max_rate[X_AXIS] == 500.0F && g55[X_AXIS] == 5.0F);
+}
+
+int main ()
+{
+        stubNvsErase ();
+        boot ();
+        expect ("Blank flash, defaults", settings.max_rate[X_AXIS] == DEFAULT_X_MAX_RATE && stubNvsWrites > 0);
+        expect ("Blank flash, every record written once", stubNvsMaxWrites () == 1);
+
+        stubNvsResetCounters ();
+        boot ();
+        expect ("Reboot, nothing written", stubNvsWrites == 0 && settings.max_rate[X_AXIS] == DEFAULT_X_MAX_RATE);
+
+        stubNvsResetCounters ();
+        store (110, 1234.0F); // $110, X max rate.
+        expect ("Setting changed, one write", stubNvsWrites == 1);
+
+        stubNvsResetCounters ();
+        store (110, 1234.0F);
+        expect ("Setting unchanged, no write", stubNvsWrites == 0);
+
+        stubNvsResetCounters ();
+        float coord[N_AXIS] = {1.0F, 2.0F, 3.0F};
+        settings_write_coord_data (1, coord); // G55
+        settings_flush ();
+        expect ("Coordinates changed, one write", stubNvsWrites == 1);
+
+        // The SD job journal thread writes to the same NVS.
+        stubNvsResetCounters ();
+        boot ();
+        store (110, 4321.0F);
+        store (110, 1234.0F);
+        float const zero[N_AXIS] = {0};
+        settings_write_coord_data (2, coord); // G56, set and cleared.
+        settings_flush ();
+        settings_write_coord_data (2, (float *)zero);
+        settings_flush ();
+        expect ("NVS used under the lock only", stubNvsReads > 0 && stubNvsWrites > 0 && stubNvsUnlocked == 0 && stubMutexesHeld == 0);
+
+        stubNvsResetCounters ();
+        float read[N_AXIS];
+
+        for (int i = 0; i < 100; ++i) {
+                settings_read_coord_data (1, read);
+        }
+
+        expect ("Reads from RAM", stubNvsReads == 0 && memcmp (read, coord, sizeof (coord)) == 0);
+
+        boot ();
+        memset (read, 0, sizeof (read));
+        settings_read_coord_data (1, read);
+        expect ("Reboot, values kept", settings.max_rate[X_AXIS] == 1234.0F && memcmp (read, coord, sizeof (coord)) == 0);
+
+        stubNvsResetCounters ();
+        stubNvsFailures = 1;
+        store (110, 2345.0F);
+        bool const failed = stubNvsWrites == 0;
+        settings_flush ();
+        bool const retried = stubNvsWrites == 1;
+        boot ();
+        expect ("Failed write retried", failed && retried && settings.max_rate[X_AXIS] == 2345.0F);
+
+        // The values shorter than the layout says.
+        stubNvsResize (SETTINGS_NVS_VALUES, sizeof (settings_t) - 1);
+        stubNvsResize (SETTINGS_NVS_VALUES + 1, sizeof (settings_t) - 1);
+        boot ();
+        expect ("Values of another size, defaults", settings.max_rate[X_AXIS] == DEFAULT_X_MAX_RATE);
+
+        expectDefaults ();
+        expectFastBoot ();
+        expectMigration ();
+        expectEepromImport ();
+        expectDeferredWhileMoving ();
+
+        printf ("%u failures\n", failures);
+        return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,255 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+/*
+ * Checks the job estimator (estimator.h) with the real planner. First jobs whose time can
+ * be worked out by hand: a trapezoid, a triangle, a dwell, collinear blocks joined at full
+ * speed, a long straight line split into more blocks than the planner holds, a stop. Then that the
+ * parser and the planner are left as they were, and that the bytes can be fed in any pieces.
+ * Finally every file given is estimated and the speed of the estimator printed.
+ *
+ * Usage: estimate-check [file.ngc ...]
+ */
+
+#include "grblStubs.h"
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#define MAX_RATE 6000.0F           // mm/min
+#define ACCELERATION 100.0F        // mm/s²
+#define TIME_TOLERANCE 1e-3        // Relative.
+#define POSITION_TOLERANCE 1e-4F   // mm
+
+static uint32_t failures;
+
+static void reset ()
+{
+        stubReset ();
+
+        for (uint8_t idx = 0; idx < N_AXIS; ++idx) {
+                settings.max_rate[idx] = MAX_RATE;
+                settings.acceleration[idx] = ACCELERATION * 60 * 60;
+                settings.max_travel[idx] = -200.0F;
+        }
+
+        settings.junction_deviation = 0.01F;
+        settings.arc_tolerance = 0.002F;
+        plan_reset ();
+}
+
+static estimate_t estimate (const char *job, uint32_t piece)
+{
+        estimate_t result;
+        uint32_t len = strlen (job);
+
+        if (estimator_begin () != STATUS_OK) {
+                printf ("estimator_begin failed\n");
+                ++failures;
+        }
+
+        for (uint32_t i = 0; i < len; i += piece) {
+                estimator_feed ((const uint8_t *)job + i, (len - i < piece) ? len - i : piece);
+        }
+
+        estimator_end (&result);
+        return result;
+}
+
+static void expectTime (const char *name, const char *job, float seconds)
+{
+        reset ();
+        estimate_t e = estimate (job, UINT32_MAX);
+        bool ok = e.status == STATUS_OK && fabs (e.seconds - seconds) <= TIME_TOLERANCE * seconds;
+        printf ("%-34s %9.4f s, expected %9.4f s %s\n", name, e.seconds, seconds, ok ? "" : "FAILED");
+        failures += !ok;
+}
+
+static void expectBounds (const char *job, const float *min, const float *max)
+{
+        reset ();
+        estimate_t e = estimate (job, UINT32_MAX);
+        bool ok = e.status == STATUS_OK;
+
+        for (uint8_t idx = 0; idx < N_AXIS; ++idx) {
+                ok = ok && fabsf (e.min[idx] - min[idx]) <= POSITION_TOLERANCE && fabsf (e.max[idx] - max[idx]) <= POSITION_TOLERANCE;
+        }
+
+        printf ("%-34s %.3f,%.3f,%.3f : %.3f,%.3f,%.3f %s\n", "Bounds", e.min[X_AXIS], e.min[Y_AXIS], e.min[Z_AXIS], e.max[X_AXIS],
+                e.max[Y_AXIS], e.max[Z_AXIS], ok ? "" : "FAILED");
+        failures += !ok;
+}
+
+/// Left as it was: the parser state, nothing planned, idle.
+static void expectRestored ()
+{
+        reset ();
+        char line[] = "G91G1X3F100";
+        gc_execute_line (line);
+        plan_reset (); // Done.
+        parser_state_t before = gc_state;
+        estimate ("G90G55G20\nG92X7\nG43.1Z2\nG0X10Y10\nM3S100\nG2X0Y0I-5J-5\n", UINT32_MAX);
+        bool ok = memcmp (&before, &gc_state, sizeof (gc_state)) == 0 && plan_get_current_block () == NULL && sys.state == STATE_IDLE;
+        printf ("%-34s %s\n", "State restored", ok ? "" : "FAILED");
+        failures += !ok;
+}
+
+/// The host's subroutines are kept, the job's are dropped. Refused while the host sends a sub.
+static void expectSubsKept ()
+{
+        reset ();
+        char define[] = "O100SUB";
+        char body[] = "G4P0";
+        char end[] = "O100ENDSUB";
+        oword_execute_line (define);
+        bool ok = estimator_begin () == STATUS_IDLE_ERROR && sys.state == STATE_IDLE;
+        oword_execute_line (body);
+        oword_execute_line (end);
+        estimate_t e = estimate ("O101SUB\nG1Z10F600\nO101ENDSUB\nO101CALL\nO100CALL\n", UINT32_MAX);
+        char callHost[] = "O100CALL";
+        char callJob[] = "O101CALL";
+        ok = ok && e.status == STATUS_OK && oword_execute_line (callHost) == STATUS_OK && oword_execute_line (callJob) == STATUS_OWORD_UNDEFINED;
+        printf ("%-34s %s\n", "Subroutines kept", ok ? "" : "FAILED");
+        failures += !ok;
+}
+
+/// A reset (protocol_execute_realtime sets sys.abort here) stops a long estimate.
+static void expectAborted ()
+{
+        reset ();
+        char job[2048] = "";
+
+        for (int i = 0; i < 100; ++i) {
+                strcat (job, (i % 2 == 0) ? "G1Z10F600\n" : "G1Z0\n");
+        }
+
+        stubRealtimeLimit = 3;
+        estimate_t e = estimate (job, 64);
+        stubRealtimeLimit = 0;
+        bool ok = e.status == STATUS_ESTIMATE_ABORTED && e.lines < 100 && sys.state == STATE_IDLE;
+        printf ("%-34s %u lines, status %u %s\n", "Aborted by a reset", e.lines, e.status, ok ? "" : "FAILED");
+        failures += !ok;
+}
+
+/// The lines the SD job sends, so its replies count out of these (LineAssembler in sdJob.cc).
+static void expectLines (const char *job, uint32_t lines)
+{
+        reset ();
+        estimate_t e = estimate (job, UINT32_MAX);
+        bool ok = e.status == STATUS_OK && e.lines == lines;
+        printf ("%-34s %u lines, expected %u %s\n", "Lines sent", e.lines, lines, ok ? "" : "FAILED");
+        failures += !ok;
+}
+
+/// A file fed in pieces of any size gives the same estimate.
+static void expectPieces (const char *job)
+{
+        reset ();
+        estimate_t whole = estimate (job, UINT32_MAX);
+        bool ok = true;
+
+        for (uint32_t piece = 1; piece < 64; piece += 7) {
+                reset ();
+                estimate_t e = estimate (job, piece);
+                ok = ok && e.seconds == whole.seconds && e.lines == whole.lines && e.blocks == whole.blocks;
+        }
+
+        printf ("%-34s %u lines, %u blocks %s\n", "Fed in pieces", whole.lines, whole.blocks, ok ? "" : "FAILED");
+        failures += !ok;
+}
+
+/// $E reads the files from the disk here.
+uint8_t estimator_run_file (const char *path, estimate_t *estimate)
+{
+        FILE *file = fopen (path, "rb");
+
+        if (file == NULL) {
+                return STATUS_FILE_READ;
+        }
+
+        uint8_t status = estimator_begin ();
+
+        if (status == STATUS_OK) {
+                uint8_t buffer[4096];
+                size_t len;
+
+                while ((len = fread (buffer, 1, sizeof (buffer), file)) > 0 && estimator_feed (buffer, len)) {
+                }
+
+                estimator_end (estimate);
+                status = estimate->status;
+        }
+
+        fclose (file);
+        return status;
+}
+
+static void estimateFile (const char *path)
+{
+        reset ();
+        char line[LINE_BUFFER_SIZE];
+        snprintf (line, sizeof (line), "$E=%s", path);
+        estimate_t e;
+        struct timespec start, end;
+        clock_gettime (CLOCK_MONOTONIC, &start);
+        uint8_t status = estimator_run_file (path, &e);
+        clock_gettime (CLOCK_MONOTONIC, &end);
+        double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+
+        if (status == STATUS_FILE_READ) {
+                perror (path);
+                ++failures;
+                return;
+        }
+
+        printf ("%s: %u lines, %u blocks, %.1f s, %.0f mm, X %.2f..%.2f Y %.2f..%.2f Z %.2f..%.2f, status %u, estimated in %.1f ms "
+                "(%.0f lines/s)\n",
+                path, e.lines, e.blocks, e.seconds, e.distance, e.min[X_AXIS], e.max[X_AXIS], e.min[Y_AXIS], e.max[Y_AXIS], e.min[Z_AXIS],
+                e.max[Z_AXIS], status, ms, e.lines / (ms / 1e3));
+
+        // The same through the command. Some of the samples fail, Grbl doesn't know all the g-codes.
+        reset ();
+        bool ok = system_execute_line (line) == status && sys.state == STATE_IDLE;
+        printf ("%-34s %s\n", "$E", ok ? "" : "FAILED");
+        failures += !ok;
+}
+
+int main (int argc, char **argv)
+{
+        // Along Z, X and Y are CoreXY (config.h), where the planner works with the motor moves.
+        // 10 mm/s, 0.1 s and 0.5 mm to get there and as much to stop.
+        expectTime ("Trapezoid", "G1Z100F600\n", 0.1F + 99.0F / 10.0F + 0.1F);
+        // Peak speed sqrt (a * L).
+        expectTime ("Triangle", "G1Z0.5F6000\n", 2 * sqrtf (ACCELERATION * 0.5F) / ACCELERATION);
+        expectTime ("Dwell", "G1Z100F600\nG4P2\n", 10.1F + 2.0F);
+        expectTime ("Collinear blocks", "G1Z25F600\nZ50\nZ75\nZ100\n", 10.1F);
+        expectTime ("More blocks than the planner holds", "G1Z5F600\nZ10\nZ15\nZ20\nZ25\nZ30\nZ35\nZ40\nZ45\nZ50\nZ55\nZ60\nZ65\nZ70\n"
+                    "Z75\nZ80\nZ85\nZ90\nZ95\nZ100\n", 10.1F);
+        expectTime ("Rapid", "G0Z100\n", 2 * (MAX_RATE / 60) / ACCELERATION + (100.0F - (MAX_RATE / 60) * (MAX_RATE / 60) / ACCELERATION) / (MAX_RATE / 60));
+        expectTime ("Stop at the program end", "G1Z50F600\nM2\nG1Z100\n", 2 * (0.2F + 49.0F / 10.0F));
+        expectTime ("Comments, case and white space", "(start)\ng1 z 100 f600 ; go\n\n", 10.1F);
+        expectTime ("Last line without a line feed", "G1Z100F600", 10.1F);
+        // A motor moves 100 mm, the other one stands still.
+        expectTime ("CoreXY diagonal", "G1X50Y50F600\n", 10.1F);
+
+        float const min[] = {-15.0F, 0.0F, -1.0F};
+        float const max[] = {10.0F, 20.0F, 0.0F};
+        expectBounds ("G0X10Y20\nG92X0\nG1X-15Y0Z-1F1000\nZ0\n", min, max);
+        expectRestored ();
+        expectSubsKept ();
+        expectAborted ();
+        expectLines ("%\r\n(start)\r\n\r\n  \r\n$$\r\nG1X10F600 ; go\r\n%", 6);
+        expectPieces ("(a comment)\nG1X10F600\nG2X20I5\nG4P0.5\nG1Y10\n");
+
+        for (int i = 1; i < argc; ++i) {
+                estimateFile (argv[i]);
+        }
+
+        printf ("%u failures\n", failures);
+        return (failures == 0) ? 0 : 1;
+}
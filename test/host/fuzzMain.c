@@ -0,0 +1,115 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+/*
+ * Stands in for libFuzzer when the compiler is not clang. Runs the inputs
+ * given as files, or generates random ones: lines made of g-code words with
+ * odd numbers, with random bytes mixed in now and then.
+ *
+ * Usage: gcode-fuzz [file...] | gcode-fuzz -runs=N [-seed=N]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_INPUT_SIZE 4096
+
+int LLVMFuzzerTestOneInput (const uint8_t *data, size_t size);
+
+static const char *const letters[] = {"G0",  "G1",  "G2",  "G3",  "G4",  "G20", "G21", "G17", "G18", "G90", "G91", "G93", "G94",
+                                      "G92", "G53", "G10L2P1", "G10L20P1", "G28", "G80", "M3", "M5", "X", "Y", "Z", "F",
+                                      "N",   "I",   "J",   "K",   "R",   "S",   "P",   "L",   "T",   "O100SUB", "O100ENDSUB", "O100CALL", "O101REPEAT", "O101ENDREPEAT",
+                                      "O102WHILE", "O102ENDWHILE", "O103SUB", "O103ENDSUB", "O103CALL", "["};
+
+static const char *const numbers[] = {"",       "0",       "1",       "-1",      "10.5",         ".5",     "-.0",     "+3",
+                                      "000001", "0.00001", "1e5",     "99999999", "12345678.9",  "-0",     "1.2.3",   "--1",
+                                      ".",      "2147483648", "0.0000000000001", "33.333333333", "[3]", "[0]"};
+
+static uint8_t input[MAX_INPUT_SIZE];
+
+static size_t randomInput ()
+{
+        size_t size = 0;
+        input[size++] = rand ();
+        int lines = 1 + rand () % 8;
+
+        for (int l = 0; l < lines; ++l) {
+                int words = rand () % 6;
+
+                for (int w = 0; w < words && size < MAX_INPUT_SIZE - 64; ++w) {
+                        if (rand () % 16 == 0) {
+                                input[size++] = rand ();
+                                continue;
+                        }
+
+                        const char *letter = letters[rand () % (sizeof (letters) / sizeof (letters[0]))];
+                        const char *number = numbers[rand () % (sizeof (numbers) / sizeof (numbers[0]))];
+                        size += snprintf ((char *)input + size, MAX_INPUT_SIZE - size, "%s%s", letter, number);
+                }
+
+                if (size < MAX_INPUT_SIZE) {
+                        input[size++] = '\n';
+                }
+        }
+
+        return size;
+}
+
+static int runFile (const char *path)
+{
+        FILE *file = fopen (path, "rb");
+
+        if (file == NULL) {
+                perror (path);
+                return 1;
+        }
+
+        size_t size = fread (input, 1, sizeof (input), file);
+        fclose (file);
+        LLVMFuzzerTestOneInput (input, size);
+        return 0;
+}
+
+int main (int argc, char **argv)
+{
+        unsigned long runs = 100000;
+        unsigned seed = 1;
+        int files = 0;
+
+        for (int i = 1; i < argc; ++i) {
+                if (strncmp (argv[i], "-runs=", 6) == 0) {
+                        runs = strtoul (argv[i] + 6, NULL, 10);
+                }
+                else if (strncmp (argv[i], "-seed=", 6) == 0) {
+                        seed = strtoul (argv[i] + 6, NULL, 10);
+                }
+                else if (argv[i][0] != '-') {
+                        if (runFile (argv[i]) != 0) {
+                                return 1;
+                        }
+
+                        ++files;
+                }
+        }
+
+        if (files > 0) {
+                printf ("%d inputs run\n", files);
+                return 0;
+        }
+
+        srand (seed);
+
+        for (unsigned long i = 0; i < runs; ++i) {
+                LLVMFuzzerTestOneInput (input, randomInput ());
+        }
+
+        printf ("%lu random inputs run\n", runs);
+        return 0;
+}
@@ -0,0 +1,158 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+/*
+ * Runs a g-code file through the parser, once with the fast path for linear
+ * motions (gc_execute_line) and once without it (gc_execute_line_full), and
+ * prints µs per line. Both runs must give the planner exactly the same data.
+ *
+ * Usage: gcode-benchmark [file.ngc] [repetitions]
+ */
+
+#include "grblStubs.h"
+#include <stdio.h>
+#include <time.h>
+
+#define MAX_LINES 65536
+
+typedef uint8_t (*execute_t) (char *line);
+
+typedef struct {
+        double allNs;
+        uint32_t all;
+        double linearNs; // Lines which produced exactly one mc_line call.
+        uint32_t linear;
+        uint32_t errors;
+} result_t;
+
+static char *lines[MAX_LINES];
+static uint32_t lineCount;
+
+static double now ()
+{
+        struct timespec ts;
+        clock_gettime (CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static bool load (const char *path)
+{
+        FILE *file = fopen (path, "r");
+
+        if (file == NULL) {
+                perror (path);
+                return false;
+        }
+
+        char buffer[256];
+
+        while (lineCount < MAX_LINES && fgets (buffer, sizeof (buffer), file) != NULL) {
+                cleanLine (buffer);
+
+                if (buffer[0] != '\0' && strlen (buffer) < LINE_BUFFER_SIZE) {
+                        lines[lineCount++] = strdup (buffer);
+                }
+        }
+
+        fclose (file);
+        return true;
+}
+
+static void run (execute_t execute, uint32_t repetitions, result_t *result)
+{
+        char line[LINE_BUFFER_SIZE];
+        memset (result, 0, sizeof (*result));
+
+        for (uint32_t r = 0; r < repetitions; ++r) {
+                stubReset ();
+
+                for (uint32_t i = 0; i < lineCount; ++i) {
+                        strcpy (line, lines[i]); // The parser may modify the line.
+                        uint32_t lineCountBefore = stubLineCount;
+                        uint32_t arcCountBefore = stubArcCount;
+
+                        double start = now ();
+                        uint8_t status = execute (line);
+                        double elapsed = now () - start;
+
+                        result->allNs += elapsed;
+                        ++result->all;
+
+                        if (status != STATUS_OK) {
+                                ++result->errors;
+                        }
+                        else if (stubLineCount == lineCountBefore + 1 && stubArcCount == arcCountBefore) {
+                                result->linearNs += elapsed;
+                                ++result->linear;
+                        }
+                }
+        }
+
+        result->errors /= repetitions;
+}
+
+static stub_motion_t *record (execute_t execute, uint32_t *count)
+{
+        stubMotionsSize = MAX_LINES;
+        stubMotions = calloc (stubMotionsSize, sizeof (stub_motion_t));
+        stubReset ();
+        char line[LINE_BUFFER_SIZE];
+
+        for (uint32_t i = 0; i < lineCount; ++i) {
+                strcpy (line, lines[i]);
+                execute (line);
+        }
+
+        stub_motion_t *motions = stubMotions;
+        *count = stubLineCount;
+        stubMotions = NULL;
+        return motions;
+}
+
+static void print (const char *name, const result_t *result)
+{
+        printf ("%-6s %8.3f µs/line (%u lines), linear motions %8.3f µs/line (%u lines), %u errors\n", name, result->allNs / result->all / 1000.0,
+                result->all, (result->linear != 0) ? result->linearNs / result->linear / 1000.0 : 0.0, result->linear, result->errors);
+}
+
+int main (int argc, char **argv)
+{
+        const char *path = (argc > 1) ? argv[1] : "samples/sphere.ngc";
+        uint32_t repetitions = (argc > 2) ? atoi (argv[2]) : 200;
+
+        if (!load (path) || lineCount == 0 || repetitions == 0) {
+                return 1;
+        }
+
+        uint32_t fullCount = 0;
+        uint32_t fastCount = 0;
+        stub_motion_t *full = record (gc_execute_line_full, &fullCount);
+        stub_motion_t *fast = record (gc_execute_line, &fastCount);
+
+        if (fullCount != fastCount) {
+                printf ("Different number of motions: %u (full parser) vs %u\n", fullCount, fastCount);
+                return 1;
+        }
+
+        for (uint32_t i = 0; i < fullCount && i < MAX_LINES; ++i) {
+                if (!stubSameMotion (&full[i], &fast[i])) {
+                        printf ("Motion %u differs\n", i);
+                        return 1;
+                }
+        }
+
+        result_t resultFull;
+        result_t resultFast;
+        run (gc_execute_line_full, repetitions, &resultFull);
+        run (gc_execute_line, repetitions, &resultFast);
+
+        printf ("%s, %u lines x %u\n", path, lineCount, repetitions);
+        print ("full", &resultFull);
+        print ("fast", &resultFast);
+        return 0;
+}
@@ -0,0 +1,155 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+/*
+ * libFuzzer entry point. The first byte of the input selects the target, the
+ * rest are lines separated by '\n', run in order on a freshly reset parser:
+ *
+ * 0 - gc_execute_line vs gc_execute_line_full. Every line is run by both from
+ *     the same parser state, they must return the same status, send the same
+ *     motions to the planner and leave the parser in the same state.
+ * 1 - read_float vs strtod, see readFloatCheck.h.
+ * 2 - system_execute_line, the '$' is prepended.
+ * 3 - oword_execute_line, O-word subroutines and loops.
+ *
+ * Anything wrong calls abort(), so the fuzzer (or the sanitizers) keep the
+ * input.
+ */
+
+#include "grblStubs.h"
+#include "readFloatCheck.h"
+#include <stdio.h>
+
+#define MAX_LINES_PER_INPUT 16
+#define MAX_REALTIME_CALLS 100000 // Endless loops (O-word while) are stopped by a reset.
+#define MAX_MOTIONS 64 // Per line. G28/G30 make two, an arc makes one mc_arc call.
+
+enum { MODE_FAST_PATH, MODE_READ_FLOAT, MODE_SYSTEM, MODE_OWORD, MODE_COUNT };
+
+static void fastPathDiff (char *line)
+{
+        static stub_motion_t fullMotions[MAX_MOTIONS];
+        static stub_motion_t fastMotions[MAX_MOTIONS];
+        char lineCopy[LINE_BUFFER_SIZE];
+        parser_state_t before = gc_state;
+
+        strcpy (lineCopy, line); // The parser may modify the line.
+        stubMotions = fullMotions;
+        stubMotionsSize = MAX_MOTIONS;
+        stubLineCount = 0;
+        uint8_t fullStatus = gc_execute_line_full (lineCopy);
+        uint32_t fullCount = stubLineCount;
+        parser_state_t fullState = gc_state;
+
+        gc_state = before;
+        strcpy (lineCopy, line);
+        stubMotions = fastMotions;
+        stubLineCount = 0;
+        uint8_t fastStatus = gc_execute_line (lineCopy);
+        uint32_t fastCount = stubLineCount;
+        stubMotions = NULL;
+
+        const char *problem = NULL;
+
+        if (fullStatus != fastStatus) {
+                problem = "status";
+        }
+        else if (fullCount != fastCount) {
+                problem = "number of motions";
+        }
+        else if (memcmp (&fullState, &gc_state, sizeof (gc_state)) != 0) {
+                problem = "parser state";
+        }
+        else {
+                for (uint32_t i = 0; i < fullCount && i < MAX_MOTIONS; ++i) {
+                        if (!stubSameMotion (&fullMotions[i], &fastMotions[i])) {
+                                problem = "motion";
+                        }
+                }
+        }
+
+        if (problem != NULL) {
+                printf ("\"%s\": different %s (status %u vs %u, %u vs %u motions)\n", line, problem, fullStatus, fastStatus, fullCount,
+                        fastCount);
+                abort ();
+        }
+}
+
+static void readFloatDiff (const char *line)
+{
+        char message[256];
+
+        if (!readFloatCheck (line, message, sizeof (message))) {
+                printf ("%s\n", message);
+                abort ();
+        }
+}
+
+static void systemLine (const char *line)
+{
+        char lineCopy[LINE_BUFFER_SIZE + 1];
+        snprintf (lineCopy, sizeof (lineCopy), "$%s", line);
+
+        if (strlen (lineCopy) < LINE_BUFFER_SIZE) {
+                system_execute_line (lineCopy);
+        }
+}
+
+int LLVMFuzzerTestOneInput (const uint8_t *data, size_t size)
+{
+        if (size == 0) {
+                return 0;
+        }
+
+        int mode = data[0] % MODE_COUNT;
+        char line[LINE_BUFFER_SIZE];
+        size_t start = 1;
+        stubReset ();
+        stubRealtimeLimit = MAX_REALTIME_CALLS;
+
+        for (int n = 0; n < MAX_LINES_PER_INPUT && start < size; ++n) {
+                size_t end = start;
+
+                while (end < size && data[end] != '\n') {
+                        ++end;
+                }
+
+                size_t length = end - start;
+                start = end + 1;
+
+                if (length >= LINE_BUFFER_SIZE) {
+                        continue;
+                }
+
+                memcpy (line, data + start - length - 1, length);
+                line[length] = '\0';
+
+                if (mode == MODE_READ_FLOAT) {
+                        readFloatDiff (line); // Raw, read_float sees what the parser passes it.
+                        continue;
+                }
+
+                cleanLine (line);
+
+                if (line[0] == '\0') {
+                        continue;
+                }
+
+                if (mode == MODE_FAST_PATH && line[0] != '$') {
+                        fastPathDiff (line);
+                }
+                else if (mode == MODE_SYSTEM) {
+                        systemLine (line);
+                }
+                else if (mode == MODE_OWORD && line[0] != '$') {
+                        oword_execute_line (line);
+                }
+        }
+
+        return 0;
+}
@@ -0,0 +1,377 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#include "grblStubs.h"
+#include <errno.h>
+
+system_t sys;
+int32_t sys_position[N_AXIS];
+#ifndef HOST_PLANNER
+settings_t settings; // Otherwise settings.c
+#endif
+volatile uint8_t sys_rt_exec_state;
+volatile uint8_t sys_rt_exec_alarm;
+volatile uint8_t sys_rt_exec_motion_override;
+volatile uint8_t sys_rt_exec_accessory_override;
+
+stub_motion_t *stubMotions;
+uint32_t stubMotionsSize;
+uint32_t stubLineCount;
+uint32_t stubArcCount;
+uint32_t stubRealtimeLimit;
+static uint32_t realtimeCount;
+
+void stubReset ()
+{
+        memset (&sys, 0, sizeof (sys));
+        memset (sys_position, 0, sizeof (sys_position));
+        memset (&settings, 0, sizeof (settings));
+
+        for (uint8_t idx = 0; idx < N_AXIS; ++idx) {
+                settings.steps_per_mm[idx] = 100.0F;
+        }
+
+        sys.f_override = DEFAULT_FEED_OVERRIDE;
+        sys.r_override = DEFAULT_RAPID_OVERRIDE;
+
+        stubLineCount = 0;
+        stubArcCount = 0;
+        realtimeCount = 0;
+        gc_init ();
+        oword_reset ();
+#ifdef HOST_PLANNER
+        plan_reset ();
+#endif
+}
+
+bool stubSameMotion (const stub_motion_t *a, const stub_motion_t *b)
+{
+        return memcmp (a->target, b->target, sizeof (a->target)) == 0 && a->plData.feed_rate == b->plData.feed_rate
+                && a->plData.spindle_speed == b->plData.spindle_speed && a->plData.condition == b->plData.condition
+#ifdef USE_LINE_NUMBERS
+                && a->plData.line_number == b->plData.line_number
+#endif
+                ;
+}
+
+void cleanLine (char *line)
+{
+        char *out = line;
+        bool comment = false;
+
+        for (char *in = line; *in != '\0'; ++in) {
+                char c = *in;
+
+                if (comment) {
+                        comment = (c != ')');
+                }
+                else if (c == '(') {
+                        comment = true;
+                }
+                else if (c == ';') {
+                        break;
+                }
+                else if ((unsigned char)c > ' ' && c != '/') {
+                        *out++ = (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+                }
+        }
+
+        *out = '\0';
+}
+
+/****************************************************************************/
+
+#ifndef HOST_PLANNER
+void mc_line (float *target, plan_line_data_t *pl_data)
+{
+        if (stubMotions != NULL && stubLineCount < stubMotionsSize) {
+                memcpy (stubMotions[stubLineCount].target, target, sizeof (stubMotions->target));
+                stubMotions[stubLineCount].plData = *pl_data;
+        }
+
+        ++stubLineCount;
+}
+
+void mc_arc (float *target, plan_line_data_t *pl_data, float *position, float *offset, float radius, uint8_t axis_0, uint8_t axis_1,
+             uint8_t axis_linear, uint8_t is_clockwise_arc)
+{
+        ++stubArcCount;
+}
+
+void mc_dwell (float seconds) {}
+void mc_homing_cycle (uint8_t cycle_mask) {}
+void mc_reset () {}
+uint8_t mc_probe_cycle (float *target, plan_line_data_t *pl_data, uint8_t parser_flags) { return GC_UPDATE_POS_TARGET; }
+#endif
+uint8_t jog_execute (plan_line_data_t *pl_data, parser_block_t *gc_block) { return STATUS_OK; }
+
+void _spindle_sync (uint8_t state) {}
+void _spindle_set_state (uint8_t state) {}
+void coolant_sync (uint8_t mode) {}
+void coolant_set_state (uint8_t mode) {}
+
+#ifdef HOST_PLANNER
+void protocol_buffer_synchronize ()
+{
+        if (estimator_active ()) {
+                estimator_sync ();
+        }
+}
+#else
+void protocol_buffer_synchronize () {}
+#endif
+void protocol_execute_realtime ()
+{
+        if (stubRealtimeLimit != 0 && ++realtimeCount >= stubRealtimeLimit) {
+                sys.abort = true; // Like a reset sent by the user.
+        }
+}
+void protocol_exec_rt_system () {}
+
+#ifdef HOST_REPORT
+// report.c and print.c are real, what they write goes to stubSerialOut.
+char stubSerialOut[STUB_SERIAL_OUT_SIZE];
+uint32_t stubSerialOutLen;
+int32_t sys_probe_position[N_AXIS];
+float stubRealtimeRate;
+
+void stubSerialClear ()
+{
+        stubSerialOutLen = 0;
+        stubSerialOut[0] = '\0';
+}
+
+void serial_write (uint8_t data)
+{
+        if (stubSerialOutLen + 1 < STUB_SERIAL_OUT_SIZE) {
+                stubSerialOut[stubSerialOutLen++] = data;
+                stubSerialOut[stubSerialOutLen] = '\0';
+        }
+}
+
+void serial_write_span (const uint8_t *data, uint32_t len)
+{
+        for (uint32_t i = 0; i < len; ++i) {
+                serial_write (data[i]);
+        }
+}
+
+uint32_t serial_get_rx_buffer_available () { return 0; }
+uint32_t serial_get_rx_overrun_count () { return 0; }
+uint8_t plan_get_block_buffer_available () { return 0; }
+float st_get_realtime_rate () { return stubRealtimeRate; }
+uint8_t spindle_get_state () { return 0; }
+uint8_t coolant_get_state () { return 0; }
+uint8_t limits_get_state () { return 0; }
+uint8_t probe_get_state () { return false; }
+void k_timer_start (struct k_timer *timer, k_timeout_t duration, k_timeout_t period) {}
+void k_timer_stop (struct k_timer *timer) {}
+#else
+void report_status_message (uint8_t status_code) {}
+void report_feedback_message (uint8_t message_code) {}
+void report_grbl_help () {}
+void report_grbl_settings () {}
+void report_ngc_parameters () {}
+void report_gcode_modes () {}
+void report_startup_line (uint8_t n, char *line) {}
+void report_execute_startup_message (char *line, uint8_t status_code) {}
+void report_build_info (char *line) {}
+void report_estimate (estimate_t *estimate) {}
+#endif
+
+#ifndef HOST_PLANNER
+uint8_t settings_read_coord_data (uint8_t coord_select, float *coord_data)
+{
+        memset (coord_data, 0, N_AXIS * sizeof (float));
+        return true;
+}
+
+void settings_write_coord_data (uint8_t coord_select, float *coord_data) {}
+void settings_restore (uint8_t restore_flag) {}
+uint8_t settings_store_global_setting (uint8_t parameter, float value) { return STATUS_OK; }
+void settings_store_startup_line (uint8_t n, char *line) {}
+void settings_store_build_info (char *line) {}
+
+uint8_t settings_read_startup_line (uint8_t n, char *line)
+{
+        line[0] = '\0';
+        return true;
+}
+
+uint8_t settings_read_build_info (char *line)
+{
+        line[0] = '\0';
+        return true;
+}
+#endif
+
+void st_go_idle () {}
+
+// What serial.c and binary_stream.c do for serial_rx_filter. The real-time commands are only counted.
+uint32_t stubRealtimeCommands;
+
+bool serial_check_real_time_command (char data)
+{
+        uint8_t const c = data;
+        bool const realtime = c > 0x7F || c == CMD_RESET || c == CMD_STATUS_REPORT || c == CMD_CYCLE_START || c == CMD_FEED_HOLD;
+        stubRealtimeCommands += realtime;
+        return realtime;
+}
+
+bool bstream_is_receiving () { return false; }
+bool bstream_receive (uint8_t data) { return false; }
+
+#ifdef HOST_PLANNER
+// What the real planner and motion control need, which the estimator doesn't.
+int32_t sys_probe_position[N_AXIS];
+volatile uint8_t sys_probe_state;
+void limits_init () {}
+void limits_soft_check (float *target) {}
+void limits_go_home (uint8_t cycle_mask) {}
+void limits_disable () {}
+void st_reset () {}
+void st_update_plan_block_parameters () {}
+void spindle_stop () {}
+void coolant_stop () {}
+void protocol_auto_cycle_start () {}
+void probe_configure_invert_mask (uint8_t is_probe_away) {}
+uint8_t probe_get_state () { return false; }
+void report_probe_parameters () {}
+void report_auto_status_init () {}
+void spindle_init () {}
+void st_generate_step_dir_invert_masks () {}
+
+/*--------------------------------------------------------------------------*/
+/* The NVS under eeprom.c, in RAM                                           */
+/*--------------------------------------------------------------------------*/
+
+#define NVS_MAX_ID 0x40
+#define NVS_MAX_LEN 512
+
+typedef struct {
+        uint8_t data[NVS_MAX_LEN];
+        size_t len;
+        bool present;
+        uint32_t writes;
+} nvs_entry_t;
+
+static nvs_entry_t nvsEntries[NVS_MAX_ID];
+uint32_t stubNvsReads;
+uint32_t stubNvsWrites;
+uint32_t stubNvsWritesMoving;
+uint32_t stubNvsUnlocked;
+uint32_t stubMutexesHeld;
+uint32_t stubNvsFailures;
+uint32_t stubNvsFailAfter;
+
+const struct device hostFlash = {"flash"};
+
+int flash_get_page_info_by_offs (const struct device *dev, off_t offset, struct flash_pages_info *info)
+{
+        info->start_offset = 0;
+        info->size = 16384;
+        info->index = 0;
+        return 0;
+}
+
+int nvs_init (struct nvs_fs *fs, const char *dev_name) { return 0; }
+
+ssize_t nvs_read (struct nvs_fs *fs, uint16_t id, void *data, size_t len)
+{
+        ++stubNvsReads;
+        stubNvsUnlocked += (stubMutexesHeld == 0);
+
+        if (id >= NVS_MAX_ID || !nvsEntries[id].present) {
+                return -ENOENT;
+        }
+
+        memcpy (data, nvsEntries[id].data, MIN (len, nvsEntries[id].len));
+        return nvsEntries[id].len;
+}
+
+ssize_t nvs_write (struct nvs_fs *fs, uint16_t id, const void *data, size_t len)
+{
+        if (id >= NVS_MAX_ID || len > NVS_MAX_LEN) {
+                return -EINVAL;
+        }
+
+        nvs_entry_t *entry = &nvsEntries[id];
+        stubNvsUnlocked += (stubMutexesHeld == 0);
+
+        if (stubNvsFailAfter > 0) {
+                --stubNvsFailAfter;
+        }
+        else if (stubNvsFailures > 0) {
+                --stubNvsFailures;
+                return -EIO;
+        }
+
+        // Like the real one, the same data is not written again.
+        if (entry->present && entry->len == len && memcmp (entry->data, data, len) == 0) {
+                return 0;
+        }
+
+        // The stepper interrupt would have missed its deadlines.
+        if (plan_get_current_block () != NULL || (sys.state & (STATE_CYCLE | STATE_HOLD | STATE_HOMING | STATE_JOG)) != 0) {
+                ++stubNvsWritesMoving;
+        }
+
+        memcpy (entry->data, data, len);
+        entry->len = len;
+        entry->present = true;
+        ++entry->writes;
+        ++stubNvsWrites;
+        return len;
+}
+
+int nvs_delete (struct nvs_fs *fs, uint16_t id)
+{
+        stubNvsUnlocked += (stubMutexesHeld == 0);
+
+        if (id < NVS_MAX_ID) {
+                nvsEntries[id].present = false;
+        }
+
+        return 0;
+}
+
+void stubNvsErase () { memset (nvsEntries, 0, sizeof (nvsEntries)); }
+
+void stubNvsResetCounters ()
+{
+        stubNvsReads = stubNvsWrites = stubNvsWritesMoving = stubNvsUnlocked = 0;
+
+        for (int id = 0; id < NVS_MAX_ID; ++id) {
+                nvsEntries[id].writes = 0;
+        }
+}
+
+uint32_t stubNvsMaxWrites ()
+{
+        uint32_t max = 0;
+
+        for (int id = 0; id < NVS_MAX_ID; ++id) {
+                max = MAX (max, nvsEntries[id].writes);
+        }
+
+        return max;
+}
+
+void stubNvsResize (uint16_t id, size_t len) { nvsEntries[id].len = len; }
+#else
+uint8_t plan_get_block_buffer_count () { return 0; }
+uint32_t plan_get_completed_block_count () { return 0; }
+uint8_t mc_get_queued_motion_count () { return 0; }
+bool estimator_active () { return false; }
+uint8_t estimator_run_file (const char *path, estimate_t *estimate) { return STATUS_FILE_READ; }
+#endif
+
+int32_t k_msleep (int32_t ms) { return 0; }
+int32_t k_usleep (int32_t us) { return 0; }
+unsigned int irq_lock (void) { return 0; }
+void irq_unlock (unsigned int key) {}
@@ -0,0 +1,72 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+/*
+ * The rest of GRBL, as seen by the g-code parser running on a PC. Motions are
+ * recorded instead of executed.
+ */
+
+#pragma once
+#include "grbl.h"
+#ifdef HOST_PLANNER
+#include <zephyr/drivers/flash.h>
+#include <zephyr/fs/nvs.h>
+#endif
+
+// What the parser sent to mc_line.
+typedef struct {
+        float target[N_AXIS];
+        plan_line_data_t plData;
+} stub_motion_t;
+
+// Set to record the mc_line calls, NULL to only count them.
+extern stub_motion_t *stubMotions;
+extern uint32_t stubMotionsSize;
+
+extern uint32_t stubLineCount; // mc_line calls so far.
+extern uint32_t stubArcCount;  // mc_arc calls so far.
+
+// If not 0, protocol_execute_realtime sets sys.abort when called this many times.
+extern uint32_t stubRealtimeLimit;
+
+// serial_check_real_time_command calls for real-time commands.
+extern uint32_t stubRealtimeCommands;
+
+// Zeroes the counters, the machine state and the parser.
+void stubReset ();
+
+// True if both motions would have been planned the same.
+bool stubSameMotion (const stub_motion_t *a, const stub_motion_t *b);
+
+#ifdef HOST_PLANNER
+// The NVS under eeprom.c is kept in RAM. Writes of unchanged data don't count, like with the real one.
+extern uint32_t stubNvsReads;
+extern uint32_t stubNvsWrites;
+extern uint32_t stubNvsWritesMoving; // Done with motions planned or running, which would stall the steppers.
+extern uint32_t stubNvsUnlocked;     // NVS calls made without holding eeprom_nvs_lock.
+extern uint32_t stubNvsFailures;     // That many next writes fail.
+extern uint32_t stubNvsFailAfter;    // After that many have succeeded, power lost in the middle.
+
+void stubNvsErase ();
+void stubNvsResetCounters ();
+uint32_t stubNvsMaxWrites (); // Of a single ID, since the counters were reset.
+void stubNvsResize (uint16_t id, size_t len);
+#endif
+
+#ifdef HOST_REPORT
+// The output of report.c and print.c since the last stubSerialClear, 0 terminated.
+#define STUB_SERIAL_OUT_SIZE 1024
+extern char stubSerialOut[STUB_SERIAL_OUT_SIZE];
+extern uint32_t stubSerialOutLen;
+extern float stubRealtimeRate; // st_get_realtime_rate
+
+void stubSerialClear ();
+#endif
+
+// Strips white space and comments and capitalizes, like protocol_main_loop does.
+void cleanLine (char *line);
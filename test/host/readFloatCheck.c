@@ -0,0 +1,101 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#include "readFloatCheck.h"
+#include "grbl.h"
+#include <ctype.h>
+#include <float.h>
+#include <stdio.h>
+
+// Relative error allowed. read_float rounds to float a few times on the way.
+#define ULPS 8
+
+/**
+ * Returns the number of characters of the number, 0 if there is none.
+ */
+static size_t referenceReadFloat (const char *line, double *value)
+{
+        const char *p = line;
+        int digits = 0;
+
+        if (*p == '+' || *p == '-') {
+                ++p;
+        }
+
+        while (isdigit ((unsigned char)*p)) {
+                ++p;
+                ++digits;
+        }
+
+        if (*p == '.') {
+                ++p;
+
+                while (isdigit ((unsigned char)*p)) {
+                        ++p;
+                        ++digits;
+                }
+        }
+
+        if (digits == 0) {
+                return 0;
+        }
+
+        char number[LINE_BUFFER_SIZE];
+        size_t len = p - line;
+
+        if (len >= sizeof (number)) {
+                return 0;
+        }
+
+        memcpy (number, line, len);
+        number[len] = '\0';
+        *value = strtod (number, NULL);
+        return len;
+}
+
+bool readFloatCheck (const char *line, char *message, size_t messageSize)
+{
+        char copy[LINE_BUFFER_SIZE];
+
+        if (strlen (line) >= sizeof (copy)) {
+                return true; // Protocol never passes longer lines.
+        }
+
+        strcpy (copy, line);
+        uint8_t charCounter = 0;
+        float value = 0;
+        bool ok = read_float (copy, &charCounter, &value);
+
+        double reference = 0;
+        size_t referenceLen = referenceReadFloat (line, &reference);
+
+        if (ok != (referenceLen > 0)) {
+                snprintf (message, messageSize, "\"%s\": read_float %s, reference %s", line, ok ? "accepts" : "rejects",
+                          (referenceLen > 0) ? "accepts" : "rejects");
+                return false;
+        }
+
+        if (!ok) {
+                return true;
+        }
+
+        if (charCounter != referenceLen) {
+                snprintf (message, messageSize, "\"%s\": read_float stops at %u, reference at %zu", line, charCounter, referenceLen);
+                return false;
+        }
+
+        float expected = (float)reference;
+        double error = fabs ((double)value - (double)expected);
+
+        if (error > fabs ((double)expected) * ULPS * FLT_EPSILON && !(isinf (value) && isinf (expected))) {
+                snprintf (message, messageSize, "\"%s\": read_float %.9g, reference %.9g", line, value, expected);
+                return false;
+        }
+
+        return true;
+}
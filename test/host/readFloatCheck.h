@@ -0,0 +1,21 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+/*
+ * read_float() against a strtod based reference. Both must accept the same
+ * numbers ([+-] digits [. digits], at least one digit), stop at the same
+ * character and agree on the value within float precision.
+ */
+
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+
+// Checks the number at the start of `line`. On a divergence returns false and
+// describes it in `message`.
+bool readFloatCheck (const char *line, char *message, size_t messageSize);
@@ -0,0 +1,134 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+/*
+ * Differential test of read_float() against strtod. Every string up to
+ * SHORT_LENGTH characters over a small alphabet, then longer numbers built
+ * from sign, integer and fraction parts of every length up to PART_LENGTH with
+ * digit patterns which stress rounding and the digit limit (leading zeros, all
+ * nines, random). Each one also with a word following it. Prints the
+ * divergences and returns 1 if there were any.
+ *
+ * Usage: read-float-diff [max printed]
+ */
+
+#include "readFloatCheck.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SHORT_LENGTH 7
+#define PART_LENGTH 14
+#define RANDOM_PATTERNS 200
+
+static const char alphabet[] = "0159.-+";
+static uint64_t checked;
+static uint64_t divergences;
+static unsigned maxPrinted = 20;
+
+static void check (const char *number)
+{
+        char line[128];
+        char message[256];
+
+        // Alone and followed by another word, the way it's seen in a g-code line.
+        snprintf (line, sizeof (line), "%s", number);
+        for (int i = 0; i < 2; ++i) {
+                ++checked;
+
+                if (!readFloatCheck (line, message, sizeof (message))) {
+                        if (divergences++ < maxPrinted) {
+                                printf ("%s\n", message);
+                        }
+                }
+
+                snprintf (line, sizeof (line), "%sX1", number);
+        }
+}
+
+static void shortStrings (char *buffer, int length, int max)
+{
+        buffer[length] = '\0';
+        check (buffer);
+
+        if (length == max) {
+                return;
+        }
+
+        for (const char *a = alphabet; *a != '\0'; ++a) {
+                buffer[length] = *a;
+                shortStrings (buffer, length + 1, max);
+        }
+}
+
+/**
+ * Fills `len` digits following `pattern`: 0 zeros, 1 nines, 2 leading zeros then
+ * ones, 3 a one then zeros, anything else random.
+ */
+static void digits (char *out, int len, int pattern)
+{
+        for (int i = 0; i < len; ++i) {
+                switch (pattern) {
+                case 0:
+                        out[i] = '0';
+                        break;
+                case 1:
+                        out[i] = '9';
+                        break;
+                case 2:
+                        out[i] = (i < len / 2) ? '0' : '1';
+                        break;
+                case 3:
+                        out[i] = (i == 0) ? '1' : '0';
+                        break;
+                default:
+                        out[i] = '0' + rand () % 10;
+                        break;
+                }
+        }
+
+        out[len] = '\0';
+}
+
+static void longNumbers ()
+{
+        char integer[PART_LENGTH + 1];
+        char fraction[PART_LENGTH + 1];
+        char number[2 * PART_LENGTH + 3];
+
+        for (int pattern = 0; pattern < 4 + RANDOM_PATTERNS; ++pattern) {
+                for (int i = 0; i <= PART_LENGTH; ++i) {
+                        for (int f = 0; f <= PART_LENGTH; ++f) {
+                                digits (integer, i, pattern);
+                                digits (fraction, f, (pattern < 4) ? (pattern + f) % 4 : pattern);
+                                snprintf (number, sizeof (number), "%s.%s", integer, fraction);
+                                check (number);
+                                snprintf (number, sizeof (number), "-%s.%s", integer, fraction);
+                                check (number);
+                                snprintf (number, sizeof (number), "%s", integer);
+                                check (number);
+                        }
+                }
+        }
+}
+
+int main (int argc, char **argv)
+{
+        if (argc > 1) {
+                maxPrinted = atoi (argv[1]);
+        }
+
+        srand (1);
+        char buffer[SHORT_LENGTH + 1];
+        shortStrings (buffer, 0, SHORT_LENGTH);
+        longNumbers ();
+
+        printf ("%llu strings checked, %llu divergences\n", (unsigned long long)checked, (unsigned long long)divergences);
+        return (divergences > 0) ? 1 : 0;
+}
@@ -0,0 +1,187 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+/*
+ * Checks the g-code written by resume_state_line. The file is run once and the
+ * resume state saved after every line. Then, from every n-th line (unless it
+ * leaves an arc mode on, which can't be restored), a fresh parser is given the
+ * resume lines followed by the next REPLAY lines of the file. It must end up
+ * in the same state as in the first run: the same modes, the same machine
+ * position if homing is enabled, the same work position otherwise. Prints the
+ * divergences and returns 1 if there were any.
+ *
+ * Usage: resume-check [file.ngc] [every n-th line]
+ */
+
+#include "grblStubs.h"
+#include <math.h>
+#include <stdio.h>
+
+#define MAX_LINES 65536
+#define REPLAY 20
+#define POSITION_TOLERANCE 1e-3 // mm
+#define MAX_PRINTED 20
+
+static char *lines[MAX_LINES];
+static uint32_t lineCount;
+static parser_state_t *states;   // After every line of the first run.
+static resume_state_t *resumes;  // Same.
+static uint8_t *statuses;
+static uint32_t divergences;
+
+static bool load (const char *path)
+{
+        FILE *file = fopen (path, "r");
+
+        if (file == NULL) {
+                perror (path);
+                return false;
+        }
+
+        char buffer[256];
+
+        while (lineCount < MAX_LINES && fgets (buffer, sizeof (buffer), file) != NULL) {
+                cleanLine (buffer);
+
+                if (buffer[0] != '\0' && strlen (buffer) < LINE_BUFFER_SIZE) {
+                        lines[lineCount++] = strdup (buffer);
+                }
+        }
+
+        fclose (file);
+        return true;
+}
+
+static uint8_t execute (const char *text)
+{
+        char line[LINE_BUFFER_SIZE];
+        strcpy (line, text); // The parser may modify the line.
+        return (line[0] == '$') ? system_execute_line (line) : gc_execute_line (line);
+}
+
+static void reset (bool homing)
+{
+        stubReset ();
+
+        if (homing) {
+                settings.flags |= BITFLAG_HOMING_ENABLE;
+        }
+}
+
+static void workPosition (const parser_state_t *state, float *work)
+{
+        for (uint8_t idx = 0; idx < N_AXIS; ++idx) {
+                work[idx] = state->position[idx] - state->coord_system[idx] - state->coord_offset[idx];
+
+                if (idx == TOOL_LENGTH_OFFSET_AXIS) {
+                        work[idx] -= state->tool_length_offset;
+                }
+        }
+}
+
+static bool closeTo (const float *a, const float *b)
+{
+        for (uint8_t idx = 0; idx < N_AXIS; ++idx) {
+                if (fabsf (a[idx] - b[idx]) > POSITION_TOLERANCE) {
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+static bool nearlyEqual (float a, float b) { return fabsf (a - b) <= 1e-5F * fmaxf (1.0F, fabsf (a)); }
+
+static bool sameState (const parser_state_t *expected, bool homing)
+{
+        // In G93 every motion line has its own feed rate.
+        bool inverseTime = (gc_state.modal.feed_rate == FEED_RATE_MODE_INVERSE_TIME);
+
+        if (memcmp (&expected->modal, &gc_state.modal, sizeof (gc_modal_t)) != 0
+            || (!inverseTime && !nearlyEqual (expected->feed_rate, gc_state.feed_rate))
+            || !nearlyEqual (expected->spindle_speed, gc_state.spindle_speed)) {
+                return false;
+        }
+
+        float expectedWork[N_AXIS];
+        float work[N_AXIS];
+        workPosition (expected, expectedWork);
+        workPosition (&gc_state, work);
+        return closeTo (expectedWork, work) && (!homing || closeTo (expected->position, gc_state.position));
+}
+
+static void diverged (uint32_t from, uint32_t at, bool homing, const char *what)
+{
+        if (divergences++ < MAX_PRINTED) {
+                printf ("Resumed after line %u (%s), %s at line %u: %s\n", from + 1, homing ? "homing" : "no homing", what, at + 1, lines[at]);
+        }
+}
+
+static void check (uint32_t from, bool homing)
+{
+        reset (homing);
+        char line[LINE_BUFFER_SIZE];
+
+        for (uint8_t n = 0; resume_state_line (&resumes[from], n, line, sizeof (line)); ++n) {
+                if (execute (line) != STATUS_OK) {
+                        diverged (from, from, homing, line);
+                        return;
+                }
+        }
+
+        if (!sameState (&states[from], homing)) {
+                diverged (from, from, homing, "different state");
+                return;
+        }
+
+        for (uint32_t i = from + 1; i < lineCount && i <= from + REPLAY; ++i) {
+                if (execute (lines[i]) != statuses[i]) {
+                        diverged (from, i, homing, "different status");
+                        return;
+                }
+
+                if (!sameState (&states[i], homing)) {
+                        diverged (from, i, homing, "different state");
+                        return;
+                }
+        }
+}
+
+int main (int argc, char **argv)
+{
+        const char *path = (argc > 1) ? argv[1] : "samples/sphere.ngc";
+        uint32_t every = (argc > 2) ? atoi (argv[2]) : 1;
+
+        if (!load (path) || lineCount == 0 || every == 0) {
+                return 1;
+        }
+
+        states = calloc (lineCount, sizeof (parser_state_t));
+        resumes = calloc (lineCount, sizeof (resume_state_t));
+        statuses = calloc (lineCount, 1);
+        reset (true);
+
+        for (uint32_t i = 0; i < lineCount; ++i) {
+                statuses[i] = execute (lines[i]);
+                states[i] = gc_state;
+                resume_state_save (&resumes[i]);
+        }
+
+        uint32_t checked = 0;
+
+        for (uint32_t i = 0; i < lineCount; i += every) {
+                if (resume_state_restorable (&resumes[i])) {
+                        check (i, true);
+                        check (i, false);
+                        ++checked;
+                }
+        }
+
+        printf ("%s, %u lines, resumed from %u of them, %u divergences\n", path, lineCount, checked, divergences);
+        return (divergences == 0) ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+/*
+ * Checks serial_rx_filter (the word at a time scan of the received bytes)
+ * against a byte at a time reference: the bytes kept, the real-time commands
+ * picked off and the line ends counted, which tell the main loop a channel has
+ * a line to read. Random packets of g-code with line ends, real-time commands
+ * and extended ASCII, at every alignment. Returns 1 on a difference.
+ *
+ * Usage: serial-rx-check
+ */
+
+#include "grblStubs.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PACKETS 200000
+#define MAX_PACKET 128
+#define MAX_PRINTED 10
+
+static uint32_t failures;
+
+static void printPacket (const uint8_t *data, uint32_t len)
+{
+        for (uint32_t i = 0; i < len; ++i) {
+                printf ((data[i] >= ' ' && data[i] < 0x7f) ? "%c" : "\\x%02x", data[i]);
+        }
+}
+
+static void check (const char *name, const uint8_t *packet, uint32_t len)
+{
+        // One byte at a time, the way the ISR used to do it.
+        uint8_t expected[MAX_PACKET];
+        uint32_t expectedLen = 0;
+        uint32_t expectedEol = 0;
+        stubRealtimeCommands = 0;
+
+        for (uint32_t i = 0; i < len; ++i) {
+                if (!serial_check_real_time_command (packet[i])) {
+                        expected[expectedLen++] = packet[i];
+                        expectedEol += (packet[i] == '\n' || packet[i] == '\r');
+                }
+        }
+
+        uint32_t const expectedRealtime = stubRealtimeCommands;
+
+        // At every alignment, the words are loaded unaligned.
+        for (uint32_t offset = 0; offset < sizeof (uint32_t); ++offset) {
+                uint8_t buffer[MAX_PACKET + sizeof (uint32_t)];
+                memcpy (buffer + offset, packet, len);
+                uint32_t eol = 1; // Added to.
+                stubRealtimeCommands = 0;
+                uint32_t kept = serial_rx_filter (buffer + offset, len, false, &eol);
+                bool ok = kept == expectedLen && memcmp (buffer + offset, expected, kept) == 0 && eol == expectedEol + 1
+                        && stubRealtimeCommands == expectedRealtime;
+
+                if (!ok && failures++ < MAX_PRINTED) {
+                        printf ("%s \"", name);
+                        printPacket (packet, len);
+                        printf ("\" at +%u: kept %u eol %u real-time %u, expected %u, %u, %u\n", offset, kept, eol - 1, stubRealtimeCommands,
+                                expectedLen, expectedEol, expectedRealtime);
+                }
+        }
+}
+
+static uint8_t randomByte ()
+{
+        static const char gcode[] = "G0123456789XYZF. -";
+        static const uint8_t special[] = {'\n', '\r', CMD_RESET, CMD_STATUS_REPORT, CMD_CYCLE_START, CMD_FEED_HOLD};
+        int r = rand () % 100;
+
+        if (r < 80) {
+                return gcode[rand () % (sizeof (gcode) - 1)];
+        }
+
+        if (r < 95) {
+                return special[rand () % sizeof (special)];
+        }
+
+        return 0x80 + rand () % 0x80;
+}
+
+int main ()
+{
+        const char *line = "G1 X10 Y20\r\nG0 X0\n?G1 X1\n";
+        check ("Lines", (const uint8_t *)line, strlen (line));
+        srand (1);
+
+        for (uint32_t p = 0; p < PACKETS; ++p) {
+                uint8_t packet[MAX_PACKET];
+                uint32_t len = rand () % (MAX_PACKET + 1);
+                // Mostly plain g-code, the word at a time path.
+                bool plain = p % 2 == 0;
+
+                for (uint32_t i = 0; i < len; ++i) {
+                        packet[i] = plain && rand () % 20 != 0 ? "G1X0.5Y\n"[rand () % 8] : randomByte ();
+                }
+
+                check ("Random", packet, len);
+        }
+
+        printf ("%u packets, %u failures\n", PACKETS + 1, failures);
+        return (failures != 0) ? 1 : 0;
+}
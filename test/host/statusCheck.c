@@ -0,0 +1,205 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+/*
+ * Checks the positions in the status report (the integer formatting of
+ * report_realtime_status) against the float path it replaced: the steps
+ * converted with system_convert_array_steps_to_mpos, less the work offset, and
+ * printed with printFloat_CoordValue. In mm and in inches ($13), MPos and WPos,
+ * for a sweep of positions and a few steps/mm settings. A float has 7 digits,
+ * so the old path is often off by one in the last one (1428.583 printed as
+ * 1428.584), and the inches are rounded twice (to micrometres first) by the new
+ * one. Off by one in the last digit is allowed, more is an error (like the 10x
+ * of a wrong unit). In mm the report must also be the exact value, computed in
+ * double and rounded half away from zero. Prints the differences and returns 1
+ * if there were any.
+ *
+ * Usage: status-check
+ */
+
+#include "grblStubs.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_PRINTED 20
+
+static uint32_t checked;
+static uint32_t lastDigit; // Off by one in the last digit.
+static uint32_t errors;
+
+// The text of the position field of the report, without the "MPos:".
+static void reportedPosition (char *buf, size_t size)
+{
+        stubSerialClear ();
+        report_realtime_status ();
+        const char *start = strstr (stubSerialOut, "Pos:");
+        buf[0] = '\0';
+
+        if (start == NULL) {
+                return;
+        }
+
+        start += 4;
+        size_t len = strcspn (start, "|>");
+        len = MIN (len, size - 1);
+        memcpy (buf, start, len);
+        buf[len] = '\0';
+}
+
+// The same, the way GRBL used to print it.
+static void floatPosition (char *buf, size_t size, bool work)
+{
+        float position[N_AXIS];
+        system_convert_array_steps_to_mpos (position, sys_position);
+        stubSerialClear ();
+
+        for (uint8_t idx = 0; idx < N_AXIS; idx++) {
+                if (work) {
+                        position[idx] -= gc_state.coord_system[idx] + gc_state.coord_offset[idx];
+
+                        if (idx == TOOL_LENGTH_OFFSET_AXIS) {
+                                position[idx] -= gc_state.tool_length_offset;
+                        }
+                }
+
+                printFloat_CoordValue (position[idx]);
+
+                if (idx < N_AXIS - 1) {
+                        serial_write (',');
+                }
+        }
+
+        size_t len = MIN (stubSerialOutLen, size - 1);
+        memcpy (buf, stubSerialOut, len);
+        buf[len] = '\0';
+}
+
+// True if the reported mm are the exact values rounded half away from zero. Near a half
+// either way is fine: the micrometres per step are a Q24 number in the report, off by up
+// to half of 2^-24 of a micrometre per step.
+static bool exactMm (const char *reported, bool work)
+{
+        for (uint8_t idx = 0; idx < N_AXIS; idx++) {
+                int32_t steps = sys_position[idx];
+#ifdef COREXY
+                if (idx == X_AXIS) {
+                        steps = system_convert_corexy_to_x_axis_steps (sys_position);
+                }
+                else if (idx == Y_AXIS) {
+                        steps = system_convert_corexy_to_y_axis_steps (sys_position);
+                }
+#endif
+                double um = steps * 1000.0 / settings.steps_per_mm[idx];
+
+                if (work) { // The offsets are set in micrometres, the rest is the noise of the float.
+                        um -= lround ((gc_state.coord_system[idx] + gc_state.coord_offset[idx]) * 1000.0);
+                }
+
+                char *end = NULL;
+                double shown = strtod (reported, &end) * 1000.0;
+                double const slack = fabs ((double)steps) / (1 << 25) + 1e-6;
+
+                if (lround (shown) != lround (um) && fabs (fabs (um - trunc (um)) - 0.5) > slack) {
+                        return false;
+                }
+
+                reported = (*end == ',') ? end + 1 : end;
+        }
+
+        return true;
+}
+
+// True if a and b are the same numbers, but for one unit of the last digit of one of them.
+static bool offByOne (const char *a, const char *b)
+{
+        char *endA = NULL;
+        char *endB = NULL;
+
+        while (*a != '\0' && *b != '\0') {
+                double x = strtod (a, &endA);
+                double y = strtod (b, &endB);
+                const char *dot = strchr (a, '.');
+                double unit = (dot != NULL && dot < endA) ? pow (10, -(endA - dot - 1)) : 1;
+
+                if (fabs (x - y) > unit * 1.5) {
+                        return false;
+                }
+
+                a = (*endA == ',') ? endA + 1 : endA;
+                b = (*endB == ',') ? endB + 1 : endB;
+        }
+
+        return *a == *b;
+}
+
+static void check (bool inches, bool work, float stepsPerMm)
+{
+        settings.flags = inches ? BITFLAG_REPORT_INCHES : 0;
+        settings.status_report_mask = work ? 0 : BITFLAG_RT_STATUS_POSITION_TYPE;
+
+        for (uint8_t idx = 0; idx < N_AXIS; idx++) {
+                settings.steps_per_mm[idx] = stepsPerMm * (idx + 1);
+        }
+
+        gc_state.coord_system[X_AXIS] = work ? 12.345f : 0;
+        gc_state.coord_system[Y_AXIS] = work ? -0.5f : 0;
+        gc_state.coord_offset[Z_AXIS] = work ? 3.0f : 0;
+        srand (1);
+
+        for (uint32_t i = 0; i < 20000; i++) {
+                for (uint8_t idx = 0; idx < N_AXIS; idx++) {
+                        // Small ones, where the rounding shows, and anything up to a couple of metres.
+                        int32_t range = (i % 2 == 0) ? 200 : (int32_t)(2000 * settings.steps_per_mm[idx]);
+                        sys_position[idx] = rand () % (2 * range + 1) - range;
+                }
+
+                char reported[128];
+                char expected[128];
+                sys.report_wco_counter = 0; // The work offset is picked up at once.
+                reportedPosition (reported, sizeof (reported));
+                floatPosition (expected, sizeof (expected), work);
+                checked++;
+
+                if (!inches) {
+                        if (!exactMm (reported, work) && errors++ < MAX_PRINTED) {
+                                printf ("mm %s %g steps/mm, steps %d,%d,%d: reported %s, not the exact value\n", work ? "WPos" : "MPos", stepsPerMm,
+                                        sys_position[0], sys_position[1], sys_position[2], reported);
+                        }
+                }
+
+                if (strcmp (reported, expected) == 0) {
+                        continue;
+                }
+
+                if (offByOne (reported, expected)) {
+                        lastDigit++;
+                        continue;
+                }
+
+                if (errors++ < MAX_PRINTED) {
+                        printf ("%s %s %g steps/mm, steps %d,%d,%d: reported %s, was %s\n", inches ? "in" : "mm", work ? "WPos" : "MPos", stepsPerMm,
+                                sys_position[0], sys_position[1], sys_position[2], reported, expected);
+                }
+        }
+}
+
+int main ()
+{
+        stubReset ();
+        float const stepsPerMm[] = {80, 100, 157.48f, 3.3f};
+
+        for (size_t s = 0; s < sizeof (stepsPerMm) / sizeof (stepsPerMm[0]); s++) {
+                for (int mode = 0; mode < 4; mode++) {
+                        check (mode & 1, mode & 2, stepsPerMm[s]);
+                }
+        }
+
+        printf ("%u positions, %u off by one in the last digit, %u wrong\n", checked, lastDigit, errors);
+        return (errors != 0) ? 1 : 0;
+}
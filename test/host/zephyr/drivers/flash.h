@@ -0,0 +1,33 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+/*
+ * The flash device eeprom.c puts the NVS on. Implemented by the test (eepromCheck.c).
+ */
+
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+struct device {
+        const char *name;
+};
+
+struct flash_pages_info {
+        off_t start_offset;
+        size_t size;
+        uint32_t index;
+};
+
+extern const struct device hostFlash;
+#define DEVICE_DT_GET(node) (&hostFlash)
+
+static inline bool device_is_ready (const struct device *dev) { return dev != NULL; }
+int flash_get_page_info_by_offs (const struct device *dev, off_t offset, struct flash_pages_info *info);
@@ -0,0 +1,26 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+/*
+ * The NVS API, implemented by the test (eepromCheck.c) in RAM.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <sys/types.h>
+
+struct nvs_fs {
+        off_t offset;
+        uint16_t sector_size;
+        uint16_t sector_count;
+};
+
+int nvs_init (struct nvs_fs *fs, const char *dev_name);
+ssize_t nvs_read (struct nvs_fs *fs, uint16_t id, void *data, size_t len);
+ssize_t nvs_write (struct nvs_fs *fs, uint16_t id, const void *data, size_t len);
+int nvs_delete (struct nvs_fs *fs, uint16_t id);
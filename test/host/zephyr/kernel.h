@@ -0,0 +1,88 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+/*
+ * Just enough of Zephyr to compile the GRBL headers on a PC. The GRBL sources
+ * tested here must not need more than that.
+ */
+
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/sys/slist.h>
+
+#define ARG_UNUSED(x) (void)(x)
+#define BUILD_ASSERT(cond, msg) _Static_assert (cond, msg)
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+
+typedef long atomic_t;
+
+typedef struct {
+        int64_t ms;
+} k_timeout_t;
+
+#define K_MSEC(t) ((k_timeout_t){(t)})
+#define K_FOREVER ((k_timeout_t){-1})
+
+struct k_timer {
+        void (*expiry) (struct k_timer *timer);
+};
+
+#define K_TIMER_DEFINE(name, expiry_fn, stop_fn) struct k_timer name = {.expiry = (expiry_fn)}
+
+void k_timer_start (struct k_timer *timer, k_timeout_t duration, k_timeout_t period);
+void k_timer_stop (struct k_timer *timer);
+
+static inline long atomic_set (atomic_t *target, long value)
+{
+        long old = *target;
+        *target = value;
+        return old;
+}
+
+static inline bool atomic_cas (atomic_t *target, long old, long value)
+{
+        if (*target != old) {
+                return false;
+        }
+
+        *target = value;
+        return true;
+}
+
+/// The tests are single threaded. The mutexes only count how many are held (stubMutexesHeld,
+/// grblStubs.c).
+extern uint32_t stubMutexesHeld;
+
+struct k_mutex {
+        int count;
+};
+
+#define K_MUTEX_DEFINE(name) struct k_mutex name
+
+static inline int k_mutex_lock (struct k_mutex *mutex, k_timeout_t timeout)
+{
+        ARG_UNUSED (timeout);
+        ++mutex->count;
+        ++stubMutexesHeld;
+        return 0;
+}
+
+static inline int k_mutex_unlock (struct k_mutex *mutex)
+{
+        --mutex->count;
+        --stubMutexesHeld;
+        return 0;
+}
+
+int32_t k_msleep (int32_t ms);
+int32_t k_usleep (int32_t us);
+unsigned int irq_lock (void);
+void irq_unlock (unsigned int key);
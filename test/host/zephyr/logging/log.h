@@ -0,0 +1,15 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#pragma once
+#include <stdio.h>
+
+#define LOG_MODULE_REGISTER(name) extern int logModule
+#define LOG_ERR(...) (printf (__VA_ARGS__), printf ("\n"))
+#define LOG_WRN(...) (printf (__VA_ARGS__), printf ("\n"))
+#define LOG_INF(...) (void)0
@@ -0,0 +1,14 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#pragma once
+
+// One storage partition at the start of the flash.
+#define DT_NODE_BY_FIXED_PARTITION_LABEL(label) 0
+#define DT_MTD_FROM_FIXED_PARTITION(node) 0
+#define FLASH_AREA_OFFSET(label) 0
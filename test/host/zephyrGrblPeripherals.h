@@ -0,0 +1,14 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+/*
+ * Replaces src/zephyrGrblPeripherals.h. No peripherals on a PC.
+ */
+
+#pragma once
+#include <zephyr/logging/log.h>
@@ -0,0 +1,202 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#include "gcz.h"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <vector>
+
+namespace {
+
+/*
+ * "G21\nG0 X10.000 Y0 (move)\nG1 X20 F1000\nG1 X30\nG1 X40\n" compressed with
+ * deps/gnea-grbl/doc/script/gcz.py.
+ */
+const std::vector<uint8_t> SMALL_JOB = {0x47, 0x43, 0x5a, 0x31, 0x23, 0x00, 0x00, 0x00, 0x90, 0xe1, 0x51, 0x5d, 0xff, 0x47, 0x32,
+                                        0x31, 0x0a, 0x47, 0x30, 0x58, 0x31, 0xff, 0x30, 0x59, 0x30, 0x0a, 0x47, 0x31, 0x58, 0x32,
+                                        0x5f, 0x30, 0x46, 0x31, 0x30, 0x30, 0x0a, 0x20, 0x33, 0x05, 0x20, 0x07, 0x34, 0x30, 0x0a};
+
+const std::string SMALL_JOB_DECODED = "G21\nG0X10Y0\nG1X20F1000\nG1X30\nG1X40\n";
+
+/// Header for `decoded`, the CRC computed like the encoder does.
+std::vector<uint8_t> header (std::string const &decoded)
+{
+        uint32_t crc = 0xffffffffU;
+
+        for (char c : decoded) {
+                crc = gcz::crc32Update (crc, c);
+        }
+
+        crc ^= 0xffffffffU;
+        uint32_t size = decoded.size ();
+        return {'G',
+                'C',
+                'Z',
+                '1',
+                uint8_t (size),
+                uint8_t (size >> 8),
+                uint8_t (size >> 16),
+                uint8_t (size >> 24),
+                uint8_t (crc),
+                uint8_t (crc >> 8),
+                uint8_t (crc >> 16),
+                uint8_t (crc >> 24)};
+}
+
+/// Feeds `file` in chunks of `chunk` bytes.
+gcz::Status decode (gcz::Decoder &decoder, std::vector<uint8_t> const &file, size_t chunk, std::string &out)
+{
+        gcz::Status status = gcz::Status::ok;
+
+        for (size_t i = 0; i < file.size () && status == gcz::Status::ok; i += chunk) {
+                status = decoder.feed (file.data () + i, std::min (chunk, file.size () - i), [&out] (uint8_t c) { out += char (c); });
+        }
+
+        return status;
+}
+
+} // namespace
+
+TEST_CASE ("Whole file", "[gcz]")
+{
+        gcz::Decoder decoder;
+        std::string out;
+
+        SECTION ("At once")
+        {
+                REQUIRE (decode (decoder, SMALL_JOB, SMALL_JOB.size (), out) == gcz::Status::finished);
+                REQUIRE (out == SMALL_JOB_DECODED);
+        }
+
+        SECTION ("Byte by byte")
+        {
+                REQUIRE (decode (decoder, SMALL_JOB, 1, out) == gcz::Status::finished);
+                REQUIRE (out == SMALL_JOB_DECODED);
+        }
+
+        SECTION ("Reused")
+        {
+                REQUIRE (decode (decoder, SMALL_JOB, 7, out) == gcz::Status::finished);
+                decoder.reset ();
+                out.clear ();
+                REQUIRE (decode (decoder, SMALL_JOB, 5, out) == gcz::Status::finished);
+                REQUIRE (out == SMALL_JOB_DECODED);
+                REQUIRE (decoder.decoded () == decoder.decodedSize ());
+        }
+
+        SECTION ("Not fed entirely")
+        {
+                REQUIRE (decode (decoder, {SMALL_JOB.begin (), SMALL_JOB.end () - 1}, 3, out) == gcz::Status::ok);
+                REQUIRE (decoder.status () == gcz::Status::ok);
+        }
+}
+
+TEST_CASE ("Matches", "[gcz]")
+{
+        gcz::Decoder decoder;
+        std::string out;
+
+        SECTION ("Overlapping")
+        {
+                // Literal 'A', then 5 bytes from 1 back.
+                auto file = header ("AAAAAA");
+                file.insert (file.end (), {0b01, 'A', 0x00, (5 - gcz::MIN_MATCH) << (gcz::WINDOW_BITS - 8)});
+                REQUIRE (decode (decoder, file, 1, out) == gcz::Status::finished);
+                REQUIRE (out == "AAAAAA");
+        }
+
+        SECTION ("Longest and farthest")
+        {
+                std::string decoded (gcz::WINDOW_SIZE, 'x');
+                decoded.front () = 'y';
+                decoded += decoded.substr (0, gcz::MAX_MATCH);
+
+                auto file = header (decoded);
+                file.insert (file.end (), {0xff, 'y'});
+                int items = 1;
+
+                for (size_t i = 1; i < gcz::WINDOW_SIZE; ++i, ++items) {
+                        if (items % 8 == 0) {
+                                file.push_back (0xff);
+                        }
+                        file.push_back ('x');
+                }
+
+                // Item 4096, a flag byte with only the match bit clear.
+                file.push_back (0xfe);
+                uint16_t item = ((gcz::MAX_MATCH - gcz::MIN_MATCH) << gcz::WINDOW_BITS) | (gcz::WINDOW_SIZE - 1);
+                file.insert (file.end (), {uint8_t (item), uint8_t (item >> 8)});
+
+                REQUIRE (decode (decoder, file, 100, out) == gcz::Status::finished);
+                REQUIRE (out == decoded);
+        }
+
+        SECTION ("Before the start")
+        {
+                auto file = header ("AAAAA");
+                file.insert (file.end (), {0b01, 'A', 0x01, 0x00}); // 2 back
+                REQUIRE (decode (decoder, file, 1, out) == gcz::Status::badData);
+        }
+
+        SECTION ("Past the end")
+        {
+                auto file = header ("AAA");
+                file.insert (file.end (), {0b01, 'A', 0x00, 0x10}); // 4 more
+                REQUIRE (decode (decoder, file, 4, out) == gcz::Status::badData);
+        }
+}
+
+TEST_CASE ("Damaged files", "[gcz]")
+{
+        gcz::Decoder decoder;
+        std::string out;
+
+        SECTION ("Not a gcz")
+        {
+                std::vector<uint8_t> file{'G', '2', '1', '\n', 'G', '0', 'X', '1', '\n', 0, 0, 0, 0, 0};
+                REQUIRE (decode (decoder, file, 1, out) == gcz::Status::badHeader);
+                REQUIRE (out.empty ());
+        }
+
+        SECTION ("Bad CRC")
+        {
+                auto file = SMALL_JOB;
+                file[8] ^= 1;
+                REQUIRE (decode (decoder, file, 16, out) == gcz::Status::badCrc);
+        }
+
+        SECTION ("Flipped bit")
+        {
+                auto file = SMALL_JOB;
+                file[20] ^= 0x10;
+                REQUIRE (decode (decoder, file, 16, out) == gcz::Status::badCrc);
+        }
+
+        SECTION ("Trailing garbage")
+        {
+                REQUIRE (decode (decoder, SMALL_JOB, 1, out) == gcz::Status::finished);
+                uint8_t garbage = 0;
+                REQUIRE (decoder.feed (&garbage, 1, [] (uint8_t) {}) == gcz::Status::badData);
+        }
+
+        SECTION ("Stays failed")
+        {
+                auto file = SMALL_JOB;
+                file[0] = 'X';
+                REQUIRE (decode (decoder, file, 1, out) == gcz::Status::badHeader);
+                REQUIRE (decoder.feed (SMALL_JOB.data (), SMALL_JOB.size (), [] (uint8_t) {}) == gcz::Status::badHeader);
+        }
+}
+
+TEST_CASE ("Empty job", "[gcz]")
+{
+        gcz::Decoder decoder;
+        std::string out;
+        REQUIRE (decode (decoder, header (""), 1, out) == gcz::Status::finished);
+        REQUIRE (out.empty ());
+}
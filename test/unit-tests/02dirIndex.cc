@@ -0,0 +1,71 @@
+/****************************************************************************
+ *                                                                          *
+ *  Author : lukasz.iwaszkiewicz@gmail.com                                  *
+ *  ~~~~~~~~                                                                *
+ *  License : see COPYING file for details.                                 *
+ *  ~~~~~~~~~                                                               *
+ ****************************************************************************/
+
+#include "dirIndex.h"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+
+TEST_CASE ("Sorted", "[dirIndex]")
+{
+        sd::DirIndex<8, 64> index;
+        REQUIRE (index.empty ());
+
+        index.add ("spirala.gcz", 300, 0x5a21, 0x6000);
+        index.add ("Sphere.ngc", 100);
+        index.add ("a.ngc", 200);
+        index.add ("sphere", 50);
+        index.sort ();
+
+        REQUIRE (index.size () == 4);
+        REQUIRE (std::string (index.name (0)) == "a.ngc");
+        REQUIRE (std::string (index.name (1)) == "sphere");
+        REQUIRE (std::string (index.name (2)) == "Sphere.ngc");
+        REQUIRE (std::string (index.name (3)) == "spirala.gcz");
+
+        REQUIRE (index[0].size == 200);
+        REQUIRE (index[3].size == 300);
+        REQUIRE (index[3].date == 0x5a21);
+        REQUIRE (index[3].time == 0x6000);
+        REQUIRE (!index.truncated ());
+}
+
+TEST_CASE ("Full", "[dirIndex]")
+{
+        SECTION ("Too many entries")
+        {
+                sd::DirIndex<2, 64> index;
+                REQUIRE (index.add ("b", 1));
+                REQUIRE (index.add ("a", 2));
+                REQUIRE (!index.add ("c", 3));
+                REQUIRE (index.size () == 2);
+                REQUIRE (index.truncated ());
+        }
+
+        SECTION ("Arena")
+        {
+                sd::DirIndex<8, 8> index;
+                REQUIRE (index.add ("abc", 1));  // 4 bytes with the NUL.
+                REQUIRE (!index.add ("defg", 2)); // 5 would not fit...
+                REQUIRE (index.add ("xyz", 3));   // ...but 4 still do.
+                index.sort ();
+                REQUIRE (index.size () == 2);
+                REQUIRE (std::string (index.name (1)) == "xyz");
+                REQUIRE (index.truncated ());
+        }
+
+        SECTION ("Cleared")
+        {
+                sd::DirIndex<1, 8> index;
+                REQUIRE (index.add ("abc", 1));
+                REQUIRE (!index.add ("d", 1));
+                index.clear ();
+                REQUIRE (index.empty ());
+                REQUIRE (!index.truncated ());
+                REQUIRE (index.add ("d", 1));
+        }
+}